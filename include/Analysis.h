@@ -0,0 +1,38 @@
+#pragma once
+
+#include "EngineWorker.h"
+#include <cstdint>
+#include <vector>
+
+class Board;
+
+// One line of a running analysis
+struct AnalysisLine {
+  int depth = 0;
+  int score = 0; // Centipawns for White
+  std::vector<Move> pv;
+};
+
+// Keeps an engine searching whatever position a Board shows, with several
+// lines, on an EngineWorker of its own. Calling update every frame restarts
+// the search as soon as the position changes and takes the lines of every
+// iteration finished since, so they deepen while the position stays.
+class Analysis {
+private:
+  EngineWorker engine;
+  int lineCount;
+  uint64_t searchId = 0;
+  uint64_t analysedKey = 0;
+  bool whiteToMove = true; // In the analysed position
+  std::vector<AnalysisLine> lines;
+
+public:
+  explicit Analysis(int lineCount = 3, size_t hashMegabytes = 64);
+
+  void update(const Board &board);
+  // Cancels the search and forgets its lines until the next update
+  void stop();
+
+  // Best line first; empty until the first iteration of a position ends
+  const std::vector<AnalysisLine> &getLines() const { return lines; }
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Endgame.h"
+#include "PackedPosition.h"
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+// Score of a position that does not unpack
+constexpr int NoScore = INT_MIN;
+
+// Scores large sets of unrelated positions with evaluate(), split across a
+// pool of threads that lives as long as the evaluator. The calling thread
+// works too, and every thread keeps its own material cache from one batch to
+// the next.
+class BatchEvaluator {
+private:
+  // Positions claimed at a time; small enough to balance uneven threads
+  static constexpr size_t Chunk = 512;
+
+  std::vector<std::thread> workers;
+  MaterialCache callerMaterials;
+  std::mutex batchMutex; // One batch at a time
+
+  std::mutex mutex;
+  std::condition_variable started;
+  std::condition_variable finished;
+  // Guarded by mutex
+  uint64_t generation = 0;
+  unsigned running = 0;
+  bool quitting = false;
+
+  // The current batch; set before generation moves on
+  std::span<const PackedPosition> positions;
+  std::span<int> scores;
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> unpacked{0};
+
+  void run();
+  void work(MaterialCache &materials);
+
+public:
+  // 0 threads means one per core
+  explicit BatchEvaluator(unsigned threads = 0);
+  BatchEvaluator(const BatchEvaluator &) = delete;
+  BatchEvaluator &operator=(const BatchEvaluator &) = delete;
+  ~BatchEvaluator();
+
+  unsigned getThreads() const { return workers.size() + 1; }
+
+  // Writes the evaluation of positions[i], for its side to move, to
+  // scores[i], or NoScore if it does not unpack, and returns how many did.
+  // scores must be at least as long as positions. Safe to call from several
+  // threads; their batches run one after another.
+  size_t evaluate(std::span<const PackedPosition> positions,
+                  std::span<int> scores);
+};
+
+// Same, on an evaluator shared by the whole process with a thread per core,
+// started on first use
+size_t evaluateBatch(std::span<const PackedPosition> positions,
+                     std::span<int> scores);
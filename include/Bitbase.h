@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Types.h"
+
+// King and pawn against king, solved when the program is compiled. One bit
+// per position with the pawn on files a-d: 24 pawn squares x 64 x 64 x 2
+// sides to move, 24 KB in all.
+namespace Bitbases {
+
+constexpr int KPKSize = 24 * 64 * 64 * 2;
+
+// True if the side with the pawn wins. Squares are real board squares; the
+// position is mirrored so the pawn is white and on files a-d before lookup.
+bool probeKPK(Color strongSide, int strongKing, int pawn, int weakKing,
+              Color sideToMove);
+
+} // namespace Bitbases
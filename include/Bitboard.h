@@ -0,0 +1,171 @@
+#pragma once
+
+#include "Types.h"
+#include <array>
+#include <bit>
+#include <cstdint>
+
+using Bitboard = uint64_t;
+
+constexpr Bitboard FileA = 0x0101010101010101ULL;
+constexpr Bitboard FileH = FileA << 7;
+constexpr Bitboard Rank1 = 0xFFULL;
+constexpr Bitboard Rank8 = Rank1 << 56;
+
+constexpr Bitboard squareBB(int square) { return Bitboard{1} << square; }
+
+constexpr int lsb(Bitboard b) { return std::countr_zero(b); }
+constexpr int msb(Bitboard b) { return 63 - std::countl_zero(b); }
+constexpr int popCount(Bitboard b) { return std::popcount(b); }
+
+constexpr int popLsb(Bitboard &b) {
+  int square = lsb(b);
+  b &= b - 1;
+  return square;
+}
+
+namespace Bitboards {
+
+// Ray directions: the first four walk towards higher square indices, the
+// last four towards lower ones
+enum Direction { North, East, NorthEast, NorthWest, South, West, SouthWest,
+                 SouthEast };
+
+constexpr int fileStep[8] = {0, 1, 1, -1, 0, -1, -1, 1};
+constexpr int rankStep[8] = {1, 0, 1, 1, -1, 0, -1, -1};
+
+constexpr Bitboard stepAttacks(int square, const int (&steps)[8][2]) {
+  Bitboard attacks = 0;
+  for (const auto &step : steps) {
+    int file = fileOf(square) + step[0], rank = rankOf(square) + step[1];
+    if (file >= 0 && file < 8 && rank >= 0 && rank < 8)
+      attacks |= squareBB(makeSquare(file, rank));
+  }
+  return attacks;
+}
+
+constexpr int knightSteps[8][2] = {{1, 2},   {2, 1},   {2, -1}, {1, -2},
+                                   {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+constexpr int kingSteps[8][2] = {{0, 1},  {1, 1},   {1, 0},  {1, -1},
+                                 {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}};
+
+constexpr auto knightTable = [] {
+  std::array<Bitboard, 64> table{};
+  for (int sq = 0; sq < 64; sq++)
+    table[sq] = stepAttacks(sq, knightSteps);
+  return table;
+}();
+
+constexpr auto kingTable = [] {
+  std::array<Bitboard, 64> table{};
+  for (int sq = 0; sq < 64; sq++)
+    table[sq] = stepAttacks(sq, kingSteps);
+  return table;
+}();
+
+constexpr auto pawnTable = [] {
+  std::array<std::array<Bitboard, 64>, 2> table{};
+  for (int sq = 0; sq < 64; sq++) {
+    Bitboard b = squareBB(sq);
+    table[White][sq] = ((b & ~FileA) << 7) | ((b & ~FileH) << 9);
+    table[Black][sq] = ((b & ~FileA) >> 9) | ((b & ~FileH) >> 7);
+  }
+  return table;
+}();
+
+constexpr auto rayTable = [] {
+  std::array<std::array<Bitboard, 64>, 8> table{};
+  for (int dir = 0; dir < 8; dir++)
+    for (int sq = 0; sq < 64; sq++) {
+      int file = fileOf(sq) + fileStep[dir], rank = rankOf(sq) + rankStep[dir];
+      for (; file >= 0 && file < 8 && rank >= 0 && rank < 8;
+           file += fileStep[dir], rank += rankStep[dir])
+        table[dir][sq] |= squareBB(makeSquare(file, rank));
+    }
+  return table;
+}();
+
+// Squares strictly between two aligned squares, empty when not aligned
+constexpr auto betweenTable = [] {
+  std::array<std::array<Bitboard, 64>, 64> table{};
+  for (int dir = 0; dir < 8; dir++)
+    for (int from = 0; from < 64; from++) {
+      Bitboard passed = 0;
+      int file = fileOf(from) + fileStep[dir],
+          rank = rankOf(from) + rankStep[dir];
+      for (; file >= 0 && file < 8 && rank >= 0 && rank < 8;
+           file += fileStep[dir], rank += rankStep[dir]) {
+        table[from][makeSquare(file, rank)] = passed;
+        passed |= squareBB(makeSquare(file, rank));
+      }
+    }
+  return table;
+}();
+
+template <Direction dir>
+constexpr Bitboard rayAttacks(int square, Bitboard occupied) {
+  Bitboard attacks = rayTable[dir][square];
+  Bitboard blockers = attacks & occupied;
+  if (blockers) {
+    int first = dir < South ? lsb(blockers) : msb(blockers);
+    attacks ^= rayTable[dir][first];
+  }
+  return attacks;
+}
+
+} // namespace Bitboards
+
+constexpr Bitboard knightAttacks(int square) {
+  return Bitboards::knightTable[square];
+}
+
+constexpr Bitboard kingAttacks(int square) {
+  return Bitboards::kingTable[square];
+}
+
+constexpr Bitboard pawnAttacks(Color c, int square) {
+  return Bitboards::pawnTable[c][square];
+}
+
+constexpr Bitboard rookAttacks(int square, Bitboard occupied) {
+  using namespace Bitboards;
+  return rayAttacks<North>(square, occupied) |
+         rayAttacks<East>(square, occupied) |
+         rayAttacks<South>(square, occupied) |
+         rayAttacks<West>(square, occupied);
+}
+
+constexpr Bitboard bishopAttacks(int square, Bitboard occupied) {
+  using namespace Bitboards;
+  return rayAttacks<NorthEast>(square, occupied) |
+         rayAttacks<NorthWest>(square, occupied) |
+         rayAttacks<SouthEast>(square, occupied) |
+         rayAttacks<SouthWest>(square, occupied);
+}
+
+constexpr Bitboard queenAttacks(int square, Bitboard occupied) {
+  return rookAttacks(square, occupied) | bishopAttacks(square, occupied);
+}
+
+constexpr Bitboard betweenBB(int a, int b) {
+  return Bitboards::betweenTable[a][b];
+}
+
+// Attacks of a non-pawn piece standing on square
+constexpr Bitboard pieceAttacks(PieceType type, int square,
+                                Bitboard occupied) {
+  switch (type) {
+  case PieceType::Knight:
+    return knightAttacks(square);
+  case PieceType::Bishop:
+    return bishopAttacks(square, occupied);
+  case PieceType::Rook:
+    return rookAttacks(square, occupied);
+  case PieceType::Queen:
+    return queenAttacks(square, occupied);
+  case PieceType::King:
+    return kingAttacks(square);
+  default:
+    return 0;
+  }
+}
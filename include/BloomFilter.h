@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// A Bloom filter over 64-bit keys, such as Zobrist keys, that any number of
+// threads may insert into without a lock. All the bits of one key lie in a
+// single word and are set with one atomic OR, so when two threads insert the
+// same key at once exactly one of them sees it as new.
+class BloomFilter {
+private:
+  static constexpr int Probes = 6;
+
+  std::unique_ptr<std::atomic<uint64_t>[]> words;
+  size_t count = 0;
+
+  size_t wordOf(uint64_t key) const {
+    return static_cast<size_t>(static_cast<unsigned __int128>(key) * count >>
+                               64);
+  }
+
+  static uint64_t maskOf(uint64_t key) {
+    uint64_t hash = key * 0x9E3779B97F4A7C15ULL, mask = 0;
+    for (int i = 0; i < Probes; i++, hash <<= 6)
+      mask |= uint64_t{1} << (hash >> 58);
+    return mask;
+  }
+
+public:
+  explicit BloomFilter(size_t bits)
+      : words(std::make_unique<std::atomic<uint64_t>[]>(bits / 64 + 1)),
+        count(bits / 64 + 1) {}
+
+  // Adds key; true if it may have been added before
+  bool insert(uint64_t key) {
+    uint64_t mask = maskOf(key);
+    uint64_t old = words[wordOf(key)].fetch_or(mask, std::memory_order_relaxed);
+    return (old & mask) == mask;
+  }
+
+  bool mayContain(uint64_t key) const {
+    uint64_t mask = maskOf(key);
+    return (words[wordOf(key)].load(std::memory_order_relaxed) & mask) == mask;
+  }
+
+  size_t getBytes() const { return count * sizeof(uint64_t); }
+};
@@ -1,80 +1,80 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <glm/glm.hpp>
-#include <memory>
+#include <string_view>
 #include <vector>
 
 enum class GameState { Playing, PromotionPending, OwariDa };
 
+class Move;
 class Piece;
 class Pawn;
-class SpriteSheet;
-class Shader;
+class Position;
 
 enum class PieceType;
 
-struct PromotionQuad {
-  glm::vec2 min;
-  glm::vec2 max;
-  PieceType type;
+// A move in grid squares, row 0 being rank 8
+struct BoardMove {
+  glm::ivec2 from;
+  glm::ivec2 to;
 };
 
+// The game as the GUI plays it: the pieces, whose turn it is, the selected
+// piece with its moves and any pending promotion. Drawing is left to
+// BoardRenderer, so a Board needs no GL context.
 class Board {
 private:
-  std::array<std::array<Piece *, 8>, 8> grid;
-  std::vector<float> vertices;
-  std::vector<unsigned int> indices;
-  unsigned int squareSize = 100;
-
-  unsigned int VAO, VBO, EBO;
+  std::array<std::array<Piece *, 8>, 8> grid{};
   std::vector<glm::ivec2> highlightedSquares;
-  std::unique_ptr<Shader> highlightShader;
-  unsigned int highlightVAO;
-  unsigned int highlightVBO;
-  unsigned int highlightEBO;
   bool highlighted = false;
 
-  Piece *clickedPiece;
+  Piece *clickedPiece = nullptr;
   bool hasWon = false;
   bool whiteTurn = true;
 
   GameState gameState = GameState::Playing;
-  std::unique_ptr<Shader> dimShader;
-  unsigned int dimVBO, dimEBO, dimVAO;
-  std::unique_ptr<Shader> promotionShader;
-  unsigned int promoteVBO, promoteEBO, promoteVAO;
-  std::unique_ptr<Shader> promotionPiecesShader;
-  unsigned int pieceVBO, pieceEBO, pieceVAO;
-  std::vector<PromotionQuad> pQuads;
-  SpriteSheet *promotedPawnSheet;
-  PieceType promoteTo;
-  glm::vec2 movingTo;
-  Piece *promotedPawn;
-
-  void generateVertices();
-  void renderHighlightedSquares(glm::mat4 projection);
-  void renderDimWindow();
-  void renderPromotionOverlay();
-  void renderPromotionPieces();
-  void initializeHighlightBuffers();
-  void initializeDimBuffers();
-  void initializePromotionBuffers();
-  void initializePromotionPiecesBuffers();
-  void changePiece();
+  glm::ivec2 movingTo{};
+  BoardMove lastMove{};
+  uint64_t moveCount = 0;
 
 public:
-  Board();
+  Board() = default;
+  Board(const Board &) = delete;
+  Board &operator=(const Board &) = delete;
   ~Board();
-  void render(SpriteSheet &blackSheet, SpriteSheet &whiteSheet, Shader &shader,
-              glm::mat4 projection);
-  void initializeBoard(SpriteSheet &blackSheet,
-                       SpriteSheet &whiteSheet); // place pieces initially
+  void initializeBoard(); // place pieces initially
+  // Replaces every piece with those of a FEN record; false, leaving the board
+  // as it was, if it does not parse
+  bool loadFen(std::string_view fen);
+  // The pieces and side to move as a Position. The GUI rules have no castling
+  // or en passant, so neither is set.
+  Position getPosition() const;
   Piece *getPieceAt(int x, int y) const;
-  void handleClick(float x, float y);
-  void handlePromotionClick(float x, float y);
+  // Selects the piece on a grid square, or moves the selected piece there if
+  // it may go
+  void handleClick(int col, int row);
+  // Replaces the pawn waiting on the last rank
+  void promote(PieceType type);
+  // Plays a move of the side to move given as the core's Move, such as an
+  // engine's, promoting as it says; false if the GUI rules do not allow it
+  bool playMove(Move move);
+  // Every move of the side to move the GUI rules allow, as the core's Moves
+  // with one per promotion piece; empty while a promotion is pending
+  std::vector<Move> getAllowedMoves();
   void movePiece(glm::ivec2 from, glm::ivec2 to);
-  bool isOutOfBounds(const glm::ivec2 &move);
-  bool checkIfWon();
-  GameState getGameState();
+  bool isOutOfBounds(const glm::ivec2 &move) const;
+  // The grid square of a core square (a1 = 0 to h8 = 63)
+  static glm::ivec2 gridSquare(int square);
+  bool checkIfWon() const;
+  GameState getGameState() const;
+  bool isWhiteTurn() const { return whiteTurn; }
+  const std::vector<glm::ivec2> &getHighlightedSquares() const {
+    return highlightedSquares;
+  }
+  glm::ivec2 getPromotionSquare() const { return movingTo; }
+  // Counts moves so a renderer can tell when to animate getLastMove
+  uint64_t getMoveCount() const { return moveCount; }
+  BoardMove getLastMove() const { return lastMove; }
 };
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <optional>
+#include <vector>
+
+class Analysis;
+class Board;
+class Shader;
+class SpriteSheet;
+
+enum class PieceType;
+
+struct PromotionQuad {
+  glm::vec2 min;
+  glm::vec2 max;
+  PieceType type;
+};
+
+// A piece sliding from one square to another, in screen coordinates
+struct PieceAnimation {
+  glm::ivec2 square; // Where the piece lands, in grid squares
+  glm::vec2 startPos;
+  glm::vec2 targetPos;
+  float startTime;
+  bool isAnimating = false;
+};
+
+// Draws a Board with OpenGL: the squares, the selected piece's moves, the
+// pieces (animating the latest move), any analysis as arrows and an
+// evaluation bar, and the promotion overlay. Needs a current GL context.
+// Time comes from the caller, so nothing here depends on the windowing
+// library.
+class BoardRenderer {
+private:
+  SpriteSheet &blackSheet;
+  SpriteSheet &whiteSheet;
+  std::vector<float> vertices;
+  std::vector<unsigned int> indices;
+  unsigned int squareSize = 100;
+
+  unsigned int VAO, VBO, EBO;
+  std::unique_ptr<Shader> highlightShader;
+  unsigned int highlightVAO;
+  unsigned int highlightVBO;
+  unsigned int highlightEBO;
+
+  std::unique_ptr<Shader> dimShader;
+  unsigned int dimVBO, dimEBO, dimVAO;
+  std::unique_ptr<Shader> promotionShader;
+  unsigned int promoteVBO, promoteEBO, promoteVAO;
+  std::unique_ptr<Shader> promotionPiecesShader;
+  unsigned int pieceVBO, pieceEBO, pieceVAO;
+  std::vector<PromotionQuad> pQuads;
+  // Arrows and the evaluation bar, rebuilt every frame and drawn at once
+  std::unique_ptr<Shader> overlayShader;
+  unsigned int overlayVBO, overlayVAO;
+  std::vector<float> overlayVertices;
+
+  uint64_t seenMoves = 0;
+  PieceAnimation animation;
+
+  void generateVertices();
+  void renderHighlightedSquares(const Board &board, glm::mat4 projection);
+  void renderAnalysis(const Analysis &analysis, glm::mat4 projection);
+  void addTriangle(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec4 color);
+  void addArrow(int from, int to, float width, glm::vec4 color);
+  void renderPieces(const Board &board, Shader &shader, float time);
+  void renderDimWindow();
+  void renderPromotionOverlay();
+  void renderPromotionPieces(SpriteSheet &sheet);
+  void initializeHighlightBuffers();
+  void initializeDimBuffers();
+  void initializePromotionBuffers();
+  void initializePromotionPiecesBuffers();
+  void initializeOverlayBuffers();
+
+public:
+  BoardRenderer(SpriteSheet &blackSheet, SpriteSheet &whiteSheet);
+  BoardRenderer(const BoardRenderer &) = delete;
+  BoardRenderer &operator=(const BoardRenderer &) = delete;
+  ~BoardRenderer();
+
+  // time in seconds, from any clock that keeps running
+  void render(const Board &board, Shader &shader, glm::mat4 projection,
+              float time, const Analysis *analysis = nullptr);
+  // The grid square under a window point, row 0 at the top
+  glm::ivec2 squareAt(float x, float y) const;
+  // The piece picked on the promotion overlay at a window point, if any
+  std::optional<PieceType> promotionChoiceAt(float x, float y) const;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Position.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// The Zobrist key of pos as defined by the Polyglot book format
+uint64_t polyglotKey(const Position &pos);
+
+// Reference keys from the format description
+constexpr uint64_t PolyglotStartKey = 0x463B96181691FC9CULL;
+
+// One 16-byte book record, stored big-endian on disk
+struct BookEntry {
+  uint64_t key;
+  uint16_t move;
+  uint16_t weight;
+  uint32_t learn;
+};
+
+constexpr size_t BookEntrySize = 16;
+
+// Polyglot moves are from/to/promotion with castling written as the king
+// taking its own rook
+uint16_t encodeBookMove(Move m);
+// The legal move of pos matching a book move, or a null move
+Move decodeBookMove(const Position &pos, uint16_t move);
+
+void writeBookEntry(const BookEntry &entry, uint8_t *out);
+BookEntry readBookEntry(const uint8_t *in);
+
+struct BookMove {
+  Move move;
+  uint16_t weight;
+};
+
+// A Polyglot .bin book, memory-mapped read-only. Opening is constant time
+// whatever the file size; lookups binary-search the sorted records in place.
+class OpeningBook {
+private:
+  const uint8_t *data = nullptr;
+  size_t length = 0;
+  size_t entries = 0;
+
+  void close();
+
+public:
+  OpeningBook() = default;
+  OpeningBook(const OpeningBook &) = delete;
+  OpeningBook &operator=(const OpeningBook &) = delete;
+  ~OpeningBook();
+
+  bool open(const std::string &path);
+  bool isOpen() const { return data != nullptr; }
+  size_t size() const { return entries; }
+
+  // Every legal book move for pos, heaviest first
+  std::vector<BookMove> probe(const Position &pos) const;
+  // A book move chosen at random in proportion to its weight, or a null move
+  Move pick(const Position &pos, std::mt19937_64 &rng) const;
+};
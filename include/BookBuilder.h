@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Book.h"
+#include "Pgn.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct BookBuilderOptions {
+  size_t memoryLimit = size_t{1} << 30; // Bytes of counts kept before spilling
+  int maxPly = 40;                      // Plies of each game that are counted
+  uint32_t minGames = 1; // Moves played fewer times are left out of the book
+  std::string tempDirectory = ".";
+};
+
+// Counts (position, move) -> wins/draws/losses for the side that played it
+// over many games and writes the result as a Polyglot book. addGame may be
+// called from any number of threads: the counts live in hash maps sharded by
+// key, each behind its own lock. Once they outgrow the memory limit they are
+// sorted and spilled to a run file, and write merges all runs.
+class BookBuilder {
+private:
+  struct EntryKey {
+    uint64_t key;
+    uint16_t move;
+    bool operator==(const EntryKey &) const = default;
+  };
+  struct EntryHash {
+    size_t operator()(const EntryKey &k) const {
+      return k.key ^ (k.move * 0x9E3779B97F4A7C15ULL);
+    }
+  };
+  struct Counts {
+    uint32_t wins = 0, draws = 0, losses = 0;
+  };
+  // One line of a spilled run, which is sorted by key then move
+  struct Record {
+    EntryKey entry;
+    Counts counts;
+    bool operator<(const Record &other) const {
+      return entry.key != other.entry.key ? entry.key < other.entry.key
+                                          : entry.move < other.entry.move;
+    }
+  };
+  // Layout of a Record in a run file
+  struct RunFormat;
+
+  static constexpr int ShardCount = 64;
+  // Rough heap cost of one hash map entry
+  static constexpr size_t EntryBytes = 64;
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<EntryKey, Counts, EntryHash> counts;
+  };
+
+  BookBuilderOptions options;
+  std::array<Shard, ShardCount> shards;
+  std::atomic<size_t> entries{0};
+  std::mutex spillMutex;
+  std::vector<std::string> runs;
+
+  std::atomic<uint64_t> games{0};
+  std::atomic<uint64_t> skipped{0};
+  // A run could not be written, so its counts are lost
+  std::atomic<bool> failed{false};
+
+  bool count(const EntryKey &entry, int score);
+  // Writes every count held in memory to a new sorted run; with force unset
+  // only if the memory limit is still exceeded. False if the run could not
+  // be written.
+  bool spill(bool force);
+
+public:
+  explicit BookBuilder(const BookBuilderOptions &options);
+  BookBuilder(const BookBuilder &) = delete;
+  BookBuilder &operator=(const BookBuilder &) = delete;
+  ~BookBuilder();
+
+  // Replays game from the start position and counts its opening moves.
+  // Games that set up their own position or contain an illegal move are
+  // skipped. False once counts could not be spilled to a run.
+  bool addGame(const PgnGame &game);
+  // Merges everything counted into a sorted Polyglot book at path
+  bool write(const std::string &path);
+
+  uint64_t getGames() const { return games; }
+  uint64_t getSkipped() const { return skipped; }
+  size_t getRuns() const { return runs.size(); }
+};
@@ -0,0 +1,144 @@
+#pragma once
+
+/* A C interface to chess_core for programs that embed the engine, built as
+ * the shared library libchess. Positions and searchers are opaque handles.
+ * Every output goes to memory the caller provides, so nothing allocated by
+ * the library is ever freed by the caller, or the other way round.
+ *
+ * Moves are 16-bit values laid out as in Move.h: origin square in bits 0-5,
+ * destination in bits 6-11, promotion piece in bits 12-13 and a flag in bits
+ * 14-15, squares counting a1 = 0 to h8 = 63. 0 is no move. Packed positions
+ * are the 32-byte records of PackedPosition.h, back to back.
+ *
+ * Functions returning int return CHESS_OK (or a count) on success and a
+ * negative chess_status on failure. Batch functions take an optional valid
+ * array (may be NULL) that receives 1 for each position that could be set
+ * up and 0 for each that could not; they return how many were valid. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define CHESS_API __attribute__((visibility("default")))
+#else
+#define CHESS_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHESS_API_VERSION 1
+/* No position has more legal moves */
+#define CHESS_MAX_MOVES 256
+#define CHESS_PACKED_SIZE 32
+/* Score of a position that could not be set up */
+#define CHESS_NO_SCORE INT32_MIN
+
+typedef enum chess_status {
+  CHESS_OK = 0,
+  CHESS_INVALID_ARGUMENT = -1,
+  CHESS_INVALID_POSITION = -2,
+  CHESS_ILLEGAL_MOVE = -3,
+  CHESS_BUFFER_TOO_SMALL = -4,
+  CHESS_OUT_OF_MEMORY = -5,
+  CHESS_FILE_ERROR = -6
+} chess_status;
+
+typedef struct chess_position chess_position;
+typedef struct chess_searcher chess_searcher;
+
+/* Zero means no limit; with no limit at all a search gets depth 8 */
+typedef struct chess_search_limits {
+  int32_t depth;
+  uint64_t nodes;
+  int64_t move_time_ms;
+} chess_search_limits;
+
+typedef struct chess_search_result {
+  uint16_t move;   /* 0 when there is no legal move */
+  int32_t score;   /* Centipawns for the side to move, or CHESS_NO_SCORE */
+  int32_t depth;   /* Last completed iteration */
+  uint64_t nodes;
+} chess_search_result;
+
+/* CHESS_API_VERSION of the library actually loaded */
+CHESS_API int chess_api_version(void);
+
+/* Evaluation uses this network (see chess_train) until it is unloaded. Not
+ * to be called while another thread evaluates or searches. */
+CHESS_API int chess_load_network(const char *path);
+CHESS_API void chess_unload_network(void);
+
+/* Writes the move as UCI text (at most 5 characters and a terminating NUL)
+ * into out, which must hold 6 bytes */
+CHESS_API int chess_move_to_uci(uint16_t move, char *out);
+
+/* Positions. A new position is the start position; NULL if out of memory. */
+CHESS_API chess_position *chess_position_new(void);
+CHESS_API void chess_position_free(chess_position *position);
+/* Positions without exactly one king each, with pawns on the first or last
+ * rank, or with the side to move able to take the other king are refused
+ * with CHESS_INVALID_POSITION. On failure the position is left as it was. */
+CHESS_API int chess_position_set_fen(chess_position *position,
+                                     const char *fen);
+CHESS_API int chess_position_set_packed(chess_position *position,
+                                        const uint8_t *packed);
+/* Writes as much of the FEN as fits, always NUL-terminated when size > 0,
+ * and returns its full length like snprintf */
+CHESS_API int chess_position_get_fen(const chess_position *position,
+                                     char *buffer, size_t size);
+CHESS_API int chess_position_pack(const chess_position *position,
+                                  uint8_t *packed);
+CHESS_API uint64_t chess_position_key(const chess_position *position);
+/* Plays a legal move given as UCI text */
+CHESS_API int chess_position_play(chess_position *position, const char *uci);
+/* Returns the number of legal moves, writing up to capacity of them */
+CHESS_API int chess_position_legal_moves(const chess_position *position,
+                                         uint16_t *moves, size_t capacity);
+/* Static evaluation in centipawns for the side to move */
+CHESS_API int32_t chess_position_evaluate(const chess_position *position);
+
+/* Searchers. Each keeps its own hash table and may be used by one thread at
+ * a time; use one per thread to search in parallel. */
+CHESS_API chess_searcher *chess_searcher_new(size_t hash_megabytes);
+CHESS_API void chess_searcher_free(chess_searcher *searcher);
+CHESS_API void chess_searcher_clear(chess_searcher *searcher);
+CHESS_API int chess_searcher_search(chess_searcher *searcher,
+                                    const chess_position *position,
+                                    const chess_search_limits *limits,
+                                    chess_search_result *result);
+
+/* Batches of count positions, given as NUL-terminated FEN strings or as
+ * count * CHESS_PACKED_SIZE bytes of packed positions.
+ *
+ * Legal moves go back to back into moves; offsets, count + 1 entries, gets
+ * where each position's moves start and end. If capacity runs out the call
+ * returns CHESS_BUFFER_TOO_SMALL with the offsets of the positions that fit
+ * filled in; CHESS_MAX_MOVES * count is always enough. */
+CHESS_API int chess_fen_legal_moves(const char *const *fens, size_t count,
+                                    uint16_t *moves, size_t capacity,
+                                    uint32_t *offsets, uint8_t *valid);
+CHESS_API int chess_packed_legal_moves(const uint8_t *packed, size_t count,
+                                       uint16_t *moves, size_t capacity,
+                                       uint32_t *offsets, uint8_t *valid);
+/* One score per position, CHESS_NO_SCORE where invalid. Packed batches are
+ * spread over a pool with a thread per core, started on first use. */
+CHESS_API int chess_fen_evaluate(const char *const *fens, size_t count,
+                                 int32_t *scores, uint8_t *valid);
+CHESS_API int chess_packed_evaluate(const uint8_t *packed, size_t count,
+                                    int32_t *scores, uint8_t *valid);
+/* One result per position, searched in turn with the same limits */
+CHESS_API int chess_fen_search(chess_searcher *searcher,
+                               const char *const *fens, size_t count,
+                               const chess_search_limits *limits,
+                               chess_search_result *results, uint8_t *valid);
+CHESS_API int chess_packed_search(chess_searcher *searcher,
+                                  const uint8_t *packed, size_t count,
+                                  const chess_search_limits *limits,
+                                  chess_search_result *results,
+                                  uint8_t *valid);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Position.h"
+#include <cstdint>
+#include <vector>
+
+// Endgame scale factors are out of ScaleNormal and apply to the endgame half
+// of the evaluation
+constexpr int ScaleNormal = 64;
+constexpr int ScaleDraw = 0;
+
+// Exact or specialised evaluation of a known endgame, in centipawns from the
+// strong side's point of view
+using EndgameEval = int (*)(const Position &pos, Color strong);
+// Scale factor for the strong side's advantage
+using EndgameScale = int (*)(const Position &pos, Color strong);
+
+// Everything the evaluation derives from material alone
+struct MaterialEntry {
+  uint64_t key = ~uint64_t{0};
+  EndgameEval evaluation = nullptr;
+  Color evaluationStrong = White;
+  EndgameScale scale[2] = {nullptr, nullptr}; // Per side, when it is ahead
+  uint8_t factor[2] = {ScaleNormal, ScaleNormal};
+  int phase = 0;
+
+  int getScale(const Position &pos, Color strong) const {
+    return scale[strong] ? scale[strong](pos, strong) : factor[strong];
+  }
+};
+
+// Small per-thread cache in front of the endgame table, so dispatching on
+// material costs one probe per evaluation. Not shared between threads.
+class MaterialCache {
+private:
+  static constexpr int Bits = 13;
+  std::vector<MaterialEntry> entries;
+
+  static void fill(const Position &pos, MaterialEntry &entry);
+
+public:
+  MaterialCache();
+
+  const MaterialEntry &probe(const Position &pos);
+};
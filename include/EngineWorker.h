@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Search.h"
+#include "SpscQueue.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+// What a search sends back: an Info after every completed iteration (one per
+// line with multiPV), then a BestMove when it ends
+struct EngineEvent {
+  enum class Kind { Info, BestMove };
+  Kind kind = Kind::Info;
+  uint64_t searchId = 0;
+  SearchInfo info{};
+  Move best;   // BestMove only; null if the root has no legal move
+  Move ponder; // BestMove only; the expected reply, null if unknown
+};
+
+// A Search on its own thread, so a render loop can start searches and keep
+// drawing. Commands go to the worker and events come back through lock-free
+// single-producer queues, which is why every member function must be called
+// from one thread only, the one that polls. Cancellation is cooperative: a
+// running search notices its stop flag at the next node check and still
+// reports its best move so far, while one still queued is dropped unheard.
+class EngineWorker {
+private:
+  struct Command {
+    enum class Kind { Search, ClearHash };
+    Kind kind = Kind::Search;
+    uint64_t searchId = 0;
+    Position root;
+    SearchLimits limits;
+  };
+
+  Search search;
+  SpscQueue<Command, 16> commands;
+  SpscQueue<EngineEvent, 256> events;
+  // Bumped after every command so an idle worker can sleep on it
+  std::atomic<uint32_t> wakeups{0};
+  // Searches up to this id are cancelled, queued ones included
+  std::atomic<uint64_t> cancelledThrough{0};
+  std::atomic<bool> quitting{false};
+  // Deadlines given to a search after it started, in steady clock ms;
+  // timedSearchId is stored last
+  std::atomic<int64_t> softDeadlineMs{0};
+  std::atomic<int64_t> hardDeadlineMs{0};
+  std::atomic<uint64_t> timedSearchId{0};
+  uint64_t lastSearchId = 0; // Caller's thread only
+  std::thread worker;
+
+  void run();
+  void runSearch(const Command &command);
+  bool isCancelled(uint64_t searchId) const;
+  void applyTimeLimits(uint64_t searchId);
+  bool send(Command &&command);
+  void post(EngineEvent &&event, bool mustArrive);
+
+public:
+  explicit EngineWorker(size_t hashMegabytes = 64);
+  EngineWorker(const EngineWorker &) = delete;
+  EngineWorker &operator=(const EngineWorker &) = delete;
+  ~EngineWorker();
+
+  // Searches root after cancelling any search still running or queued.
+  // Returns the id its events carry, or 0 if the command queue is full.
+  uint64_t startSearch(const Position &root, const SearchLimits &limits);
+  // Stops every search started so far
+  void cancel();
+  // Gives a search started without a time limit, such as one pondering on
+  // the expected reply, soft and hard limits counted from now (0 for none)
+  void setTimeLimits(uint64_t searchId, int64_t softMs, int64_t hardMs);
+  void clearHash();
+  // Takes the next event, if any; meant to be called every frame
+  bool poll(EngineEvent &event) { return events.pop(event); }
+};
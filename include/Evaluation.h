@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Endgame.h"
+#include "Position.h"
+
+// Won endgames score above anything material alone reaches, below mates
+constexpr int KnownWin = 10000;
+
+// Knights and bishops count 1, rooks 2, queens 4 towards the game phase
+constexpr int MaxPhase = 24;
+
+int gamePhase(const Position &pos);
+
+// Static evaluation in centipawns from the side to move's point of view.
+// Middlegame and endgame scores are blended by gamePhase; known endgames are
+// dispatched through the material cache. A loaded network (Nnue.h) replaces
+// the piece-square tables.
+int evaluate(const Position &pos, MaterialCache &materials);
+// Same, with a cache private to the calling thread
+int evaluate(const Position &pos);
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "GameDatabase.h"
+#include "MappedFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Opening statistics of one move from one position. Results are for the side
+// that played the move; ratings are that side's.
+struct ExplorerEntry {
+  uint64_t key = 0;
+  uint16_t move = 0;
+  uint32_t wins = 0, draws = 0, losses = 0;
+  uint32_t rated = 0;     // Games in which the mover had a rating
+  uint64_t ratingSum = 0; // Over those games
+
+  uint32_t getGames() const { return wins + draws + losses; }
+  // Points scored per game, 0 to 1
+  double getScore() const {
+    return getGames() ? (wins + draws / 2.0) / getGames() : 0;
+  }
+  int getAverageRating() const { return rated ? ratingSum / rated : 0; }
+};
+
+// Stored little-endian: key, move, two zero bytes, wins, draws, losses,
+// rated, rating sum
+constexpr size_t ExplorerEntrySize = 36;
+
+void writeExplorerEntry(const ExplorerEntry &entry, uint8_t *out);
+ExplorerEntry readExplorerEntry(const uint8_t *in);
+
+struct ExplorerOptions {
+  size_t memoryLimit = size_t{1} << 30; // Bytes of moves kept before spilling
+  int maxPly = 40;                      // Plies of each game that are counted
+  uint32_t minGames = 1; // Moves played fewer times are left out
+  std::string tempDirectory = ".";
+};
+
+// Aggregates (position, move) statistics over many games into an explorer
+// file: a header followed by entries sorted by key, then move. Moves are
+// collected in memory, sorted and summed into run files whenever they
+// outgrow the memory limit, and write merges the runs.
+class ExplorerBuilder {
+private:
+  struct Played {
+    uint64_t key;
+    uint16_t move;
+    uint16_t rating; // 0 when unknown
+    uint8_t points;  // 2 win, 1 draw, 0 loss for the mover
+  };
+
+  ExplorerOptions options;
+  std::vector<Played> played;
+  std::vector<std::string> runs;
+  uint64_t games = 0, skipped = 0;
+
+  bool spill();
+
+public:
+  explicit ExplorerBuilder(const ExplorerOptions &options = {});
+  ExplorerBuilder(const ExplorerBuilder &) = delete;
+  ExplorerBuilder &operator=(const ExplorerBuilder &) = delete;
+  ~ExplorerBuilder();
+
+  // Counts the opening of a game played from the start position. Games
+  // without a result are skipped.
+  bool addGame(const GameHeader &header, const std::vector<Move> &moves);
+  bool write(const std::string &path);
+
+  uint64_t getGames() const { return games; }
+  uint64_t getSkipped() const { return skipped; }
+  size_t getRuns() const { return runs.size(); }
+};
+
+struct ExplorerMove {
+  Move move;
+  ExplorerEntry stats;
+};
+
+// An explorer file, memory-mapped read-only and binary-searched in place
+class OpeningExplorer {
+private:
+  MappedFile file;
+  size_t entries = 0;
+
+  uint64_t keyAt(size_t index) const;
+
+public:
+  bool open(const std::string &path);
+  bool isOpen() const { return file.isOpen(); }
+  size_t size() const { return entries; }
+
+  // The legal moves played from pos, most played first
+  std::vector<ExplorerMove> probe(const Position &pos) const;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "GameDatabase.h"
+#include "MappedFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A compressed copy of a game database's moves. Each move is stored as its
+// rank among the legal moves under a fixed ordering (captures of big pieces
+// first, then promotions, castling and centralising moves), and the ranks
+// are Huffman-coded with one static code per archive, chosen from the rank
+// frequencies of all its games. Likely moves get short codes, so typical
+// games take a few bits per move.
+//
+// Games are grouped into blocks of a fixed number of games; each block is a
+// self-contained bit stream, and an offset table locates block b directly.
+// File layout, little-endian: header (magic, version, games, games per
+// block, blocks), 256 code lengths, block offsets (blocks + 1), blocks.
+// Within a block each game is its ply count (Elias gamma of plies + 1)
+// followed by its coded ranks.
+
+struct GameArchiveOptions {
+  uint32_t gamesPerBlock = 256;
+  unsigned threads = 1;
+};
+
+// Compresses every game of database into an archive at path
+bool writeGameArchive(const GameDatabase &database, const std::string &path,
+                      const GameArchiveOptions &options = {});
+
+class GameArchive {
+private:
+  MappedFile file;
+  uint64_t games = 0;
+  uint32_t gamesPerBlock = 0;
+  uint32_t blocks = 0;
+  const uint8_t *offsets = nullptr;
+  const uint8_t *data = nullptr;
+  // Decoding table indexed by the next MaxCodeBits bits of the stream:
+  // symbol in the low byte, code length above it
+  std::vector<uint16_t> table;
+
+  // Decodes games of block until visit(id, moves) returns false
+  template <typename Visit> bool decode(uint32_t block, Visit &&visit) const;
+
+public:
+  static constexpr int MaxCodeBits = 12;
+
+  bool open(const std::string &path);
+  void close();
+  bool isOpen() const { return file.isOpen(); }
+
+  uint64_t size() const { return games; }
+  uint32_t getBlocks() const { return blocks; }
+  size_t getBytes() const { return file.size(); }
+
+  bool getMoves(uint32_t game, std::vector<Move> &moves) const;
+  // Every game of one block: moves back to back, ends[i] one past game i's
+  // last move
+  bool decodeBlock(uint32_t block, std::vector<Move> &moves,
+                   std::vector<uint32_t> &ends) const;
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Pgn.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// A game database is three files sharing a base name:
+//   BASE.games  16-byte file header, then one 64-byte GameHeader per game
+//   BASE.moves  every game's moves back to back as 16-bit Move values
+//   BASE.index  Zobrist key -> ids of the games that reached the position
+// All integers are little-endian.
+//
+// The index starts with a directory of 2^bits offsets into a sorted array of
+// (key, first posting) entries, one bucket per value of the key's top bits,
+// so a lookup reads one directory slot and searches a handful of entries.
+// Each key's postings are the ascending ids of its games.
+
+// Fixed-width metadata of one game. Names are cut to fit and NUL-padded.
+struct GameHeader {
+  uint64_t firstMove = 0; // Index into BASE.moves
+  uint16_t plies = 0;
+  int8_t result = 0;      // 1 white won, 0 draw, -1 black won, -2 unknown
+  uint16_t whiteElo = 0;  // 0 when unknown
+  uint16_t blackElo = 0;
+  uint32_t date = 0;      // yyyymmdd, unknown parts zero
+  char white[22] = {};
+  char black[22] = {};
+};
+
+constexpr size_t GameHeaderSize = 64;
+constexpr int8_t UnknownResult = -2;
+
+void writeGameHeader(const GameHeader &header, uint8_t *out);
+GameHeader readGameHeader(const uint8_t *in);
+
+// Fills the metadata fields of header from the game's tags
+void readGameTags(const PgnGame &game, GameHeader &header);
+
+struct GameDatabaseOptions {
+  size_t memoryLimit = size_t{1} << 30; // Bytes of index pairs kept in memory
+  int maxPly = 0; // Plies of each game that are indexed, 0 for all
+  std::string tempDirectory = ".";
+};
+
+// Appends games in the order given and builds the index when finished. Index
+// pairs are collected in memory, sorted and spilled to run files whenever
+// they outgrow the memory limit, and merged at the end.
+class GameDatabaseWriter {
+private:
+  // Runs are sorted by key, then game
+  struct Pair {
+    uint64_t key;
+    uint32_t game;
+    bool operator<(const Pair &other) const {
+      return key != other.key ? key < other.key : game < other.game;
+    }
+  };
+  // Layout of a Pair in a run file
+  struct RunFormat;
+
+  GameDatabaseOptions options;
+  std::string base;
+  std::ofstream games, moves;
+  uint64_t gameCount = 0, moveCount = 0;
+
+  std::vector<Pair> pairs;
+  std::vector<std::string> runs;
+  uint64_t pairCount = 0;
+
+  bool spill();
+  bool writeIndex();
+
+public:
+  explicit GameDatabaseWriter(const GameDatabaseOptions &options = {});
+  GameDatabaseWriter(const GameDatabaseWriter &) = delete;
+  GameDatabaseWriter &operator=(const GameDatabaseWriter &) = delete;
+  ~GameDatabaseWriter();
+
+  bool open(const std::string &base);
+  // Stores a game played from the start position; moves is its main line
+  bool addGame(const PgnGame &game, const std::vector<Move> &moves);
+  // Writes the game count and the index
+  bool finish();
+
+  uint64_t getGames() const { return gameCount; }
+  uint64_t getMoves() const { return moveCount; }
+  size_t getRuns() const { return runs.size(); }
+};
+
+// Game ids of one position, read in place from the mapped index
+class GameIdList {
+private:
+  const uint8_t *data = nullptr;
+  size_t count = 0;
+
+public:
+  GameIdList() = default;
+  GameIdList(const uint8_t *data, size_t count) : data(data), count(count) {}
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  uint32_t operator[](size_t i) const {
+    const uint8_t *p = data + 4 * i;
+    return p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24;
+  }
+};
+
+// A database opened read-only; every file is memory-mapped, so opening is
+// constant time and lookups only touch the pages they read
+class GameDatabase {
+private:
+  MappedFile games, moves, index;
+  uint64_t gameCount = 0;
+  int bits = 0;
+  uint64_t keyCount = 0;
+  uint64_t postingCount = 0;
+  const uint8_t *directory = nullptr;
+  const uint8_t *keys = nullptr;
+  const uint8_t *postings = nullptr;
+
+public:
+  bool open(const std::string &base);
+  void close();
+  bool isOpen() const { return games.isOpen(); }
+
+  uint64_t size() const { return gameCount; }
+  // An empty header for ids past the last game
+  GameHeader getHeader(uint32_t game) const;
+  void getMoves(uint32_t game, std::vector<Move> &out) const;
+
+  // Empty when the index entries on the way are out of range, so a damaged
+  // index never reads outside its mapping or yields ids past the last game
+  GameIdList findGames(uint64_t key) const;
+  GameIdList findGames(const Position &pos) const {
+    return findGames(pos.getKey());
+  }
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "EngineWorker.h"
+#include "TimeManager.h"
+#include "Types.h"
+#include <cstdint>
+#include <optional>
+
+class Board;
+
+// Who plays each colour, and the clock they play on
+struct PlayOptions {
+  bool engineSide[2] = {false, false}; // Indexed by Color
+  int64_t initialMs = 0;               // Per side, 0 for no clock
+  int64_t incrementMs = 0;
+  int64_t untimedMoveMs = 1000; // The engine's time per move without a clock
+  bool ponder = true; // Search the expected reply during the human's turn
+};
+
+// A game between humans at the Board and the engine on an EngineWorker. It
+// runs both clocks, lets the engine move on its turns with a budget from
+// allocateTime, and while a human thinks has the engine search the position
+// after the reply it expects; if that reply comes the search carries on
+// with the budget for the move, otherwise it is cancelled. The engine only
+// searches moves the GUI rules allow as well. Clock time is passed in, so
+// nothing here depends on the windowing library.
+class GameSession {
+private:
+  Board &board;
+  EngineWorker &engine;
+  PlayOptions options;
+
+  int64_t remainingMs[2];
+  int64_t turnStartMs;     // When the side to move's clock started
+  uint64_t seenMoves;      // Board move count clocks are settled up to
+  std::optional<Color> flagged;
+  // The engine's side was left without a move it could play: the GUI rules
+  // allow none, or a king is missing or may be taken against them
+  bool stopped = false;
+
+  uint64_t searchId = 0; // Searching the move to play now, 0 for none
+  uint64_t ponderId = 0; // Searching the position after expectedReply
+  Move expectedReply;
+  // A ponder search that ended before the reply came, with its result
+  bool ponderFinished = false;
+  Move ponderBest;
+  Move ponderNext;
+  bool searchPondered = false; // searchId began as a ponder search
+
+  Color getSideToMove() const;
+  // The side to move, or the one that just moved until its move is settled
+  Color getRunningClock() const;
+  TimeBudget budgetFor(Color side, int64_t nowMs) const;
+  SearchLimits limitsFor(const TimeBudget &budget) const;
+  void settleClock(int64_t nowMs);
+  bool lastMoveWas(Move move) const;
+  // Restricts the root to the moves the GUI rules allow. False, after
+  // moving or stopping play, when there is nothing to search: a king that
+  // can be taken is taken, and with no allowed move the core calls legal
+  // one of the GUI's is played
+  bool prepareSearch(const Position &pos, SearchLimits &limits,
+                     int64_t nowMs);
+  // Plays the first move the GUI rules allow, or stops play without one
+  void playAllowedMove(int64_t nowMs);
+  void startSearch(int64_t nowMs);
+  void startPonder(Move reply);
+  bool playEngineMove(Move best, Move ponder, int64_t nowMs);
+  void cancelPonder();
+
+public:
+  GameSession(Board &board, EngineWorker &engine, const PlayOptions &options,
+              int64_t nowMs);
+
+  // Called every frame: charges moves made since to the clocks, checks the
+  // flags, plays the engine's moves and starts its searches
+  void update(int64_t nowMs);
+  // Has the engine find one move for a human side to move
+  void requestEngineMove(int64_t nowMs);
+
+  bool isHumanTurn() const;
+  bool isThinking() const { return searchId != 0; }
+  bool isTimed() const { return options.initialMs > 0; }
+  // What the side's clock shows at nowMs
+  int64_t getRemainingMs(Color side, int64_t nowMs) const;
+  // The side that ran out of time, if any
+  std::optional<Color> getFlagged() const { return flagged; }
+  // Play ended on a position the engine cannot search
+  bool hasStopped() const { return stopped; }
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// A whole file mapped read-only. Views into it stay valid until the
+// MappedFile is closed or destroyed.
+class MappedFile {
+private:
+  const char *data = nullptr;
+  size_t length = 0;
+
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile();
+
+  // sequential hints the kernel to read ahead aggressively
+  bool open(const std::string &path, bool sequential = true);
+  void close();
+
+  bool isOpen() const { return data != nullptr; }
+  size_t size() const { return length; }
+  std::string_view getView() const { return {data, length}; }
+};
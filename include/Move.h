@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Types.h"
+#include <cstdint>
+#include <string>
+
+enum class MoveFlag : uint8_t { Normal, Promotion, EnPassant, Castling };
+
+// A move packed into 16 bits:
+//   bits 0-5   origin square
+//   bits 6-11  destination square
+//   bits 12-13 promotion piece (Knight, Rook, Bishop, Queen)
+//   bits 14-15 MoveFlag
+// Castling is stored as the king's two-square step (e1g1).
+class Move {
+private:
+  uint16_t data = 0;
+
+public:
+  constexpr Move() = default;
+  constexpr explicit Move(uint16_t raw) : data(raw) {}
+  constexpr Move(int from, int to, MoveFlag flag = MoveFlag::Normal,
+                 PieceType promotion = PieceType::Knight)
+      : data(static_cast<uint16_t>(
+            from | (to << 6) | ((static_cast<int>(promotion) - 1) << 12) |
+            (static_cast<int>(flag) << 14))) {}
+
+  constexpr int getFrom() const { return data & 63; }
+  constexpr int getTo() const { return (data >> 6) & 63; }
+  constexpr MoveFlag getFlag() const { return MoveFlag(data >> 14); }
+  constexpr PieceType getPromotion() const {
+    return PieceType(((data >> 12) & 3) + 1);
+  }
+  constexpr uint16_t getRaw() const { return data; }
+  constexpr bool isNull() const { return data == 0; }
+
+  constexpr bool operator==(const Move &other) const = default;
+
+  std::string toUci() const {
+    std::string uci{char('a' + fileOf(getFrom())), char('1' + rankOf(getFrom())),
+                    char('a' + fileOf(getTo())), char('1' + rankOf(getTo()))};
+    if (getFlag() == MoveFlag::Promotion)
+      uci += "nrbq"[static_cast<int>(getPromotion()) - 1];
+    return uci;
+  }
+};
+
+// Fixed-capacity list so move generation never touches the heap
+struct MoveList {
+  Move moves[256];
+  int count = 0;
+
+  void add(Move m) { moves[count++] = m; }
+  int size() const { return count; }
+  Move *begin() { return moves; }
+  Move *end() { return moves + count; }
+  const Move *begin() const { return moves; }
+  const Move *end() const { return moves + count; }
+  Move &operator[](int i) { return moves[i]; }
+  const Move &operator[](int i) const { return moves[i]; }
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Position.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A small efficiently updatable network. Each perspective sees the board as
+// 768 piece-square inputs; they feed one shared hidden layer of clipped
+// ReLUs, and the two perspectives' activations, side to move first, feed a
+// single output.
+//
+// Weights are quantised: the input layer by QA, the output layer by QB, so
+// the output sum is in units of QA * QB. The file is little-endian: magic,
+// hidden size, input weights [768][hidden], hidden biases, output weights
+// [2][hidden] and the output bias as int32.
+namespace Nnue {
+
+constexpr int Inputs = 768;
+constexpr int MaxHidden = 1024;
+constexpr int QA = 255;
+constexpr int QB = 64;
+constexpr int OutputScale = 400; // Centipawns per unit of network output
+constexpr uint32_t Magic = 0x314E4E43; // "CNN1"
+
+// Input of a piece as seen by perspective: own pieces first, and the board
+// flipped for black so both sides share the weights
+constexpr int featureIndex(Color perspective, int piece, int square) {
+  int side = colorOf(piece) == perspective ? 0 : 1;
+  int relative = perspective == White ? square : flipRank(square);
+  return side * 384 + static_cast<int>(typeOf(piece)) * 64 + relative;
+}
+
+struct Accumulator {
+  alignas(32) int16_t values[2][MaxHidden]; // Indexed by perspective
+};
+
+class Network {
+private:
+  int hidden = 0;
+  std::vector<int16_t> inputWeights;
+  std::vector<int16_t> hiddenBias;
+  std::vector<int16_t> outputWeights;
+  int32_t outputBias = 0;
+
+public:
+  bool load(const std::string &path);
+  bool save(const std::string &path) const;
+  // Takes weights already quantised; hidden must be a multiple of 16
+  bool assign(int hidden, std::vector<int16_t> inputWeights,
+              std::vector<int16_t> hiddenBias,
+              std::vector<int16_t> outputWeights, int32_t outputBias);
+
+  int getHidden() const { return hidden; }
+
+  // Recomputes both perspectives from the pieces on the board
+  void refresh(const Position &pos, Accumulator &accumulator) const;
+  // Centipawns for the side to move
+  int output(const Accumulator &accumulator, Color sideToMove) const;
+  int evaluate(const Position &pos) const;
+};
+
+// The network evaluate() uses instead of the piece-square tables. Not to be
+// changed while a search is running.
+bool loadNetwork(const std::string &path);
+void unloadNetwork();
+const Network *getNetwork();
+
+} // namespace Nnue
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Position.h"
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// A position in 32 bytes, for datasets too large to keep as FEN:
+//   bytes 0-7    occupancy bitboard, little-endian
+//   bytes 8-23   piece code of each occupied square in square order, one
+//                nibble each, low nibble first
+//   byte 24      side to move in bit 0, castling rights in bits 1-4
+//   byte 25      en passant square, or 64 for none
+//   byte 26      halfmove clock, saturated at 255
+//   bytes 27-28  fullmove number, little-endian
+//   bytes 29-31  zero
+struct PackedPosition {
+  uint8_t bytes[32];
+
+  // False for boards with more than 32 pieces, which do not fit
+  bool pack(const Position &pos);
+  // Sets up pos, keys included. False unless the bytes hold a position
+  // pack could have written: at most 32 pieces with codes in range, zero
+  // padding, Position::isValid, castling rights only with their king and
+  // rook at home, and an en passant square only behind a pawn that just
+  // moved two squares and that a pawn can take.
+  bool unpack(Position &pos) const;
+
+  Bitboard getOccupied() const { return load64(0); }
+  Color getSideToMove() const { return Color(bytes[24] & 1); }
+
+  // Calls visit(square, piece) for every piece without building a Position,
+  // which is all feature extraction for training needs
+  template <typename Visit> void forEachPiece(Visit &&visit) const {
+    Bitboard occupied = getOccupied();
+    for (int half = 0; half < 2 && occupied; half++)
+      for (uint64_t nibbles = load64(8 + 8 * half), i = 0; occupied && i < 16;
+           i++, nibbles >>= 4)
+        visit(popLsb(occupied), int(nibbles & 15));
+  }
+
+private:
+  uint64_t load64(int offset) const {
+    uint64_t value;
+    std::memcpy(&value, bytes + offset, sizeof(value));
+    if constexpr (std::endian::native == std::endian::big)
+      value = std::byteswap(value);
+    return value;
+  }
+};
+
+static_assert(sizeof(PackedPosition) == 32);
+
+// One labelled position of a dataset. Stored as the packed position followed
+// by the score (little-endian), the result and a zero byte.
+struct PackedRecord {
+  PackedPosition position;
+  int16_t score;  // Search score in centipawns, for the side to move
+  int8_t result;  // 1 win, 0 draw, -1 loss, for the side to move
+};
+
+constexpr size_t PackedRecordSize = 36;
+
+void writePackedRecord(const PackedRecord &record, uint8_t *out);
+
+inline PackedRecord readPackedRecord(const uint8_t *in) {
+  PackedRecord record;
+  std::memcpy(record.position.bytes, in, sizeof(record.position.bytes));
+  record.score = static_cast<int16_t>(in[32] | in[33] << 8);
+  record.result = static_cast<int8_t>(in[34]);
+  return record;
+}
+
+// A stream of packed records, memory-mapped read-only
+class PackedReader {
+private:
+  MappedFile file;
+  size_t records = 0;
+
+public:
+  bool open(const std::string &path);
+  size_t size() const { return records; }
+  PackedRecord get(size_t index) const {
+    return readPackedRecord(
+        reinterpret_cast<const uint8_t *>(file.getView().data()) +
+        index * PackedRecordSize);
+  }
+};
+
+// A dataset file many threads append to at once without a lock: each write
+// reserves its range with an atomic add on the end offset, then fills it
+// with pwrite
+class PackedFile {
+private:
+  int fd = -1;
+  std::atomic<uint64_t> end{0};
+
+public:
+  PackedFile() = default;
+  PackedFile(const PackedFile &) = delete;
+  PackedFile &operator=(const PackedFile &) = delete;
+  ~PackedFile();
+
+  bool open(const std::string &path, bool append = false);
+  bool isOpen() const { return fd >= 0; }
+  bool close();
+
+  // Writes size bytes of whole records somewhere after everything already
+  // reserved
+  bool append(const uint8_t *data, size_t size);
+  uint64_t getRecords() const { return end / PackedRecordSize; }
+};
+
+// Collects one thread's records and hands them to a PackedFile in large
+// blocks. Flushed on destruction.
+class PackedWriter {
+private:
+  PackedFile &file;
+  std::vector<uint8_t> buffer;
+  size_t used = 0;
+
+public:
+  explicit PackedWriter(PackedFile &file, size_t bufferRecords = 1 << 14);
+  PackedWriter(const PackedWriter &) = delete;
+  PackedWriter &operator=(const PackedWriter &) = delete;
+  ~PackedWriter();
+
+  bool write(const PackedRecord &record);
+  bool flush();
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Position.h"
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+struct PgnTag {
+  std::string_view name;
+  std::string_view value; // As written, escapes included
+};
+
+// One game as views into the parsed text, which must outlive it. The vectors
+// keep their capacity when a PgnGame is reused, so parsing game after game
+// into the same object does not allocate.
+struct PgnGame {
+  std::string_view text; // The whole game, tags included
+  std::vector<PgnTag> tags;
+  std::vector<std::string_view> moves; // SAN, main line only
+  std::string_view result; // "1-0", "0-1", "1/2-1/2" or "*"
+
+  std::string_view getTag(std::string_view name) const;
+};
+
+// Splits PGN text into games without copying it. Tag pairs are kept;
+// comments, variations, NAGs, escape lines and move numbers are skipped.
+class PgnParser {
+private:
+  std::string_view input;
+  size_t offset = 0;
+
+public:
+  explicit PgnParser(std::string_view input) : input(input) {}
+
+  // Fills game with the next game; false once the text is exhausted
+  bool next(PgnGame &game);
+  size_t getOffset() const { return offset; }
+};
+
+// The legal move written in standard algebraic notation, or a null move
+Move parseSan(const Position &pos, std::string_view san);
+
+// Plays game's moves from the start position into pos, collecting them in
+// moves; false at the first move that does not parse or for games set up from
+// a FEN
+bool replayGame(const PgnGame &game, Position &pos, std::vector<Move> &moves);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Pgn.h"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct ImportedGame {
+  PgnGame game;
+  std::vector<Move> moves; // Replayed main line, up to any bad move
+  bool legal = false;      // Every move replayed from the start position
+};
+
+// The games of one chunk, in file order
+struct PgnChunk {
+  size_t index = 0;
+  std::vector<ImportedGame> games;
+};
+
+// Splits PGN text at game boundaries into chunks of about chunkBytes, then
+// parses and replays them on worker threads. Chunks come out of next in file
+// order. At most capacity chunks are in flight, so workers that get ahead of
+// the reader wait rather than buffer the whole file. The text must outlive
+// both the pipeline and every chunk taken from it.
+class PgnPipeline {
+private:
+  struct Slot {
+    PgnChunk chunk;
+    bool ready = false;
+  };
+
+  std::string_view text;
+  std::vector<size_t> boundaries; // Chunk i is [boundaries[i], [i + 1])
+  std::vector<Slot> slots;        // Chunk i goes to slot i % capacity
+
+  std::mutex mutex;
+  std::condition_variable chunkReady, slotFree;
+  size_t claimed = 0;   // Chunks handed to workers
+  size_t delivered = 0; // Chunks handed to the reader
+  bool stopping = false;
+  std::vector<std::thread> workers;
+
+  void work();
+  void importChunk(size_t index, PgnChunk &chunk) const;
+
+public:
+  PgnPipeline(std::string_view text, unsigned threads,
+              size_t chunkBytes = size_t{1} << 20, size_t capacity = 0);
+  PgnPipeline(const PgnPipeline &) = delete;
+  PgnPipeline &operator=(const PgnPipeline &) = delete;
+  ~PgnPipeline();
+
+  // Swaps the next chunk into chunk, whose old storage is reused for a later
+  // chunk; false once every chunk has been delivered
+  bool next(PgnChunk &chunk);
+  size_t getChunks() const { return boundaries.size() - 1; }
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "Bitboard.h"
+#include "Move.h"
+#include "Types.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum CastlingRight : uint8_t {
+  WhiteKingSide = 1,
+  WhiteQueenSide = 2,
+  BlackKingSide = 4,
+  BlackQueenSide = 8
+};
+
+constexpr std::string_view StartFen =
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+// Room writeFen needs, whatever the position and clocks
+constexpr size_t MaxFenLength = 128;
+
+// Everything makeMove destroys and unmakeMove needs back
+struct UndoInfo {
+  uint64_t key;
+  int8_t captured;
+  uint8_t castlingRights;
+  int8_t epSquare;
+  uint16_t halfmoveClock;
+};
+
+// Headless game state: piece bitboards plus a mailbox, side to move,
+// castling rights, en passant square, clocks and an incremental Zobrist key.
+// Move generation only ever produces legal moves.
+class Position {
+private:
+  std::array<Bitboard, 12> pieceBB{}; // indexed by piece code
+  std::array<Bitboard, 2> colorBB{};
+  std::array<int8_t, 64> board;
+  Color sideToMove = White;
+  uint8_t castlingRights = 0;
+  int epSquare = NoSquare;
+  int halfmoveClock = 0;
+  int fullmoveNumber = 1;
+  uint64_t key = 0;
+  uint64_t materialKey = 0;
+  std::vector<UndoInfo> history;
+
+  void movePieceTo(int from, int to);
+  bool isLegal(Move m) const;
+  template <bool CapturesOnly> void generate(MoveList &list) const;
+
+public:
+  Position();
+
+  void clear();
+  void setStartPos();
+  void putPiece(Color c, PieceType type, int square);
+  void removePiece(int square);
+  void setSideToMove(Color c);
+  void setCastlingRights(uint8_t rights);
+  void setEpSquare(int square);
+  void setClocks(int halfmove, int fullmove);
+
+  // Sets up the position of a FEN or EPD record. The clocks are optional and
+  // whatever follows the fields (EPD operations) is ignored. Castling rights
+  // without their king and rook, and en passant squares no pawn just crossed
+  // or no pawn can take, are dropped, as makeMove would. On failure the
+  // position is left empty.
+  bool setFen(std::string_view fen);
+  // One king each, no pawn on the first or last rank and the side to move
+  // unable to take the other king: what move generation and search assume
+  bool isValid() const;
+  // Writes the FEN without allocating into out, which must hold
+  // MaxFenLength chars, and returns its length
+  size_t writeFen(char *out) const;
+  std::string getFen() const;
+
+  Bitboard getPieces(Color c, PieceType type) const {
+    return pieceBB[makePiece(c, type)];
+  }
+  Bitboard getPieces(PieceType type) const {
+    return getPieces(White, type) | getPieces(Black, type);
+  }
+  Bitboard getPieces(Color c) const { return colorBB[c]; }
+  Bitboard getOccupied() const { return colorBB[White] | colorBB[Black]; }
+  int getPieceOn(int square) const { return board[square]; }
+  int getKingSquare(Color c) const {
+    return lsb(getPieces(c, PieceType::King));
+  }
+  Color getSideToMove() const { return sideToMove; }
+  uint8_t getCastlingRights() const { return castlingRights; }
+  int getEpSquare() const { return epSquare; }
+  int getHalfmoveClock() const { return halfmoveClock; }
+  int getFullmoveNumber() const { return fullmoveNumber; }
+  uint64_t getKey() const { return key; }
+  // Piece counts packed four bits per piece code, so equal keys always mean
+  // equal material
+  uint64_t getMaterialKey() const { return materialKey; }
+  int getPieceCount() const { return popCount(getOccupied()); }
+
+  Bitboard attackersTo(int square, Bitboard occupied) const;
+  bool isSquareAttacked(int square, Color by) const;
+  bool inCheck() const;
+
+  void generateLegalMoves(MoveList &list) const;
+  // Captures and queen promotions, for quiescence search
+  void generateCaptures(MoveList &list) const;
+  bool isCapture(Move m) const;
+
+  void makeMove(Move m);
+  void unmakeMove(Move m);
+  void makeNullMove();
+  void unmakeNullMove();
+
+  // Retrograde support for the tablebase generator. Lists the non-capturing,
+  // non-promoting moves of the side that just moved which could have led to
+  // this position, and steps back over one of them.
+  void generateUnmoves(MoveList &list) const;
+  void retractMove(Move m);
+
+  bool isRepetition() const;
+  bool hasInsufficientMaterial() const;
+  bool isDraw() const;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Endgame.h"
+#include "Position.h"
+#include "TranspositionTable.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class Tablebases;
+
+constexpr int MaxPly = 128;
+constexpr int MateScore = 32000;
+// Scores beyond this are forced mates
+constexpr int MateBound = MateScore - 2 * MaxPly - 256;
+constexpr int InfiniteScore = 32001;
+
+struct SearchLimits {
+  int depth = MaxPly - 1;
+  uint64_t nodes = 0;     // 0 for no limit
+  int64_t moveTimeMs = 0; // 0 for no limit
+  int64_t softTimeMs = 0; // No new iteration after this, 0 for no limit
+  int multiPV = 1;        // Best lines reported per iteration
+  // Root moves to consider, empty for all
+  std::vector<Move> searchMoves;
+};
+
+// Reported after every completed iteration, once for each line with
+// multiPV
+struct SearchInfo {
+  int depth;
+  int score;
+  uint64_t nodes;
+  uint64_t tbHits;
+  int64_t elapsedMs;
+  std::vector<Move> pv;
+  int line = 1; // 1 for the best line, 2 for the next best and so on
+};
+
+// Iterative deepening alpha-beta. One Search belongs to one thread; its node
+// and tablebase hit counters are not shared, the tablebases themselves are.
+class Search {
+private:
+  Position pos;
+  TranspositionTable tt;
+  MaterialCache materials;
+  const Tablebases *tablebases = nullptr;
+  std::atomic<bool> stopRequested{false};
+  bool aborted = false;
+
+  SearchLimits limits;
+  std::chrono::steady_clock::time_point startTime;
+  // Since startTime, 0 for none; another thread may move them
+  std::atomic<int64_t> softDeadlineMs{0};
+  std::atomic<int64_t> hardDeadlineMs{0};
+  // Root moves the current line may not play: earlier multiPV lines and
+  // anything outside searchMoves
+  std::vector<Move> excludedRootMoves;
+  uint64_t nodes = 0;
+  uint64_t tbHits = 0;
+
+  Move killers[MaxPly][2];
+  int history[2][64][64];
+  Move pvTable[MaxPly][MaxPly];
+  int pvLength[MaxPly];
+
+  int negamax(int depth, int ply, int alpha, int beta, bool allowNull);
+  int quiescence(int ply, int alpha, int beta);
+  void scoreMoves(const MoveList &moves, Move ttMove, int ply,
+                  int *scores) const;
+  bool shouldStop();
+  bool isExcludedAtRoot(Move m) const;
+  int64_t elapsedMs() const;
+
+public:
+  explicit Search(size_t hashMegabytes = 16);
+
+  // Probed at every node once few enough pieces are left; may be null
+  void setTablebases(const Tablebases *tablebases);
+  void setHashSize(size_t megabytes);
+  void clearHash();
+
+  Move think(const Position &root, const SearchLimits &limits,
+             const std::function<void(const SearchInfo &)> &onIteration = {});
+  // Safe to call from another thread
+  void stop();
+  // Replaces the time limits by budgets counted from now, as on a ponder
+  // hit; 0 for no limit. Safe to call from another thread.
+  void setTimeLimits(int64_t softMs, int64_t hardMs);
+
+  uint64_t getNodes() const { return nodes; }
+  uint64_t getTbHits() const { return tbHits; }
+  int hashfull() const { return tt.hashfull(); }
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+// Run files for builders that collect more records than fit in memory: each
+// batch is sorted and written to a run of its own, and mergeRuns reads all
+// runs back as one sequence in the same order.
+//
+// Format gives the layout of a record in a run: its Record type, its Size
+// in bytes, and static store(record, out) and load(in) functions. Less is
+// the order runs are sorted in.
+
+// Appends records to one run; they must arrive in order
+template <typename Format> class RunWriter {
+private:
+  std::ofstream out;
+
+public:
+  explicit RunWriter(const std::string &path)
+      : out(path, std::ios::binary | std::ios::trunc) {}
+
+  void write(const typename Format::Record &record) {
+    uint8_t bytes[Format::Size];
+    Format::store(record, bytes);
+    out.write(reinterpret_cast<const char *>(bytes), Format::Size);
+  }
+
+  // False if the run could not be written in full
+  bool close() {
+    out.close();
+    return static_cast<bool>(out);
+  }
+};
+
+// Sorts records and writes them as a new run at path
+template <typename Format, typename Less = std::less<typename Format::Record>>
+bool writeSortedRun(const std::string &path,
+                    std::vector<typename Format::Record> &records,
+                    Less less = {}) {
+  std::sort(records.begin(), records.end(), less);
+  RunWriter<Format> writer(path);
+  for (const typename Format::Record &record : records)
+    writer.write(record);
+  return writer.close();
+}
+
+// Reads one run back a block of records at a time
+template <typename Format> class RunReader {
+private:
+  static constexpr size_t BlockRecords = 4096;
+
+  std::ifstream in;
+  std::vector<uint8_t> block;
+  size_t position = 0, filled = 0;
+  typename Format::Record current{};
+
+public:
+  explicit RunReader(const std::string &path)
+      : in(path, std::ios::binary), block(BlockRecords * Format::Size) {}
+
+  bool isOpen() const { return in.is_open(); }
+
+  // Moves to the next record; false at the end of the run
+  bool advance() {
+    if (position == filled) {
+      in.read(reinterpret_cast<char *>(block.data()), block.size());
+      filled = in.gcount() / Format::Size;
+      position = 0;
+      if (!filled)
+        return false;
+    }
+    current = Format::load(block.data() + position++ * Format::Size);
+    return true;
+  }
+
+  const typename Format::Record &get() const { return current; }
+};
+
+// Calls visit(record) for the records of every run in order. Records that
+// compare equal arrive one after another, whichever runs they come from.
+// False if a run could not be opened.
+template <typename Format, typename Less = std::less<typename Format::Record>,
+          typename Visit>
+bool mergeRuns(const std::vector<std::string> &runs, Visit &&visit,
+               Less less = {}) {
+  std::vector<std::unique_ptr<RunReader<Format>>> readers;
+  auto later = [&](size_t a, size_t b) {
+    return less(readers[b]->get(), readers[a]->get());
+  };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(
+      later);
+
+  for (const std::string &run : runs) {
+    readers.push_back(std::make_unique<RunReader<Format>>(run));
+    if (!readers.back()->isOpen())
+      return false;
+    if (readers.back()->advance())
+      heap.push(readers.size() - 1);
+  }
+
+  while (!heap.empty()) {
+    size_t top = heap.top();
+    heap.pop();
+    visit(readers[top]->get());
+    if (readers[top]->advance())
+      heap.push(top);
+  }
+  return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <utility>
+
+// A bounded queue between exactly one producing and one consuming thread,
+// without locks: each side owns one index and only reads the other's. Slots
+// are reused in place, so values are moved in and out rather than
+// constructed and destroyed.
+template <typename T, size_t Capacity> class SpscQueue {
+private:
+  static_assert(std::has_single_bit(Capacity));
+
+  std::array<T, Capacity> slots{};
+  // The next slot to pop, moved by the consumer, and the next to push, moved
+  // by the producer, on separate cache lines so the threads do not share one
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+
+public:
+  // Producer only; false if the queue is full
+  bool push(T &&value) {
+    size_t back = tail.load(std::memory_order_relaxed);
+    if (back - head.load(std::memory_order_acquire) == Capacity)
+      return false;
+    slots[back & (Capacity - 1)] = std::move(value);
+    tail.store(back + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only; false if the queue is empty
+  bool pop(T &value) {
+    size_t front = head.load(std::memory_order_relaxed);
+    if (front == tail.load(std::memory_order_acquire))
+      return false;
+    value = std::move(slots[front & (Capacity - 1)]);
+    head.store(front + 1, std::memory_order_release);
+    return true;
+  }
+};
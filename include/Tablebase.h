@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Position.h"
+#include "Types.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Endgame tables store one byte per indexed position, from the point of view
+// of the side to move:
+//   0         draw (or an index that is not a legal position)
+//   1..127    win, mate in 2 * value - 1 plies
+//   128..255  loss, mated in 2 * (value - 128) plies
+namespace TbValue {
+constexpr uint8_t Draw = 0;
+constexpr uint8_t winIn(int plies) { return (plies + 1) / 2; }
+constexpr uint8_t lossIn(int plies) { return 128 + plies / 2; }
+constexpr bool isWin(uint8_t v) { return v != 0 && v < 128; }
+constexpr bool isLoss(uint8_t v) { return v >= 128; }
+constexpr int plies(uint8_t v) {
+  return isWin(v) ? 2 * v - 1 : isLoss(v) ? 2 * (v - 128) : 0;
+}
+} // namespace TbValue
+
+// A material set such as "KRPKR". White always holds the stronger half so
+// each set is stored once; positions with the colours the other way round
+// are probed with the board flipped.
+struct MaterialSignature {
+  std::vector<PieceType> white; // Non-king pieces, strongest first
+  std::vector<PieceType> black;
+
+  static std::optional<MaterialSignature> parse(std::string_view name);
+  static MaterialSignature fromPosition(const Position &pos);
+
+  std::string getName() const;
+  int getPieceCount() const { return 2 + white.size() + black.size(); }
+  bool hasPawns() const;
+  // Swaps the sides if black holds the stronger half; returns true if it did
+  bool canonicalize();
+};
+
+// Maps positions of one material set onto a dense index. The white king is
+// folded into a1-d1-d4 (files a-d once pawns are on the board) by mirroring;
+// the black king and the remaining pieces take 64 squares each.
+class TablebaseLayout {
+private:
+  MaterialSignature signature;
+  std::vector<Color> colors; // Per non-king piece, white's first
+  std::vector<PieceType> types;
+  bool pawns;
+  uint64_t kingSquares;
+  uint64_t size;
+
+public:
+  explicit TablebaseLayout(const MaterialSignature &signature);
+
+  const MaterialSignature &getSignature() const { return signature; }
+  uint64_t getSize() const { return size; }
+
+  // Index of pos, which must carry this layout's material. With flipped set
+  // the board is read with colours swapped and ranks mirrored.
+  uint64_t index(const Position &pos, bool flipped) const;
+  // Sets up the position at idx; false if the index is not a legal position
+  // or is a duplicate of another index
+  bool decode(uint64_t idx, Position &pos) const;
+};
+
+// Packed piece counts naming a material set. With flipped set the position
+// is read with the colours swapped.
+uint64_t tablebaseId(const MaterialSignature &signature);
+uint64_t tablebaseId(const Position &pos, bool flipped);
+
+struct TablebaseHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t pieceCount;
+  char signature[16];
+  uint64_t entries;
+};
+
+constexpr char TablebaseMagic[8] = {'C', 'H', 'E', 'S', 'S', 'T', 'B', '\0'};
+constexpr uint32_t TablebaseVersion = 1;
+constexpr const char *TablebaseExtension = ".ctb";
+
+// Every table in a directory, memory-mapped read-only. Probing only reads the
+// mappings, so all search threads share one instance without locking.
+// Positions with castling rights or an en passant capture are never probed,
+// the tables do not model either.
+class Tablebases {
+private:
+  struct MappedTable {
+    TablebaseLayout layout;
+    const uint8_t *values;
+    void *mapping;
+    size_t length;
+  };
+
+  std::unordered_map<uint64_t, MappedTable> tables;
+  int maxPieces = 0;
+
+  const MappedTable *find(const Position &pos, bool &flipped) const;
+
+public:
+  Tablebases() = default;
+  Tablebases(const Tablebases &) = delete;
+  Tablebases &operator=(const Tablebases &) = delete;
+  ~Tablebases();
+
+  // Maps every table found in directory, returns how many were added
+  int load(const std::string &directory);
+  int getMaxPieces() const { return maxPieces; }
+  bool canProbe(const Position &pos) const;
+
+  // Starts pulling the page holding pos into cache ahead of probe
+  void prefetch(const Position &pos) const;
+  // TbValue for the side to move
+  std::optional<uint8_t> probe(const Position &pos) const;
+  // The root move that keeps the best result by distance to mate, or a null
+  // move if the position or one of its successors is not covered
+  Move probeRoot(Position &pos, uint8_t &value) const;
+};
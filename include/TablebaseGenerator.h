@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Tablebase.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Builds win/draw/loss and distance-to-mate tables by retrograde analysis.
+// Mates are found first; each following pass walks back from the positions
+// resolved in the previous pass with Position::generateUnmoves. Captures and
+// promotions leave the table, so the smaller tables they lead to are built
+// first and probed directly.
+class TablebaseGenerator {
+private:
+  struct Table {
+    TablebaseLayout layout;
+    std::vector<uint8_t> values;
+  };
+
+  // Finished tables, keyed by packed piece counts
+  std::map<uint64_t, std::unique_ptr<Table>> tables;
+  std::vector<MaterialSignature> generated;
+  unsigned threads;
+
+  // Value of pos for the side to move, from a finished table
+  uint8_t probe(const Position &pos) const;
+  std::unique_ptr<Table> build(const MaterialSignature &signature);
+
+public:
+  explicit TablebaseGenerator(unsigned threads);
+
+  // Generates signature and every table it converts into
+  const std::vector<uint8_t> &generate(MaterialSignature signature);
+  // Every table built so far, in build order
+  const std::vector<MaterialSignature> &getGenerated() const {
+    return generated;
+  }
+  bool write(const MaterialSignature &signature,
+             const std::string &directory) const;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+// One side's clock as a GUI reports it before a move
+struct TimeControl {
+  int64_t remainingMs = 0;
+  int64_t incrementMs = 0;
+  int movesToGo = 0;       // Moves until the next time control, 0 for none
+  int64_t overheadMs = 30; // Lost per move to communication and scheduling
+};
+
+// How long to think about one move. No new iteration starts after the soft
+// budget; the search is stopped outright at the hard one.
+struct TimeBudget {
+  int64_t softMs;
+  int64_t hardMs;
+};
+
+// Spends an even share of the clock over the moves expected before the next
+// control (or a fixed horizon in sudden death) plus most of the increment,
+// and never more than the clock minus the overhead
+TimeBudget allocateTime(const TimeControl &control);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Move.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class Bound : uint8_t { None, Upper, Lower, Exact };
+
+struct TTEntry {
+  uint64_t key = 0;
+  Move move;
+  int16_t score = 0;
+  int8_t depth = 0;
+  Bound bound = Bound::None;
+  uint8_t generation = 0;
+};
+
+// Always-replace hash table of search results, sized in megabytes
+class TranspositionTable {
+private:
+  std::vector<TTEntry> entries;
+  uint8_t generation = 0;
+
+public:
+  explicit TranspositionTable(size_t megabytes = 16);
+
+  void resize(size_t megabytes);
+  void clear();
+  void newSearch() { generation++; }
+
+  bool probe(uint64_t key, TTEntry &entry) const;
+  void store(uint64_t key, Move move, int score, int depth, Bound bound);
+  void prefetch(uint64_t key) const;
+  // Permille of a sample of entries written during the current search
+  int hashfull() const;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+// Order matches the columns of the piece sprite sheets
+enum class PieceType { Pawn, Knight, Rook, Bishop, Queen, King };
+
+enum Color : uint8_t { White, Black };
+
+constexpr int PieceTypeCount = 6;
+constexpr int NoSquare = -1;
+
+// Squares run a1 = 0 ... h8 = 63. The GUI grid is indexed from the top of the
+// window (row 0 is rank 8), so grid (col, row) is square (7 - row) * 8 + col.
+constexpr int makeSquare(int file, int rank) { return rank * 8 + file; }
+constexpr int fileOf(int square) { return square & 7; }
+constexpr int rankOf(int square) { return square >> 3; }
+constexpr int flipRank(int square) { return square ^ 56; }
+constexpr int flipFile(int square) { return square ^ 7; }
+
+// King steps between two squares
+constexpr int squareDistance(int a, int b) {
+  int files = fileOf(a) - fileOf(b), ranks = rankOf(a) - rankOf(b);
+  files = files < 0 ? -files : files;
+  ranks = ranks < 0 ? -ranks : ranks;
+  return files > ranks ? files : ranks;
+}
+
+constexpr Color operator~(Color c) { return Color(c ^ 1); }
+
+// Pieces on the board are coded as color * 6 + type, -1 for an empty square
+constexpr int NoPiece = -1;
+constexpr int makePiece(Color c, PieceType type) {
+  return c * PieceTypeCount + static_cast<int>(type);
+}
+constexpr Color colorOf(int piece) { return Color(piece / PieceTypeCount); }
+constexpr PieceType typeOf(int piece) {
+  return PieceType(piece % PieceTypeCount);
+}
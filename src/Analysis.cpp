@@ -0,0 +1,52 @@
+#include "Analysis.h"
+#include "Board.h"
+#include "Position.h"
+
+Analysis::Analysis(int lineCount, size_t hashMegabytes)
+    : engine(hashMegabytes), lineCount(lineCount) {}
+
+void Analysis::update(const Board &board) {
+  // A pawn waiting to be promoted is not a position yet
+  if (board.getGameState() != GameState::Playing || board.checkIfWon()) {
+    stop();
+    return;
+  }
+
+  // A side may leave its king attacked under the GUI rules; such a position
+  // has no analysis, so the arrows and the bar go away until the next one
+  Position pos = board.getPosition();
+  if (!pos.isValid()) {
+    stop();
+    return;
+  }
+  if (!searchId || pos.getKey() != analysedKey) {
+    // Starting a search cancels the one before, which stops at its next
+    // node check
+    SearchLimits limits;
+    limits.multiPV = lineCount;
+    searchId = engine.startSearch(pos, limits);
+    analysedKey = pos.getKey();
+    whiteToMove = pos.getSideToMove() == White;
+    lines.clear();
+  }
+
+  EngineEvent event;
+  while (engine.poll(event)) {
+    if (event.kind != EngineEvent::Kind::Info || event.searchId != searchId ||
+        event.info.line > lineCount)
+      continue;
+    if (lines.size() < size_t(event.info.line))
+      lines.resize(event.info.line);
+    AnalysisLine &line = lines[event.info.line - 1];
+    line.depth = event.info.depth;
+    line.score = whiteToMove ? event.info.score : -event.info.score;
+    line.pv = std::move(event.info.pv);
+  }
+}
+
+void Analysis::stop() {
+  if (searchId)
+    engine.cancel();
+  searchId = 0;
+  lines.clear();
+}
@@ -0,0 +1,86 @@
+#include "BatchEvaluator.h"
+#include "Evaluation.h"
+#include <algorithm>
+
+BatchEvaluator::BatchEvaluator(unsigned threads) {
+  if (!threads)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 1; i < threads; i++)
+    workers.emplace_back([this] { run(); });
+}
+
+BatchEvaluator::~BatchEvaluator() {
+  {
+    std::lock_guard lock(mutex);
+    quitting = true;
+  }
+  started.notify_all();
+  for (std::thread &worker : workers)
+    worker.join();
+}
+
+void BatchEvaluator::run() {
+  MaterialCache materials;
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock lock(mutex);
+      started.wait(lock, [&] { return quitting || generation != seen; });
+      if (quitting)
+        return;
+      seen = generation;
+    }
+    work(materials);
+    std::lock_guard lock(mutex);
+    if (--running == 0)
+      finished.notify_one();
+  }
+}
+
+void BatchEvaluator::work(MaterialCache &materials) {
+  Position pos;
+  size_t valid = 0;
+  for (size_t begin; (begin = next.fetch_add(Chunk)) < positions.size();) {
+    size_t end = std::min(begin + Chunk, positions.size());
+    for (size_t i = begin; i < end; i++) {
+      if (positions[i].unpack(pos)) {
+        scores[i] = ::evaluate(pos, materials);
+        valid++;
+      } else
+        scores[i] = NoScore;
+    }
+  }
+  unpacked += valid;
+}
+
+size_t BatchEvaluator::evaluate(std::span<const PackedPosition> batch,
+                                std::span<int> results) {
+  std::lock_guard batchLock(batchMutex);
+  positions = batch.first(std::min(batch.size(), results.size()));
+  scores = results;
+  next = 0;
+  unpacked = 0;
+
+  // Waking the pool costs more than a single chunk takes
+  if (positions.size() <= Chunk || workers.empty()) {
+    work(callerMaterials);
+    return unpacked;
+  }
+
+  {
+    std::lock_guard lock(mutex);
+    generation++;
+    running = workers.size();
+  }
+  started.notify_all();
+  work(callerMaterials);
+  std::unique_lock lock(mutex);
+  finished.wait(lock, [&] { return running == 0; });
+  return unpacked;
+}
+
+size_t evaluateBatch(std::span<const PackedPosition> positions,
+                     std::span<int> scores) {
+  static BatchEvaluator shared;
+  return shared.evaluate(positions, scores);
+}
@@ -0,0 +1,138 @@
+#include "Bitbase.h"
+#include "Bitboard.h"
+#include <cstdint>
+
+namespace {
+
+// For every side to move, pawn and white king square, the black king squares
+// that win for white. Solving whole sets of black king squares at once keeps
+// the work small enough for the compiler; plain arrays are cheaper to
+// evaluate than std::array.
+struct KPKTable {
+  Bitboard wins[2][24][64];
+};
+
+constexpr int pawnIndex(int pawn) {
+  return (rankOf(pawn) - 1) * 4 + fileOf(pawn);
+}
+
+// Squares one king step away from any square in b
+constexpr Bitboard kingNeighbours(Bitboard b) {
+  Bitboard sideways = (b & ~FileH) << 1 | (b & ~FileA) >> 1;
+  Bitboard row = b | sideways;
+  return sideways | row << 8 | row >> 8;
+}
+
+// Black king squares where a promotion wins outright: the new queen or rook
+// cannot be taken and does not stalemate
+constexpr Bitboard promotionWins(int whiteKing, int pawn) {
+  int promotion = pawn + 8;
+  if (rankOf(pawn) != 6 || promotion == whiteKing)
+    return 0;
+
+  Bitboard wins = 0;
+  for (int blackKing = 0; blackKing < 64; blackKing++) {
+    if (blackKing == promotion ||
+        ((kingAttacks(blackKing) & squareBB(promotion)) &&
+         !(kingAttacks(whiteKing) & squareBB(promotion))))
+      continue;
+
+    Bitboard occupied =
+        squareBB(whiteKing) | squareBB(promotion) | squareBB(blackKing);
+    for (PieceType type : {PieceType::Queen, PieceType::Rook}) {
+      Bitboard attacked =
+          kingAttacks(whiteKing) | pieceAttacks(type, promotion, occupied);
+      if ((attacked & squareBB(blackKing)) ||
+          (kingAttacks(blackKing) & ~attacked))
+        wins |= squareBB(blackKing);
+    }
+  }
+  return wins;
+}
+
+constexpr KPKTable kpk = [] {
+  KPKTable table{};
+  Bitboard(&wins)[2][24][64] = table.wins;
+  // Touching every entry once up front makes the later writes much cheaper
+  // for the compiler to evaluate
+  for (auto &side : wins)
+    for (auto &pawns : side)
+      for (Bitboard &b : pawns)
+        b = 0;
+
+  Bitboard promotions[64][24];
+  for (int whiteKing = 0; whiteKing < 64; whiteKing++)
+    for (int p = 0; p < 24; p++)
+      promotions[whiteKing][p] =
+          promotionWins(whiteKing, makeSquare(p % 4, p / 4 + 1));
+
+  // Wins are propagated backwards until nothing changes; every position
+  // left unresolved is a draw
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (int p = 23; p >= 0; p--) {
+      int pawn = makeSquare(p % 4, p / 4 + 1);
+      Bitboard pawnCover = pawnAttacks(White, pawn);
+
+      for (int whiteKing = 0; whiteKing < 64; whiteKing++) {
+        if (whiteKing == pawn)
+          continue;
+        Bitboard valid = ~(squareBB(whiteKing) | kingAttacks(whiteKing) |
+                           squareBB(pawn));
+
+        // White to move wins if any move reaches a black-to-move win
+        Bitboard white = promotions[whiteKing][p];
+        Bitboard kingMoves = kingAttacks(whiteKing) & ~squareBB(pawn);
+        while (kingMoves)
+          white |= wins[Black][p][popLsb(kingMoves)];
+        int push = pawn + 8;
+        if (rankOf(pawn) < 6 && push != whiteKing) {
+          white |= wins[Black][p + 4][whiteKing] & ~squareBB(push);
+          if (rankOf(pawn) == 1 && push + 8 != whiteKing)
+            white |= wins[Black][p + 8][whiteKing] &
+                     ~(squareBB(push) | squareBB(push + 8));
+        }
+        white &= valid & ~pawnCover;
+
+        // Black to move loses if no king move avoids a white-to-move win,
+        // and there is at least one move or the king is in check
+        Bitboard attacked = kingAttacks(whiteKing) | pawnCover;
+        if (kingAttacks(whiteKing) & squareBB(pawn))
+          attacked |= squareBB(pawn);
+        Bitboard black = valid & ~kingNeighbours(~attacked & ~white) &
+                         (kingNeighbours(~attacked) | pawnCover);
+
+        if (white != wins[White][p][whiteKing] ||
+            black != wins[Black][p][whiteKing]) {
+          wins[White][p][whiteKing] = white;
+          wins[Black][p][whiteKing] = black;
+          changed = true;
+        }
+      }
+    }
+  }
+  return table;
+}();
+
+} // namespace
+
+namespace Bitbases {
+
+bool probeKPK(Color strongSide, int strongKing, int pawn, int weakKing,
+              Color sideToMove) {
+  if (strongSide == Black) {
+    strongKing = flipRank(strongKing);
+    pawn = flipRank(pawn);
+    weakKing = flipRank(weakKing);
+  }
+  if (fileOf(pawn) > 3) {
+    strongKing = flipFile(strongKing);
+    pawn = flipFile(pawn);
+    weakKing = flipFile(weakKing);
+  }
+
+  Color stm = sideToMove == strongSide ? White : Black;
+  return kpk.wins[stm][pawnIndex(pawn)][strongKing] & squareBB(weakKing);
+}
+
+} // namespace Bitbases
@@ -0,0 +1,511 @@
+#include <glad/glad.h>
+
+#include "BoardRenderer.h"
+#include "Analysis.h"
+#include "Board.h"
+#include "Piece.h"
+#include "Shader.h"
+#include "SpriteSheet.h"
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+// Best line first; later lines are drawn thinner and fainter
+const glm::vec4 lineColors[] = {{0.1f, 0.6f, 0.2f, 0.8f},
+                                {0.2f, 0.4f, 0.8f, 0.6f},
+                                {0.8f, 0.5f, 0.1f, 0.5f}};
+constexpr float EvalBarWidth = 12;
+
+} // namespace
+
+BoardRenderer::BoardRenderer(SpriteSheet &blackSheet, SpriteSheet &whiteSheet)
+    : blackSheet(blackSheet), whiteSheet(whiteSheet) {
+  generateVertices();
+
+  glGenBuffers(1, &VBO);
+  glGenBuffers(1, &EBO);
+  glGenVertexArrays(1, &VAO);
+
+  glBindVertexArray(VAO);
+
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float),
+               vertices.data(), GL_STATIC_DRAW);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+               indices.data(), GL_STATIC_DRAW);
+
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
+  glEnableVertexAttribArray(0);
+
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
+                        (void *)(2 * sizeof(float)));
+  glEnableVertexAttribArray(1);
+
+  initializeHighlightBuffers();
+  initializeDimBuffers();
+  initializePromotionBuffers();
+  initializePromotionPiecesBuffers();
+  initializeOverlayBuffers();
+}
+
+void BoardRenderer::generateVertices() {
+  for (int row = 0; row < 8; row++) {
+    for (int col = 0; col < 8; col++) {
+      float x = 0 + col * squareSize;
+      float y = 0 + row * squareSize;
+
+      // Black square or white
+      bool isWhite = (row + col) % 2 == 0;
+      float r = isWhite ? 1.f : 0.f;
+      float g = isWhite ? 1.f : 0.f;
+      float b = isWhite ? 1.f : 0.f;
+
+      unsigned int baseIndex = vertices.size() / 5;
+
+      vertices.insert(vertices.end(), {x,
+                                       y,
+                                       r,
+                                       g,
+                                       b,
+                                       x + squareSize,
+                                       y,
+                                       r,
+                                       g,
+                                       b,
+                                       x + squareSize,
+                                       y + squareSize,
+                                       r,
+                                       g,
+                                       b,
+                                       x,
+                                       y + squareSize,
+                                       r,
+                                       g,
+                                       b});
+
+      indices.insert(indices.end(), {baseIndex, baseIndex + 1, baseIndex + 2,
+                                     baseIndex + 2, baseIndex + 3, baseIndex});
+    }
+  }
+}
+
+void BoardRenderer::initializeHighlightBuffers() {
+  glGenBuffers(1, &highlightVBO);
+  glGenBuffers(1, &highlightEBO);
+  glGenVertexArrays(1, &highlightVAO);
+  glBindVertexArray(highlightVAO);
+
+  glBindBuffer(GL_ARRAY_BUFFER, highlightVBO);
+  glBufferData(GL_ARRAY_BUFFER, 20 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+
+  std::vector<unsigned int> indices = {0, 1, 2, 2, 3, 0};
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, highlightEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices.data(),
+               GL_STATIC_DRAW);
+
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
+  glEnableVertexAttribArray(0);
+
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
+                        (void *)(2 * sizeof(float)));
+  glEnableVertexAttribArray(1);
+
+  glBindVertexArray(0);
+
+  highlightShader =
+      std::make_unique<Shader>("src/highlight.vert", "src/highlight.frag");
+}
+
+void BoardRenderer::initializeDimBuffers() {
+  float dimVertices[] = {
+      -1.0f, 1.0f,  // top left
+      -1.0f, -1.0f, // bottom left
+      1.0f,  -1.0f, // bottom right
+      1.0f,  1.0f   // top right
+  };
+
+  unsigned int indices[] = {0, 3, 2, 0, 1, 2};
+
+  glGenBuffers(1, &dimVBO);
+  glGenBuffers(1, &dimEBO);
+  glGenVertexArrays(1, &dimVAO);
+  glBindVertexArray(dimVAO);
+
+  glBindBuffer(GL_ARRAY_BUFFER, dimVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(dimVertices), dimVertices,
+               GL_STATIC_DRAW);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, dimEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+               GL_STATIC_DRAW);
+
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+  glEnableVertexAttribArray(0);
+
+  glBindVertexArray(0);
+
+  dimShader =
+      std::make_unique<Shader>("src/dimWindow.vert", "src/dimWindow.frag");
+}
+
+void BoardRenderer::initializePromotionBuffers() {
+  float vertices[] = {
+      -1.0f, 0.25f,  // top left
+      -1.0f, -0.25f, // bottom left
+      1.0f,  -0.25f, // bottom right
+      1.0f,  0.25f   // top right
+  };
+
+  unsigned int indices[] = {0, 3, 2, 0, 1, 2};
+
+  glGenVertexArrays(1, &promoteVAO);
+  glGenBuffers(1, &promoteVBO);
+  glGenBuffers(1, &promoteEBO);
+  glBindVertexArray(promoteVAO);
+
+  glBindBuffer(GL_ARRAY_BUFFER, promoteVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, promoteEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+               GL_STATIC_DRAW);
+
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+  glEnableVertexAttribArray(0);
+
+  glBindVertexArray(0);
+
+  promotionShader =
+      std::make_unique<Shader>("src/promotion.vert", "src/promotion.frag");
+}
+
+void BoardRenderer::initializePromotionPiecesBuffers() {
+  struct Vertex {
+    float x, y;
+    float u, v;
+  };
+
+  std::vector<Vertex> vertices;
+  std::vector<unsigned int> indices;
+  std::vector<PieceType> pieces{PieceType::Bishop, PieceType::Knight,
+                                PieceType::Queen, PieceType::Rook};
+
+  float startX = -0.5f;
+  float quadWidth = 0.25;
+  float quadHeight = 0.25f;
+
+  for (size_t i = 0; i < pieces.size(); i++) {
+    float x0 = startX + i * quadWidth;
+    float x1 = x0 + quadWidth;
+    float y0 = -(quadHeight / 2);
+    float y1 = quadHeight / 2;
+
+    pQuads.push_back({.min = {x0, y0}, .max = {x1, y1}, .type = pieces[i]});
+
+    // Both sheets lay the pieces out alike
+    auto [u0, v0, u1, v1] =
+        whiteSheet.getUV(static_cast<unsigned int>(pieces[i]));
+
+    unsigned int baseIndex = vertices.size();
+
+    vertices.push_back({x0, y1, u0, v1});
+    vertices.push_back({x0, y0, u0, v0});
+    vertices.push_back({x1, y0, u1, v0});
+    vertices.push_back({x1, y1, u1, v1});
+
+    indices.insert(indices.end(), {baseIndex, baseIndex + 1, baseIndex + 2,
+                                   baseIndex, baseIndex + 2, baseIndex + 3});
+  }
+
+  glGenVertexArrays(1, &pieceVAO);
+  glGenBuffers(1, &pieceVBO);
+  glGenBuffers(1, &pieceEBO);
+  glBindVertexArray(pieceVAO);
+
+  glBindBuffer(GL_ARRAY_BUFFER, pieceVBO);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
+               vertices.data(), GL_STATIC_DRAW);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pieceEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+               indices.data(), GL_STATIC_DRAW);
+
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
+  glEnableVertexAttribArray(0);
+
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (void *)(2 * sizeof(float)));
+  glEnableVertexAttribArray(1);
+
+  glBindVertexArray(0);
+
+  promotionPiecesShader = std::make_unique<Shader>("src/promotionPiece.vert",
+                                                   "src/promotionPiece.frag");
+}
+
+void BoardRenderer::initializeOverlayBuffers() {
+  glGenBuffers(1, &overlayVBO);
+  glGenVertexArrays(1, &overlayVAO);
+  glBindVertexArray(overlayVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, overlayVBO);
+
+  // Position and RGBA colour
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
+  glEnableVertexAttribArray(0);
+
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6 * sizeof(float),
+                        (void *)(2 * sizeof(float)));
+  glEnableVertexAttribArray(1);
+
+  glBindVertexArray(0);
+
+  overlayShader =
+      std::make_unique<Shader>("src/overlay.vert", "src/overlay.frag");
+}
+
+void BoardRenderer::render(const Board &board, Shader &shader,
+                           glm::mat4 projection, float time,
+                           const Analysis *analysis) {
+  // Render black and white squares
+  glBindVertexArray(VAO);
+  glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+
+  renderHighlightedSquares(board, projection);
+  renderPieces(board, shader, time);
+  // Over the pieces, so arrows stay visible
+  if (analysis)
+    renderAnalysis(*analysis, projection);
+
+  if (board.getGameState() == GameState::PromotionPending) {
+    glm::ivec2 square = board.getPromotionSquare();
+    Piece *pawn = board.getPieceAt(square.x, square.y);
+    renderDimWindow();
+    renderPromotionOverlay();
+    renderPromotionPieces(pawn->checkifWhite() ? whiteSheet : blackSheet);
+  }
+}
+
+void BoardRenderer::renderHighlightedSquares(const Board &board,
+                                             glm::mat4 projection) {
+  highlightShader->use();
+  glBindVertexArray(highlightVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, highlightVBO);
+
+  // For each square, get base screen coords
+  for (const glm::ivec2 &move : board.getHighlightedSquares()) {
+    float screenX = move.x * squareSize;
+    float screenY = (7 - move.y) * squareSize;
+
+    // Fill the rest of the vertices of the quad
+    std::vector<float> vertices = {
+        // Bottom left
+        screenX + 5, screenY + 5, 1.0f, 1.0f, 0.0f,
+
+        // Bottom right
+        screenX + squareSize - 5, screenY + 5, 1.0f, 1.0f, 0.0f,
+
+        // Top right
+        screenX + squareSize - 5, screenY + squareSize - 5, 1.0f, 1.0f, 0.0f,
+
+        // Top left
+        screenX + 5, screenY + squareSize - 5, 1.0f, 1.0f, 0.0f};
+
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float),
+                    vertices.data());
+
+    highlightShader->setMat4("uProjection", projection);
+
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+  }
+  glBindVertexArray(0);
+}
+
+void BoardRenderer::renderAnalysis(const Analysis &analysis,
+                                   glm::mat4 projection) {
+  const std::vector<AnalysisLine> &lines = analysis.getLines();
+  if (lines.empty())
+    return;
+
+  overlayVertices.clear();
+  for (size_t i = std::size(lineColors); i-- > 0;)
+    if (i < lines.size() && !lines[i].pv.empty())
+      addArrow(lines[i].pv[0].getFrom(), lines[i].pv[0].getTo(),
+               squareSize * (0.16f - 0.03f * i), lineColors[i]);
+
+  // White's share of the bar follows the expected score of the best line
+  int score = lines[0].score;
+  float white = std::abs(score) > MateBound
+                    ? (score > 0 ? 1.f : 0.f)
+                    : 1.f / (1.f + std::exp(-score / 400.f));
+  float height = 8.f * squareSize, split = white * height;
+  glm::vec4 whiteColor(0.95f, 0.95f, 0.95f, 0.9f);
+  glm::vec4 blackColor(0.1f, 0.1f, 0.1f, 0.9f);
+  addTriangle({0, 0}, {EvalBarWidth, 0}, {EvalBarWidth, split}, whiteColor);
+  addTriangle({0, 0}, {EvalBarWidth, split}, {0, split}, whiteColor);
+  addTriangle({0, split}, {EvalBarWidth, split}, {EvalBarWidth, height},
+              blackColor);
+  addTriangle({0, split}, {EvalBarWidth, height}, {0, height}, blackColor);
+
+  // Everything goes up in one buffer and one draw call
+  overlayShader->use();
+  overlayShader->setMat4("uProjection", projection);
+  glBindVertexArray(overlayVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, overlayVBO);
+  glBufferData(GL_ARRAY_BUFFER, overlayVertices.size() * sizeof(float),
+               overlayVertices.data(), GL_STREAM_DRAW);
+  glDrawArrays(GL_TRIANGLES, 0, overlayVertices.size() / 6);
+  glBindVertexArray(0);
+}
+
+void BoardRenderer::addTriangle(glm::vec2 a, glm::vec2 b, glm::vec2 c,
+                                glm::vec4 color) {
+  for (glm::vec2 corner : {a, b, c})
+    overlayVertices.insert(overlayVertices.end(), {corner.x, corner.y, color.r,
+                                                   color.g, color.b, color.a});
+}
+
+void BoardRenderer::addArrow(int from, int to, float width, glm::vec4 color) {
+  // Square centres in screen coordinates
+  auto centre = [&](int square) {
+    glm::ivec2 grid = Board::gridSquare(square);
+    return (glm::vec2(grid.x, 7 - grid.y) + 0.5f) * (float)squareSize;
+  };
+  glm::vec2 start = centre(from), tip = centre(to);
+  glm::vec2 along = glm::normalize(tip - start);
+  glm::vec2 across(-along.y, along.x);
+  float headLength = width * 2.2f;
+  glm::vec2 neck = tip - along * headLength;
+
+  glm::vec2 shaft = across * (width / 2);
+  addTriangle(start - shaft, neck - shaft, neck + shaft, color);
+  addTriangle(start - shaft, neck + shaft, start + shaft, color);
+  glm::vec2 head = across * (width * 1.1f);
+  addTriangle(neck - head, tip, neck + head, color);
+}
+
+void BoardRenderer::renderPieces(const Board &board, Shader &shader,
+                                 float time) {
+  // A new move on the board slides its piece over 0.3 seconds
+  if (board.getMoveCount() != seenMoves) {
+    seenMoves = board.getMoveCount();
+    BoardMove move = board.getLastMove();
+    animation.square = move.to;
+    animation.startPos =
+        glm::vec2(move.from.x, 7 - move.from.y) * (float)squareSize;
+    animation.targetPos =
+        glm::vec2(move.to.x, 7 - move.to.y) * (float)squareSize;
+    animation.startTime = time;
+    animation.isAnimating = true;
+  }
+
+  shader.use();
+  for (int row = 0; row < 8; row++) {
+    for (int col = 0; col < 8; col++) {
+      Piece *piece = board.getPieceAt(col, row);
+      if (piece == nullptr)
+        continue;
+
+      glm::vec2 screen = glm::vec2(col, 7 - row) * (float)squareSize;
+      if (animation.isAnimating && animation.square == glm::ivec2(col, row)) {
+        float t =
+            glm::clamp((time - animation.startTime) / 0.3f, 0.0f, 1.0f);
+        screen = glm::mix(animation.startPos, animation.targetPos, t);
+        if (t >= 1.0)
+          animation.isAnimating = false;
+      }
+
+      // Now to place the pieces in the correct world coordinates, we need a
+      // model matrix for translation and scaling (because pixels)
+      glm::mat4 model = glm::translate(
+          glm::mat4(1.0f), glm::vec3(screen.x + (squareSize / 4.0f),
+                                     screen.y + (squareSize / 8.0f), 0.1f));
+      model = glm::scale(model,
+                         glm::vec3(squareSize / 2, squareSize / 2, 1.0f));
+
+      SpriteSheet &sheet = piece->checkifWhite() ? whiteSheet : blackSheet;
+      auto [u0, v0, u1, v1] =
+          sheet.getUV(static_cast<unsigned int>(piece->getType()));
+      shader.setMat4("uModel", model);
+      shader.setVec2("uUV0", u0, v0);
+      shader.setVec2("uUV1", u1, v1);
+
+      sheet.bind();
+      sheet.bindQuadVAO();
+      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    }
+  }
+}
+
+void BoardRenderer::renderDimWindow() {
+  dimShader->use();
+  glBindVertexArray(dimVAO);
+
+  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+}
+
+void BoardRenderer::renderPromotionOverlay() {
+  promotionShader->use();
+  glBindVertexArray(promoteVAO);
+
+  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+}
+
+void BoardRenderer::renderPromotionPieces(SpriteSheet &sheet) {
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  promotionPiecesShader->use();
+  promotionPiecesShader->setInt("uTexture", 0);
+  glActiveTexture(GL_TEXTURE0);
+  sheet.bind();
+
+  glBindVertexArray(pieceVAO);
+  glDrawElements(GL_TRIANGLES, 6 * 4, GL_UNSIGNED_INT, 0);
+}
+
+glm::ivec2 BoardRenderer::squareAt(float x, float y) const {
+  return {static_cast<int>(x / squareSize), static_cast<int>(y / squareSize)};
+}
+
+std::optional<PieceType> BoardRenderer::promotionChoiceAt(float x,
+                                                          float y) const {
+  float NDCx = x / 800.f * 2.f - 1.f;
+  float NDCy = y / 800.f * 2.f - 1.f;
+
+  for (const PromotionQuad &piece : pQuads) {
+    if ((NDCx >= piece.min.x && NDCy >= piece.min.y) &&
+        (NDCx <= piece.max.x && NDCy <= piece.max.y)) {
+      return piece.type;
+    }
+  }
+  return std::nullopt;
+}
+
+BoardRenderer::~BoardRenderer() {
+  glDeleteBuffers(1, &VBO);
+  glDeleteBuffers(1, &EBO);
+  glDeleteVertexArrays(1, &VAO);
+
+  glDeleteBuffers(1, &highlightVBO);
+  glDeleteBuffers(1, &highlightEBO);
+  glDeleteVertexArrays(1, &highlightVAO);
+
+  glDeleteBuffers(1, &overlayVBO);
+  glDeleteVertexArrays(1, &overlayVAO);
+
+  glDeleteBuffers(1, &dimVBO);
+  glDeleteBuffers(1, &dimEBO);
+  glDeleteVertexArrays(1, &dimVAO);
+
+  glDeleteBuffers(1, &promoteVBO);
+  glDeleteBuffers(1, &promoteEBO);
+  glDeleteVertexArrays(1, &promoteVAO);
+
+  glDeleteBuffers(1, &pieceVBO);
+  glDeleteBuffers(1, &pieceEBO);
+  glDeleteVertexArrays(1, &pieceVAO);
+}
@@ -0,0 +1,209 @@
+#include "Book.h"
+#include "PolyglotRandom.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int RandomCastling = 768;
+constexpr int RandomEnPassant = 772;
+constexpr int RandomTurn = 780;
+
+// Polyglot orders pieces pawn, knight, bishop, rook, queen, king
+constexpr int polyglotType[6] = {0, 1, 3, 2, 4, 5};
+constexpr PieceType promotionType[5] = {PieceType::Pawn, PieceType::Knight,
+                                        PieceType::Bishop, PieceType::Rook,
+                                        PieceType::Queen};
+
+// The rook square a castling king move is written as
+int castlingRookSquare(Move m) {
+  return m.getTo() > m.getFrom() ? m.getTo() + 1 : m.getTo() - 2;
+}
+
+// The key of the start position, built the way polyglotKey builds it
+constexpr uint64_t startKey() {
+  constexpr PieceType backRank[8] = {
+      PieceType::Rook, PieceType::Knight, PieceType::Bishop, PieceType::Queen,
+      PieceType::King, PieceType::Bishop, PieceType::Knight, PieceType::Rook};
+  uint64_t key = 0;
+  for (int file = 0; file < 8; file++) {
+    int pawn = polyglotType[static_cast<int>(PieceType::Pawn)];
+    int piece = polyglotType[static_cast<int>(backRank[file])];
+    key ^= PolyglotRandom[64 * (2 * piece + 1) + file];    // White, rank 1
+    key ^= PolyglotRandom[64 * (2 * pawn + 1) + 8 + file]; // White, rank 2
+    key ^= PolyglotRandom[64 * (2 * pawn) + 48 + file];    // Black, rank 7
+    key ^= PolyglotRandom[64 * (2 * piece) + 56 + file];   // Black, rank 8
+  }
+  for (int right = 0; right < 4; right++)
+    key ^= PolyglotRandom[RandomCastling + right];
+  return key ^ PolyglotRandom[RandomTurn];
+}
+
+static_assert(startKey() == PolyglotStartKey,
+              "PolyglotRandom does not match the format's start position key");
+
+} // namespace
+
+uint64_t polyglotKey(const Position &pos) {
+  uint64_t key = 0;
+
+  Bitboard occupied = pos.getOccupied();
+  while (occupied) {
+    int sq = popLsb(occupied);
+    int piece = pos.getPieceOn(sq);
+    int kind = 2 * polyglotType[static_cast<int>(typeOf(piece))] +
+               (colorOf(piece) == White);
+    key ^= PolyglotRandom[64 * kind + sq];
+  }
+
+  for (int right = 0; right < 4; right++)
+    if (pos.getCastlingRights() & (1 << right))
+      key ^= PolyglotRandom[RandomCastling + right];
+
+  // Only counted when a pawn of the side to move could take
+  Color us = pos.getSideToMove();
+  int ep = pos.getEpSquare();
+  if (ep != NoSquare &&
+      (pawnAttacks(~us, ep) & pos.getPieces(us, PieceType::Pawn)))
+    key ^= PolyglotRandom[RandomEnPassant + fileOf(ep)];
+
+  if (us == White)
+    key ^= PolyglotRandom[RandomTurn];
+  return key;
+}
+
+uint16_t encodeBookMove(Move m) {
+  int to =
+      m.getFlag() == MoveFlag::Castling ? castlingRookSquare(m) : m.getTo();
+  int promotion = 0;
+  if (m.getFlag() == MoveFlag::Promotion)
+    promotion = polyglotType[static_cast<int>(m.getPromotion())];
+  return static_cast<uint16_t>(to | m.getFrom() << 6 | promotion << 12);
+}
+
+Move decodeBookMove(const Position &pos, uint16_t move) {
+  int to = move & 63, from = move >> 6 & 63, promotion = move >> 12 & 7;
+  if (promotion > 4)
+    return Move();
+
+  MoveList moves;
+  pos.generateLegalMoves(moves);
+  for (Move m : moves) {
+    if (m.getFrom() != from)
+      continue;
+    if (m.getFlag() == MoveFlag::Castling ? castlingRookSquare(m) != to
+                                          : m.getTo() != to)
+      continue;
+    if ((m.getFlag() == MoveFlag::Promotion) != (promotion != 0) ||
+        (promotion && m.getPromotion() != promotionType[promotion]))
+      continue;
+    return m;
+  }
+  return Move();
+}
+
+void writeBookEntry(const BookEntry &entry, uint8_t *out) {
+  for (int i = 0; i < 8; i++)
+    out[i] = entry.key >> (56 - 8 * i);
+  out[8] = entry.move >> 8;
+  out[9] = entry.move;
+  out[10] = entry.weight >> 8;
+  out[11] = entry.weight;
+  for (int i = 0; i < 4; i++)
+    out[12 + i] = entry.learn >> (24 - 8 * i);
+}
+
+BookEntry readBookEntry(const uint8_t *in) {
+  BookEntry entry{};
+  for (int i = 0; i < 8; i++)
+    entry.key = entry.key << 8 | in[i];
+  entry.move = in[8] << 8 | in[9];
+  entry.weight = in[10] << 8 | in[11];
+  for (int i = 0; i < 4; i++)
+    entry.learn = entry.learn << 8 | in[12 + i];
+  return entry;
+}
+
+OpeningBook::~OpeningBook() { close(); }
+
+void OpeningBook::close() {
+  if (data)
+    munmap(const_cast<uint8_t *>(data), length);
+  data = nullptr;
+  length = entries = 0;
+}
+
+bool OpeningBook::open(const std::string &path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  void *mapping = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0 &&
+      info.st_size % BookEntrySize == 0)
+    mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED)
+    return false;
+
+  // A binary search touches a handful of scattered pages
+  madvise(mapping, info.st_size, MADV_RANDOM);
+  data = static_cast<const uint8_t *>(mapping);
+  length = info.st_size;
+  entries = length / BookEntrySize;
+  return true;
+}
+
+std::vector<BookMove> OpeningBook::probe(const Position &pos) const {
+  std::vector<BookMove> moves;
+  if (!data)
+    return moves;
+
+  uint64_t key = polyglotKey(pos);
+  size_t low = 0, high = entries;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (readBookEntry(data + mid * BookEntrySize).key < key)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  for (size_t i = low; i < entries; i++) {
+    BookEntry entry = readBookEntry(data + i * BookEntrySize);
+    if (entry.key != key)
+      break;
+    Move m = decodeBookMove(pos, entry.move);
+    if (!m.isNull())
+      moves.push_back({m, entry.weight});
+  }
+
+  std::stable_sort(moves.begin(), moves.end(),
+                   [](const BookMove &a, const BookMove &b) {
+                     return a.weight > b.weight;
+                   });
+  return moves;
+}
+
+Move OpeningBook::pick(const Position &pos, std::mt19937_64 &rng) const {
+  std::vector<BookMove> moves = probe(pos);
+  uint32_t total = 0;
+  for (const BookMove &m : moves)
+    total += m.weight;
+  if (total == 0)
+    return Move();
+
+  uint32_t choice = std::uniform_int_distribution<uint32_t>(0, total - 1)(rng);
+  for (const BookMove &m : moves) {
+    if (choice < m.weight)
+      return m.move;
+    choice -= m.weight;
+  }
+  return moves.front().move;
+}
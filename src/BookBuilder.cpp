@@ -0,0 +1,168 @@
+#include "BookBuilder.h"
+#include "SortedRuns.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+// Key, move, wins, draws and losses in native byte order
+struct BookBuilder::RunFormat {
+  using Record = BookBuilder::Record;
+  static constexpr size_t Size = 22;
+
+  static void store(const Record &record, uint8_t *out) {
+    std::memcpy(out, &record.entry.key, 8);
+    std::memcpy(out + 8, &record.entry.move, 2);
+    std::memcpy(out + 10, &record.counts.wins, 4);
+    std::memcpy(out + 14, &record.counts.draws, 4);
+    std::memcpy(out + 18, &record.counts.losses, 4);
+  }
+
+  static Record load(const uint8_t *in) {
+    Record record;
+    std::memcpy(&record.entry.key, in, 8);
+    std::memcpy(&record.entry.move, in + 8, 2);
+    std::memcpy(&record.counts.wins, in + 10, 4);
+    std::memcpy(&record.counts.draws, in + 14, 4);
+    std::memcpy(&record.counts.losses, in + 18, 4);
+    return record;
+  }
+};
+
+BookBuilder::BookBuilder(const BookBuilderOptions &options)
+    : options(options) {}
+
+BookBuilder::~BookBuilder() {
+  for (const std::string &run : runs)
+    std::remove(run.c_str());
+}
+
+bool BookBuilder::addGame(const PgnGame &game) {
+  int whiteScore = game.result == "1-0"       ? 2
+                   : game.result == "1/2-1/2" ? 1
+                   : game.result == "0-1"     ? 0
+                                              : -1;
+  if (whiteScore < 0 || !game.getTag("FEN").empty()) {
+    skipped++;
+    return true;
+  }
+
+  // The whole opening is replayed before anything is counted, so a game with
+  // a bad move leaves no trace
+  Position pos;
+  pos.setStartPos();
+  EntryKey played[256];
+  int plies = std::min<int>({options.maxPly, int(game.moves.size()), 256});
+  for (int ply = 0; ply < plies; ply++) {
+    Move m = parseSan(pos, game.moves[ply]);
+    if (m.isNull()) {
+      skipped++;
+      return true;
+    }
+    played[ply] = {polyglotKey(pos), encodeBookMove(m)};
+    pos.makeMove(m);
+  }
+
+  for (int ply = 0; ply < plies; ply++)
+    if (!count(played[ply], ply % 2 == 0 ? whiteScore : 2 - whiteScore))
+      return false;
+  games++;
+  return !failed;
+}
+
+bool BookBuilder::count(const EntryKey &entry, int score) {
+  Shard &shard = shards[entry.key >> 58];
+  {
+    std::lock_guard lock(shard.mutex);
+    auto [it, inserted] = shard.counts.try_emplace(entry);
+    if (inserted)
+      entries++;
+    Counts &counts = it->second;
+    (score == 2 ? counts.wins : score == 1 ? counts.draws : counts.losses)++;
+  }
+
+  if (entries * EntryBytes > options.memoryLimit)
+    return spill(false);
+  return true;
+}
+
+bool BookBuilder::spill(bool force) {
+  std::lock_guard spillLock(spillMutex);
+  if (!force && entries * EntryBytes <= options.memoryLimit)
+    return true;
+
+  // Other threads keep counting into the emptied shards while this run is
+  // sorted and written
+  std::vector<Record> records;
+  records.reserve(entries);
+  for (Shard &shard : shards) {
+    std::lock_guard lock(shard.mutex);
+    for (const auto &[entry, counts] : shard.counts)
+      records.push_back({entry, counts});
+    entries -= shard.counts.size();
+    shard.counts.clear();
+  }
+  if (records.empty())
+    return true;
+
+  std::string path = options.tempDirectory + "/bookgen-" +
+                     std::to_string(getpid()) + "-" +
+                     std::to_string(runs.size()) + ".run";
+  if (!writeSortedRun<RunFormat>(path, records))
+    failed = true;
+  runs.push_back(path);
+  return !failed;
+}
+
+bool BookBuilder::write(const std::string &path) {
+  if (!spill(true) || failed)
+    return false;
+
+  std::ofstream out(path, std::ios::binary);
+  if (!out)
+    return false;
+
+  // Moves of one position arrive together, so their weights can be scaled
+  // down as a group when the most played one does not fit in 16 bits
+  std::vector<Record> group;
+  auto flush = [&] {
+    uint64_t heaviest = 0;
+    for (const Record &record : group)
+      heaviest = std::max<uint64_t>(
+          heaviest, 2 * uint64_t{record.counts.wins} + record.counts.draws);
+
+    for (const Record &record : group) {
+      const Counts &c = record.counts;
+      uint64_t played = uint64_t{c.wins} + c.draws + c.losses;
+      uint64_t weight = 2 * uint64_t{c.wins} + c.draws;
+      if (heaviest > 65535)
+        weight = weight * 65535 / heaviest;
+      if (played < options.minGames || weight == 0)
+        continue;
+
+      uint8_t bytes[BookEntrySize];
+      writeBookEntry({record.entry.key, record.entry.move,
+                      static_cast<uint16_t>(weight), 0},
+                     bytes);
+      out.write(reinterpret_cast<const char *>(bytes), BookEntrySize);
+    }
+    group.clear();
+  };
+
+  bool merged = mergeRuns<RunFormat>(runs, [&](const Record &record) {
+    if (!group.empty() && group.back().entry == record.entry) {
+      Counts &sum = group.back().counts;
+      sum.wins += record.counts.wins;
+      sum.draws += record.counts.draws;
+      sum.losses += record.counts.losses;
+    } else {
+      if (!group.empty() && group.back().entry.key != record.entry.key)
+        flush();
+      group.push_back(record);
+    }
+  });
+  flush();
+
+  return merged && static_cast<bool>(out);
+}
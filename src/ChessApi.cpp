@@ -0,0 +1,337 @@
+#include "ChessApi.h"
+#include "BatchEvaluator.h"
+#include "Evaluation.h"
+#include "Nnue.h"
+#include "PackedPosition.h"
+#include "Search.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <span>
+#include <string>
+#include <vector>
+
+struct chess_position {
+  Position pos;
+};
+
+struct chess_searcher {
+  Search search;
+  explicit chess_searcher(size_t hashMegabytes) : search(hashMegabytes) {}
+};
+
+namespace {
+
+// Used when the caller sets no limit at all
+constexpr int DefaultDepth = 8;
+
+bool readFen(const char *fen, Position &pos) {
+  return fen && pos.setFen(fen);
+}
+
+bool readPacked(const uint8_t *bytes, Position &pos) {
+  PackedPosition packed;
+  std::memcpy(packed.bytes, bytes, sizeof(packed.bytes));
+  return packed.unpack(pos);
+}
+
+Move findUciMove(const Position &pos, const char *uci) {
+  MoveList moves;
+  pos.generateLegalMoves(moves);
+  for (Move m : moves)
+    if (m.toUci() == uci)
+      return m;
+  return Move();
+}
+
+SearchLimits toSearchLimits(const chess_search_limits *limits) {
+  SearchLimits result;
+  if (limits) {
+    if (limits->depth > 0)
+      result.depth = std::min<int32_t>(limits->depth, MaxPly - 1);
+    result.nodes = limits->nodes;
+    result.moveTimeMs = std::max<int64_t>(limits->move_time_ms, 0);
+  }
+  if (result.depth == MaxPly - 1 && !result.nodes && !result.moveTimeMs)
+    result.depth = DefaultDepth;
+  return result;
+}
+
+void runSearch(Search &search, const Position &pos, const SearchLimits &limits,
+               chess_search_result &result) {
+  int score = 0, depth = 0;
+  Move best = search.think(pos, limits, [&](const SearchInfo &info) {
+    score = info.score;
+    depth = info.depth;
+  });
+  if (best.isNull())
+    score = pos.inCheck() ? -MateScore : 0;
+  result = {best.getRaw(), score, depth, search.getNodes()};
+}
+
+// Sets up each position of a batch in turn and hands it to visit(i, pos),
+// or visit(i, nullptr) if it is invalid. A negative status from visit ends
+// the batch.
+template <typename Read, typename Visit>
+int forEachPosition(size_t count, uint8_t *valid, Read &&read,
+                    Visit &&visit) {
+  Position pos;
+  int setUp = 0;
+  for (size_t i = 0; i < count; i++) {
+    bool ok = read(i, pos);
+    if (valid)
+      valid[i] = ok;
+    setUp += ok;
+    if (int status = visit(i, ok ? &pos : nullptr); status < 0)
+      return status;
+  }
+  return setUp;
+}
+
+auto fenReader(const char *const *fens) {
+  return [fens](size_t i, Position &pos) { return readFen(fens[i], pos); };
+}
+
+auto packedReader(const uint8_t *packed) {
+  return [packed](size_t i, Position &pos) {
+    return readPacked(packed + i * CHESS_PACKED_SIZE, pos);
+  };
+}
+
+template <typename Read>
+int legalMoves(size_t count, Read &&read, uint16_t *moves, size_t capacity,
+               uint32_t *offsets, uint8_t *valid) {
+  if ((capacity && !moves) || !offsets)
+    return CHESS_INVALID_ARGUMENT;
+  size_t used = 0;
+  offsets[0] = 0;
+  return forEachPosition(count, valid, read,
+                         [&](size_t i, const Position *pos) {
+                           MoveList list;
+                           if (pos)
+                             pos->generateLegalMoves(list);
+                           if (used + list.size() > capacity)
+                             return int(CHESS_BUFFER_TOO_SMALL);
+                           for (Move m : list)
+                             moves[used++] = m.getRaw();
+                           offsets[i + 1] = used;
+                           return int(CHESS_OK);
+                         });
+}
+
+template <typename Read>
+int evaluateAll(size_t count, Read &&read, int32_t *scores, uint8_t *valid) {
+  if (!scores)
+    return CHESS_INVALID_ARGUMENT;
+  return forEachPosition(count, valid, read,
+                         [&](size_t i, const Position *pos) {
+                           scores[i] = pos ? evaluate(*pos) : CHESS_NO_SCORE;
+                           return int(CHESS_OK);
+                         });
+}
+
+template <typename Read>
+int searchAll(chess_searcher *searcher, size_t count, Read &&read,
+              const chess_search_limits *limits, chess_search_result *results,
+              uint8_t *valid) {
+  if (!searcher || !results)
+    return CHESS_INVALID_ARGUMENT;
+  SearchLimits converted = toSearchLimits(limits);
+  return forEachPosition(count, valid, read,
+                         [&](size_t i, const Position *pos) {
+                           if (pos)
+                             runSearch(searcher->search, *pos, converted,
+                                       results[i]);
+                           else
+                             results[i] = {0, CHESS_NO_SCORE, 0, 0};
+                           return int(CHESS_OK);
+                         });
+}
+
+} // namespace
+
+int chess_api_version(void) { return CHESS_API_VERSION; }
+
+int chess_load_network(const char *path) {
+  if (!path)
+    return CHESS_INVALID_ARGUMENT;
+  return Nnue::loadNetwork(path) ? CHESS_OK : CHESS_FILE_ERROR;
+}
+
+void chess_unload_network(void) { Nnue::unloadNetwork(); }
+
+int chess_move_to_uci(uint16_t move, char *out) {
+  if (!out)
+    return CHESS_INVALID_ARGUMENT;
+  std::string uci = move ? Move(move).toUci() : "0000";
+  std::memcpy(out, uci.c_str(), uci.size() + 1);
+  return CHESS_OK;
+}
+
+chess_position *chess_position_new(void) {
+  chess_position *position = new (std::nothrow) chess_position;
+  if (position)
+    position->pos.setStartPos();
+  return position;
+}
+
+void chess_position_free(chess_position *position) { delete position; }
+
+int chess_position_set_fen(chess_position *position, const char *fen) {
+  if (!position)
+    return CHESS_INVALID_ARGUMENT;
+  Position parsed;
+  if (!readFen(fen, parsed))
+    return CHESS_INVALID_POSITION;
+  position->pos = parsed;
+  return CHESS_OK;
+}
+
+int chess_position_set_packed(chess_position *position,
+                              const uint8_t *packed) {
+  if (!position || !packed)
+    return CHESS_INVALID_ARGUMENT;
+  Position parsed;
+  if (!readPacked(packed, parsed))
+    return CHESS_INVALID_POSITION;
+  position->pos = parsed;
+  return CHESS_OK;
+}
+
+int chess_position_get_fen(const chess_position *position, char *buffer,
+                           size_t size) {
+  if (!position || (size && !buffer))
+    return CHESS_INVALID_ARGUMENT;
+  std::string fen = position->pos.getFen();
+  if (size) {
+    size_t length = std::min(fen.size(), size - 1);
+    std::memcpy(buffer, fen.data(), length);
+    buffer[length] = '\0';
+  }
+  return fen.size();
+}
+
+int chess_position_pack(const chess_position *position, uint8_t *packed) {
+  if (!position || !packed)
+    return CHESS_INVALID_ARGUMENT;
+  PackedPosition result;
+  if (!result.pack(position->pos))
+    return CHESS_INVALID_POSITION;
+  std::memcpy(packed, result.bytes, sizeof(result.bytes));
+  return CHESS_OK;
+}
+
+uint64_t chess_position_key(const chess_position *position) {
+  return position ? position->pos.getKey() : 0;
+}
+
+int chess_position_play(chess_position *position, const char *uci) {
+  if (!position || !uci)
+    return CHESS_INVALID_ARGUMENT;
+  Move m = findUciMove(position->pos, uci);
+  if (m.isNull())
+    return CHESS_ILLEGAL_MOVE;
+  position->pos.makeMove(m);
+  return CHESS_OK;
+}
+
+int chess_position_legal_moves(const chess_position *position,
+                               uint16_t *moves, size_t capacity) {
+  if (!position || (capacity && !moves))
+    return CHESS_INVALID_ARGUMENT;
+  MoveList list;
+  position->pos.generateLegalMoves(list);
+  for (int i = 0; i < list.size() && size_t(i) < capacity; i++)
+    moves[i] = list[i].getRaw();
+  return list.size();
+}
+
+int32_t chess_position_evaluate(const chess_position *position) {
+  return position ? evaluate(position->pos) : CHESS_NO_SCORE;
+}
+
+chess_searcher *chess_searcher_new(size_t hash_megabytes) {
+  // The hash table is the only large allocation; its failure must not
+  // escape as an exception
+  try {
+    return new chess_searcher(std::max<size_t>(hash_megabytes, 1));
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void chess_searcher_free(chess_searcher *searcher) { delete searcher; }
+
+void chess_searcher_clear(chess_searcher *searcher) {
+  if (searcher)
+    searcher->search.clearHash();
+}
+
+int chess_searcher_search(chess_searcher *searcher,
+                          const chess_position *position,
+                          const chess_search_limits *limits,
+                          chess_search_result *result) {
+  if (!searcher || !position || !result)
+    return CHESS_INVALID_ARGUMENT;
+  runSearch(searcher->search, position->pos, toSearchLimits(limits), *result);
+  return CHESS_OK;
+}
+
+int chess_fen_legal_moves(const char *const *fens, size_t count,
+                          uint16_t *moves, size_t capacity, uint32_t *offsets,
+                          uint8_t *valid) {
+  if (count && !fens)
+    return CHESS_INVALID_ARGUMENT;
+  return legalMoves(count, fenReader(fens), moves, capacity, offsets, valid);
+}
+
+int chess_packed_legal_moves(const uint8_t *packed, size_t count,
+                             uint16_t *moves, size_t capacity,
+                             uint32_t *offsets, uint8_t *valid) {
+  if (count && !packed)
+    return CHESS_INVALID_ARGUMENT;
+  return legalMoves(count, packedReader(packed), moves, capacity, offsets,
+                    valid);
+}
+
+int chess_fen_evaluate(const char *const *fens, size_t count, int32_t *scores,
+                       uint8_t *valid) {
+  if (count && !fens)
+    return CHESS_INVALID_ARGUMENT;
+  return evaluateAll(count, fenReader(fens), scores, valid);
+}
+
+int chess_packed_evaluate(const uint8_t *packed, size_t count,
+                          int32_t *scores, uint8_t *valid) {
+  if ((count && !packed) || !scores)
+    return CHESS_INVALID_ARGUMENT;
+  static_assert(CHESS_NO_SCORE == NoScore);
+  try {
+    std::vector<PackedPosition> positions(count);
+    std::memcpy(positions.data(), packed, count * CHESS_PACKED_SIZE);
+    size_t unpacked = evaluateBatch(positions, std::span<int>(scores, count));
+    if (valid)
+      for (size_t i = 0; i < count; i++)
+        valid[i] = scores[i] != CHESS_NO_SCORE;
+    return unpacked;
+  } catch (const std::bad_alloc &) {
+    return CHESS_OUT_OF_MEMORY;
+  }
+}
+
+int chess_fen_search(chess_searcher *searcher, const char *const *fens,
+                     size_t count, const chess_search_limits *limits,
+                     chess_search_result *results, uint8_t *valid) {
+  if (count && !fens)
+    return CHESS_INVALID_ARGUMENT;
+  return searchAll(searcher, count, fenReader(fens), limits, results, valid);
+}
+
+int chess_packed_search(chess_searcher *searcher, const uint8_t *packed,
+                        size_t count, const chess_search_limits *limits,
+                        chess_search_result *results, uint8_t *valid) {
+  if (count && !packed)
+    return CHESS_INVALID_ARGUMENT;
+  return searchAll(searcher, count, packedReader(packed), limits, results,
+                   valid);
+}
@@ -0,0 +1,241 @@
+#include "Endgame.h"
+#include "Bitbase.h"
+#include "EvalParams.h"
+#include "Evaluation.h"
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+constexpr int PawnValue = EvalParams::MaterialEg[0];
+constexpr int KnightValue = EvalParams::MaterialEg[1];
+constexpr int RookValue = EvalParams::MaterialEg[2];
+constexpr int BishopValue = EvalParams::MaterialEg[3];
+constexpr int QueenValue = EvalParams::MaterialEg[4];
+
+constexpr Bitboard DarkSquares = 0xAA55AA55AA55AA55ULL;
+
+int count(const Position &pos, Color c, PieceType type) {
+  return popCount(pos.getPieces(c, type));
+}
+
+int nonPawnMaterial(const Position &pos, Color c) {
+  return count(pos, c, PieceType::Knight) * KnightValue +
+         count(pos, c, PieceType::Bishop) * BishopValue +
+         count(pos, c, PieceType::Rook) * RookValue +
+         count(pos, c, PieceType::Queen) * QueenValue;
+}
+
+// Square as seen by c, so that every side's pawns run up the board
+int relative(Color c, int square) {
+  return c == White ? square : flipRank(square);
+}
+
+int pieceSquare(const Position &pos, Color c, PieceType type) {
+  return lsb(pos.getPieces(c, type));
+}
+
+// Bonus for driving a king to the edge of the board
+int pushToEdge(int square) {
+  int file = fileOf(square), rank = rankOf(square);
+  int fromEdge = std::min(std::min(file, 7 - file), std::min(rank, 7 - rank));
+  return 90 - 30 * fromEdge;
+}
+
+// Bonus for bringing the kings together
+int pushClose(int a, int b) { return 140 - 20 * squareDistance(a, b); }
+
+// A bare king against a mating force: drive it to the edge
+int evaluateKXK(const Position &pos, Color strong) {
+  int strongKing = pos.getKingSquare(strong);
+  int weakKing = pos.getKingSquare(~strong);
+  int score = nonPawnMaterial(pos, strong) +
+              count(pos, strong, PieceType::Pawn) * PawnValue +
+              pushToEdge(weakKing) + pushClose(strongKing, weakKing);
+
+  if (pos.getPieces(strong, PieceType::Queen) ||
+      pos.getPieces(strong, PieceType::Rook) ||
+      (pos.getPieces(strong, PieceType::Bishop) & DarkSquares &&
+       pos.getPieces(strong, PieceType::Bishop) & ~DarkSquares) ||
+      (pos.getPieces(strong, PieceType::Bishop) &&
+       pos.getPieces(strong, PieceType::Knight)))
+    score += KnownWin;
+  return score;
+}
+
+// Bishop and knight mate only in a corner of the bishop's colour
+int evaluateKBNK(const Position &pos, Color strong) {
+  int strongKing = pos.getKingSquare(strong);
+  int weakKing = pos.getKingSquare(~strong);
+  bool dark = pos.getPieces(strong, PieceType::Bishop) & DarkSquares;
+  int cornerA = dark ? makeSquare(0, 0) : makeSquare(7, 0);
+  int cornerB = dark ? makeSquare(7, 7) : makeSquare(0, 7);
+  int toCorner = std::min(squareDistance(weakKing, cornerA),
+                          squareDistance(weakKing, cornerB));
+
+  return KnownWin + KnightValue + BishopValue + 40 * (7 - toCorner) +
+         pushToEdge(weakKing) + pushClose(strongKing, weakKing);
+}
+
+int evaluateKPK(const Position &pos, Color strong) {
+  int pawn = pieceSquare(pos, strong, PieceType::Pawn);
+  if (!Bitbases::probeKPK(strong, pos.getKingSquare(strong), pawn,
+                          pos.getKingSquare(~strong), pos.getSideToMove()))
+    return 0;
+  // A win scores more the further the pawn has run
+  return KnownWin + PawnValue + 20 * rankOf(relative(strong, pawn));
+}
+
+// Rook against pawn: a win unless the pawn is far advanced and its king
+// supports it while the rook's king is out of play
+int evaluateKRKP(const Position &pos, Color strong) {
+  Color weak = ~strong;
+  // Seen from the rook's side, so the pawn runs down the board
+  int strongKing = relative(strong, pos.getKingSquare(strong));
+  int weakKing = relative(strong, pos.getKingSquare(weak));
+  int rook = relative(strong, pieceSquare(pos, strong, PieceType::Rook));
+  int pawn = relative(strong, pieceSquare(pos, weak, PieceType::Pawn));
+  int queening = makeSquare(fileOf(pawn), 0);
+  int ahead = pawn - 8;
+  bool weakToMove = pos.getSideToMove() == weak;
+
+  if (fileOf(strongKing) == fileOf(pawn) && strongKing < pawn)
+    return RookValue - squareDistance(strongKing, pawn);
+
+  if (squareDistance(weakKing, pawn) >= 3 + weakToMove &&
+      squareDistance(weakKing, rook) >= 3)
+    return RookValue - squareDistance(strongKing, pawn);
+
+  if (rankOf(weakKing) <= 2 && squareDistance(weakKing, pawn) == 1 &&
+      rankOf(strongKing) >= 3 &&
+      squareDistance(strongKing, pawn) > 2 + !weakToMove)
+    return 80 - 8 * squareDistance(strongKing, pawn);
+
+  return 200 - 8 * (squareDistance(strongKing, ahead) -
+                    squareDistance(weakKing, ahead) -
+                    squareDistance(pawn, queening));
+}
+
+// Rook against a minor piece is usually drawn; only a cornered king loses
+int evaluateKRKB(const Position &pos, Color strong) {
+  return pushToEdge(pos.getKingSquare(~strong)) / 2;
+}
+
+int evaluateKRKN(const Position &pos, Color strong) {
+  int weakKing = pos.getKingSquare(~strong);
+  int knight = pieceSquare(pos, ~strong, PieceType::Knight);
+  return pushToEdge(weakKing) / 2 + 10 * squareDistance(weakKing, knight);
+}
+
+int evaluateKQKR(const Position &pos, Color strong) {
+  int strongKing = pos.getKingSquare(strong);
+  int weakKing = pos.getKingSquare(~strong);
+  return QueenValue - RookValue + pushToEdge(weakKing) +
+         pushClose(strongKing, weakKing);
+}
+
+int evaluateDraw(const Position &, Color) { return 0; }
+
+// Opposite-coloured bishops halve or better the stronger side's chances
+int scaleOppositeBishops(const Position &pos, Color strong) {
+  Bitboard ours = pos.getPieces(strong, PieceType::Bishop);
+  Bitboard theirs = pos.getPieces(~strong, PieceType::Bishop);
+  if (bool(ours & DarkSquares) == bool(theirs & DarkSquares))
+    return ScaleNormal;
+
+  bool onlyBishops = nonPawnMaterial(pos, strong) == BishopValue &&
+                     nonPawnMaterial(pos, ~strong) == BishopValue;
+  return onlyBishops ? 22 : 46;
+}
+
+// Material written as the strong side's pieces then the weak side's, such as
+// "KBNK", packed like Position::getMaterialKey
+uint64_t materialKey(std::string_view code, Color strong) {
+  constexpr std::string_view letters = "PNRBQK";
+  uint64_t key = 0;
+  Color side = strong;
+  for (size_t i = 0; i < code.size(); i++) {
+    if (i > 0 && code[i] == 'K')
+      side = ~strong;
+    int type = letters.find(code[i]);
+    key += uint64_t{1} << (4 * makePiece(side, PieceType(type)));
+  }
+  return key;
+}
+
+struct Endgame {
+  EndgameEval evaluation;
+  Color strong;
+};
+
+// Specialised evaluations keyed by material, both colour assignments
+const std::unordered_map<uint64_t, Endgame> endgames = [] {
+  std::unordered_map<uint64_t, Endgame> table;
+  auto add = [&](std::string_view code, EndgameEval evaluation) {
+    for (Color strong : {White, Black})
+      table[materialKey(code, strong)] = {evaluation, strong};
+  };
+
+  add("KPK", evaluateKPK);
+  add("KBNK", evaluateKBNK);
+  add("KRKP", evaluateKRKP);
+  add("KRKB", evaluateKRKB);
+  add("KRKN", evaluateKRKN);
+  add("KQKR", evaluateKQKR);
+  add("KK", evaluateDraw);
+  add("KNK", evaluateDraw);
+  add("KBK", evaluateDraw);
+  add("KNNK", evaluateDraw);
+  return table;
+}();
+
+} // namespace
+
+MaterialCache::MaterialCache() : entries(size_t{1} << Bits) {}
+
+const MaterialEntry &MaterialCache::probe(const Position &pos) {
+  uint64_t key = pos.getMaterialKey();
+  MaterialEntry &entry =
+      entries[(key * 0x9E3779B97F4A7C15ULL) >> (64 - Bits)];
+  if (entry.key != key) {
+    entry = MaterialEntry();
+    entry.key = key;
+    fill(pos, entry);
+  }
+  return entry;
+}
+
+void MaterialCache::fill(const Position &pos, MaterialEntry &entry) {
+  entry.phase = gamePhase(pos);
+
+  if (auto it = endgames.find(entry.key); it != endgames.end()) {
+    entry.evaluation = it->second.evaluation;
+    entry.evaluationStrong = it->second.strong;
+    return;
+  }
+
+  for (Color strong : {White, Black}) {
+    Color weak = ~strong;
+    int strongMaterial = nonPawnMaterial(pos, strong);
+    int weakMaterial = nonPawnMaterial(pos, weak);
+
+    if (pos.getPieces(weak) == pos.getPieces(weak, PieceType::King) &&
+        strongMaterial >= RookValue) {
+      entry.evaluation = evaluateKXK;
+      entry.evaluationStrong = strong;
+      return;
+    }
+
+    // Without pawns, being less than a rook up rarely wins
+    if (!pos.getPieces(strong, PieceType::Pawn) &&
+        strongMaterial - weakMaterial <= BishopValue)
+      entry.factor[strong] = strongMaterial < RookValue ? ScaleDraw
+                             : weakMaterial <= BishopValue ? 4
+                                                           : 14;
+
+    if (count(pos, strong, PieceType::Bishop) == 1 &&
+        count(pos, weak, PieceType::Bishop) == 1)
+      entry.scale[strong] = scaleOppositeBishops;
+  }
+}
@@ -0,0 +1,121 @@
+#include "EngineWorker.h"
+#include <algorithm>
+
+namespace {
+
+int64_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+EngineWorker::EngineWorker(size_t hashMegabytes)
+    : search(hashMegabytes), worker([this] { run(); }) {}
+
+EngineWorker::~EngineWorker() {
+  quitting = true;
+  search.stop();
+  wakeups.fetch_add(1, std::memory_order_release);
+  wakeups.notify_one();
+  worker.join();
+}
+
+bool EngineWorker::send(Command &&command) {
+  if (!commands.push(std::move(command)))
+    return false;
+  wakeups.fetch_add(1, std::memory_order_release);
+  wakeups.notify_one();
+  return true;
+}
+
+uint64_t EngineWorker::startSearch(const Position &root,
+                                   const SearchLimits &limits) {
+  cancel();
+  uint64_t searchId = lastSearchId + 1;
+  if (!send({Command::Kind::Search, searchId, root, limits}))
+    return 0;
+  return lastSearchId = searchId;
+}
+
+void EngineWorker::cancel() {
+  cancelledThrough = lastSearchId;
+  search.stop();
+}
+
+void EngineWorker::setTimeLimits(uint64_t searchId, int64_t softMs,
+                                 int64_t hardMs) {
+  int64_t now = nowMs();
+  softDeadlineMs = softMs ? now + softMs : 0;
+  hardDeadlineMs = hardMs ? now + hardMs : 0;
+  timedSearchId = searchId;
+  // Takes effect at once if the search is running; if it has yet to start,
+  // its first iteration applies the deadlines
+  search.setTimeLimits(softMs, hardMs);
+}
+
+void EngineWorker::applyTimeLimits(uint64_t searchId) {
+  if (timedSearchId != searchId)
+    return;
+  int64_t now = nowMs(), soft = softDeadlineMs, hard = hardDeadlineMs;
+  search.setTimeLimits(soft ? std::max<int64_t>(soft - now, 1) : 0,
+                       hard ? std::max<int64_t>(hard - now, 1) : 0);
+}
+
+void EngineWorker::clearHash() {
+  send({Command::Kind::ClearHash, 0, Position(), SearchLimits()});
+}
+
+bool EngineWorker::isCancelled(uint64_t searchId) const {
+  return quitting || searchId <= cancelledThrough;
+}
+
+void EngineWorker::post(EngineEvent &&event, bool mustArrive) {
+  // An Info may be dropped when the caller is not polling; a BestMove waits
+  // for room
+  while (!events.push(std::move(event)) && mustArrive && !quitting)
+    std::this_thread::yield();
+}
+
+void EngineWorker::run() {
+  while (true) {
+    // Read before looking at the queue, so a command pushed in between
+    // makes the wait return at once
+    uint32_t seen = wakeups.load(std::memory_order_acquire);
+    if (quitting)
+      return;
+    Command command;
+    if (!commands.pop(command)) {
+      wakeups.wait(seen, std::memory_order_acquire);
+      continue;
+    }
+    if (command.kind == Command::Kind::ClearHash)
+      search.clearHash();
+    else if (!isCancelled(command.searchId))
+      runSearch(command);
+  }
+}
+
+void EngineWorker::runSearch(const Command &command) {
+  std::vector<Move> bestLine;
+  Move best = search.think(command.root, command.limits,
+                           [&](const SearchInfo &info) {
+                             // A cancel or time limit that came before
+                             // think reset its state is applied again here
+                             if (isCancelled(command.searchId))
+                               search.stop();
+                             else
+                               applyTimeLimits(command.searchId);
+                             if (info.line == 1)
+                               bestLine = info.pv;
+                             post({EngineEvent::Kind::Info, command.searchId,
+                                   info, Move(), Move()},
+                                  false);
+                           });
+  Move ponder = bestLine.size() >= 2 && bestLine[0] == best ? bestLine[1]
+                                                            : Move();
+  post({EngineEvent::Kind::BestMove, command.searchId, SearchInfo{}, best,
+        ponder},
+       true);
+}
@@ -0,0 +1,77 @@
+#include "Evaluation.h"
+#include "EvalParams.h"
+#include "Nnue.h"
+#include <algorithm>
+#include <array>
+
+namespace {
+
+constexpr int phaseWeight[6] = {0, 1, 2, 1, 4, 0};
+
+// Material plus piece-square value for every piece on every square, positive
+// for white and negative for black
+struct PieceSquareTable {
+  std::array<std::array<int, 64>, 12> mg;
+  std::array<std::array<int, 64>, 12> eg;
+};
+
+constexpr PieceSquareTable pieceSquare = [] {
+  using namespace EvalParams;
+  PieceSquareTable table{};
+  for (int type = 0; type < PieceTypeCount; type++)
+    for (int sq = 0; sq < 64; sq++) {
+      int white = makePiece(White, PieceType(type));
+      int black = makePiece(Black, PieceType(type));
+      // The tables start at a8, so white reads them rank-flipped
+      table.mg[white][sq] = MaterialMg[type] + PstMg[type][flipRank(sq)];
+      table.eg[white][sq] = MaterialEg[type] + PstEg[type][flipRank(sq)];
+      table.mg[black][sq] = -(MaterialMg[type] + PstMg[type][sq]);
+      table.eg[black][sq] = -(MaterialEg[type] + PstEg[type][sq]);
+    }
+  return table;
+}();
+
+} // namespace
+
+int gamePhase(const Position &pos) {
+  int phase = 0;
+  for (int type = 0; type < PieceTypeCount; type++)
+    phase += phaseWeight[type] * popCount(pos.getPieces(PieceType(type)));
+  return std::min(phase, MaxPhase);
+}
+
+int evaluate(const Position &pos, MaterialCache &materials) {
+  const MaterialEntry &material = materials.probe(pos);
+  if (material.evaluation) {
+    int score = material.evaluation(pos, material.evaluationStrong);
+    return pos.getSideToMove() == material.evaluationStrong ? score : -score;
+  }
+
+  if (const Nnue::Network *network = Nnue::getNetwork()) {
+    int score = network->evaluate(pos);
+    Color stm = pos.getSideToMove();
+    return score * material.getScale(pos, score > 0 ? stm : ~stm) /
+           ScaleNormal;
+  }
+
+  int mg = 0, eg = 0;
+
+  Bitboard occupied = pos.getOccupied();
+  while (occupied) {
+    int sq = popLsb(occupied);
+    int piece = pos.getPieceOn(sq);
+    mg += pieceSquare.mg[piece][sq];
+    eg += pieceSquare.eg[piece][sq];
+  }
+
+  eg = eg * material.getScale(pos, eg > 0 ? White : Black) / ScaleNormal;
+
+  int phase = material.phase;
+  int score = (mg * phase + eg * (MaxPhase - phase)) / MaxPhase;
+  return pos.getSideToMove() == White ? score : -score;
+}
+
+int evaluate(const Position &pos) {
+  thread_local MaterialCache materials;
+  return evaluate(pos, materials);
+}
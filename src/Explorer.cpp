@@ -0,0 +1,242 @@
+#include "Explorer.h"
+#include "SortedRuns.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t ExplorerMagic = 0x58454743; // "CGEX"
+constexpr uint32_t Version = 1;
+constexpr size_t HeaderSize = 16;
+
+void store(uint8_t *out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++)
+    out[i] = value >> (8 * i);
+}
+
+uint64_t load(const uint8_t *in, int bytes) {
+  uint64_t value = 0;
+  for (int i = bytes - 1; i >= 0; i--)
+    value = value << 8 | in[i];
+  return value;
+}
+
+// Played moves and the runs they are summed into are sorted by key, then
+// move
+constexpr auto byKeyThenMove = [](const auto &a, const auto &b) {
+  return a.key != b.key ? a.key < b.key : a.move < b.move;
+};
+
+void addCounts(ExplorerEntry &sum, const ExplorerEntry &entry) {
+  sum.wins += entry.wins;
+  sum.draws += entry.draws;
+  sum.losses += entry.losses;
+  sum.rated += entry.rated;
+  sum.ratingSum += entry.ratingSum;
+}
+
+// Runs hold summed entries in the file's own record format
+struct EntryFormat {
+  using Record = ExplorerEntry;
+  static constexpr size_t Size = ExplorerEntrySize;
+
+  static void store(const ExplorerEntry &entry, uint8_t *out) {
+    writeExplorerEntry(entry, out);
+  }
+  static ExplorerEntry load(const uint8_t *in) {
+    return readExplorerEntry(in);
+  }
+};
+
+} // namespace
+
+void writeExplorerEntry(const ExplorerEntry &entry, uint8_t *out) {
+  store(out, entry.key, 8);
+  store(out + 8, entry.move, 2);
+  store(out + 10, 0, 2);
+  store(out + 12, entry.wins, 4);
+  store(out + 16, entry.draws, 4);
+  store(out + 20, entry.losses, 4);
+  store(out + 24, entry.rated, 4);
+  store(out + 28, entry.ratingSum, 8);
+}
+
+ExplorerEntry readExplorerEntry(const uint8_t *in) {
+  ExplorerEntry entry;
+  entry.key = load(in, 8);
+  entry.move = load(in + 8, 2);
+  entry.wins = load(in + 12, 4);
+  entry.draws = load(in + 16, 4);
+  entry.losses = load(in + 20, 4);
+  entry.rated = load(in + 24, 4);
+  entry.ratingSum = load(in + 28, 8);
+  return entry;
+}
+
+ExplorerBuilder::ExplorerBuilder(const ExplorerOptions &options)
+    : options(options) {}
+
+ExplorerBuilder::~ExplorerBuilder() {
+  for (const std::string &run : runs)
+    std::remove(run.c_str());
+}
+
+bool ExplorerBuilder::addGame(const GameHeader &header,
+                              const std::vector<Move> &moves) {
+  if (header.result == UnknownResult) {
+    skipped++;
+    return true;
+  }
+
+  Position pos;
+  pos.setStartPos();
+  int plies = std::min<int>(options.maxPly, moves.size());
+  for (int ply = 0; ply < plies; ply++) {
+    bool white = ply % 2 == 0;
+    int points = 1 + (white ? header.result : -header.result);
+    played.push_back({pos.getKey(), moves[ply].getRaw(),
+                      white ? header.whiteElo : header.blackElo,
+                      static_cast<uint8_t>(points)});
+    pos.makeMove(moves[ply]);
+  }
+  games++;
+
+  if (played.size() * sizeof(Played) > options.memoryLimit)
+    return spill();
+  return true;
+}
+
+bool ExplorerBuilder::spill() {
+  if (played.empty())
+    return true;
+
+  std::sort(played.begin(), played.end(), byKeyThenMove);
+
+  std::string path = options.tempDirectory + "/explorer-" +
+                     std::to_string(getpid()) + "-" +
+                     std::to_string(runs.size()) + ".run";
+  RunWriter<EntryFormat> run(path);
+  runs.push_back(path);
+
+  for (size_t i = 0; i < played.size();) {
+    ExplorerEntry entry;
+    entry.key = played[i].key;
+    entry.move = played[i].move;
+    for (; i < played.size() && played[i].key == entry.key &&
+           played[i].move == entry.move;
+         i++) {
+      const Played &p = played[i];
+      (p.points == 2   ? entry.wins
+       : p.points == 1 ? entry.draws
+                       : entry.losses)++;
+      if (p.rating) {
+        entry.rated++;
+        entry.ratingSum += p.rating;
+      }
+    }
+    run.write(entry);
+  }
+  played.clear();
+  return run.close();
+}
+
+bool ExplorerBuilder::write(const std::string &path) {
+  if (!spill())
+    return false;
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  uint8_t bytes[ExplorerEntrySize] = {};
+  out.write(reinterpret_cast<const char *>(bytes), HeaderSize);
+  uint64_t entries = 0;
+
+  ExplorerEntry sum;
+  bool pending = false;
+  auto flush = [&] {
+    if (!pending || sum.getGames() < options.minGames)
+      return;
+    writeExplorerEntry(sum, bytes);
+    out.write(reinterpret_cast<const char *>(bytes), ExplorerEntrySize);
+    entries++;
+  };
+
+  bool merged = mergeRuns<EntryFormat>(
+      runs,
+      [&](const ExplorerEntry &entry) {
+        if (pending && entry.key == sum.key && entry.move == sum.move) {
+          addCounts(sum, entry);
+        } else {
+          flush();
+          sum = entry;
+          pending = true;
+        }
+      },
+      byKeyThenMove);
+  flush();
+
+  store(bytes, ExplorerMagic, 4);
+  store(bytes + 4, Version, 4);
+  store(bytes + 8, entries, 8);
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(bytes), HeaderSize);
+  return merged && static_cast<bool>(out);
+}
+
+bool OpeningExplorer::open(const std::string &path) {
+  entries = 0;
+  if (!file.open(path, false))
+    return false;
+
+  const uint8_t *data =
+      reinterpret_cast<const uint8_t *>(file.getView().data());
+  if (file.size() < HeaderSize || load(data, 4) != ExplorerMagic ||
+      load(data + 4, 4) != Version ||
+      file.size() != HeaderSize + load(data + 8, 8) * ExplorerEntrySize) {
+    file.close();
+    return false;
+  }
+  entries = load(data + 8, 8);
+  return true;
+}
+
+uint64_t OpeningExplorer::keyAt(size_t index) const {
+  return load(reinterpret_cast<const uint8_t *>(file.getView().data()) +
+                  HeaderSize + index * ExplorerEntrySize,
+              8);
+}
+
+std::vector<ExplorerMove> OpeningExplorer::probe(const Position &pos) const {
+  std::vector<ExplorerMove> moves;
+  if (!isOpen())
+    return moves;
+
+  uint64_t key = pos.getKey();
+  size_t low = 0, high = entries;
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    if (keyAt(middle) < key)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+
+  MoveList legal;
+  pos.generateLegalMoves(legal);
+  const uint8_t *data =
+      reinterpret_cast<const uint8_t *>(file.getView().data()) + HeaderSize;
+  for (size_t i = low; i < entries && keyAt(i) == key; i++) {
+    ExplorerEntry entry = readExplorerEntry(data + i * ExplorerEntrySize);
+    // A key collision would bring moves that are not legal here
+    Move m(entry.move);
+    if (std::find(legal.begin(), legal.end(), m) != legal.end())
+      moves.push_back({m, entry});
+  }
+
+  std::sort(moves.begin(), moves.end(),
+            [](const ExplorerMove &a, const ExplorerMove &b) {
+              return a.stats.getGames() > b.stats.getGames();
+            });
+  return moves;
+}
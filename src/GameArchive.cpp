@@ -0,0 +1,501 @@
+#include "GameArchive.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <fstream>
+#include <queue>
+#include <thread>
+
+namespace {
+
+constexpr uint32_t ArchiveMagic = 0x52414743; // "CGAR"
+constexpr uint32_t Version = 1;
+constexpr size_t HeaderSize = 24;
+constexpr size_t LengthsSize = 256;
+constexpr size_t OffsetsStart = HeaderSize + LengthsSize;
+constexpr int MaxCodeBits = GameArchive::MaxCodeBits;
+
+void store(uint8_t *out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++)
+    out[i] = value >> (8 * i);
+}
+
+uint64_t load(const uint8_t *in, int bytes) {
+  uint64_t value = 0;
+  for (int i = bytes - 1; i >= 0; i--)
+    value = value << 8 | in[i];
+  return value;
+}
+
+// The move ordering is part of the format: changing anything here makes
+// existing archives decode to different games
+constexpr int orderValue[6] = {1, 3, 5, 3, 9, 0};
+
+constexpr auto centre = [] {
+  std::array<int, 64> table{};
+  for (int sq = 0; sq < 64; sq++) {
+    int file = fileOf(sq) * 2 - 7, rank = rankOf(sq) * 2 - 7;
+    file = file < 0 ? -file : file;
+    rank = rank < 0 ? -rank : rank;
+    table[sq] = 3 - std::max(file, rank) / 2;
+  }
+  return table;
+}();
+
+// The legal moves of a position with their ordering keys: a score in the
+// high half, higher first, and the move itself in the low half to break ties
+struct OrderedMoves {
+  MoveList moves;
+  uint32_t keys[256];
+
+  void generate(const Position &pos) {
+    moves.count = 0;
+    pos.generateLegalMoves(moves);
+    Color us = pos.getSideToMove();
+    Bitboard pawns = pos.getPieces(~us, PieceType::Pawn);
+    Bitboard pawnAttacks =
+        us == White ? ((pawns & ~FileA) >> 9) | ((pawns & ~FileH) >> 7)
+                    : ((pawns & ~FileA) << 7) | ((pawns & ~FileH) << 9);
+
+    for (int i = 0; i < moves.size(); i++) {
+      Move m = moves.moves[i];
+      int type = static_cast<int>(typeOf(pos.getPieceOn(m.getFrom())));
+      int score = centre[m.getTo()] - centre[m.getFrom()];
+      if (pos.isCapture(m)) {
+        int victim = pos.getPieceOn(m.getTo());
+        int value = victim == NoPiece
+                        ? 1
+                        : orderValue[static_cast<int>(typeOf(victim))];
+        score += 200 + 16 * value - orderValue[type];
+      }
+      if (m.getFlag() == MoveFlag::Promotion)
+        score += 100 + 8 * orderValue[static_cast<int>(m.getPromotion())];
+      else if (m.getFlag() == MoveFlag::Castling)
+        score += 20;
+      if (type != static_cast<int>(PieceType::Pawn) &&
+          (pawnAttacks & squareBB(m.getTo())))
+        score -= 8 * orderValue[type];
+      keys[i] = uint32_t(score + 0x8000) << 16 | m.getRaw();
+    }
+  }
+
+  int rank(Move m) const {
+    uint32_t key = 0;
+    for (int i = 0; i < moves.size(); i++)
+      if (moves.moves[i] == m)
+        key = keys[i];
+    int before = 0;
+    for (int i = 0; i < moves.size(); i++)
+      before += keys[i] > key;
+    return before;
+  }
+
+  Move atRank(int rank) {
+    std::nth_element(keys, keys + rank, keys + moves.size(),
+                     std::greater<uint32_t>());
+    return Move(static_cast<uint16_t>(keys[rank]));
+  }
+};
+
+class BitWriter {
+private:
+  std::vector<uint8_t> &out;
+  uint64_t buffer = 0;
+  int count = 0;
+
+public:
+  explicit BitWriter(std::vector<uint8_t> &out) : out(out) {}
+
+  // Up to 32 bits, first bit lowest
+  void write(uint32_t bits, int n) {
+    buffer |= uint64_t{bits} << count;
+    count += n;
+    for (; count >= 8; count -= 8) {
+      out.push_back(static_cast<uint8_t>(buffer));
+      buffer >>= 8;
+    }
+  }
+
+  // Elias gamma: the width of value in zeros, a one, then the bits below
+  // the leading one
+  void writeGamma(uint32_t value) {
+    int width = std::bit_width(value);
+    write(0, width - 1);
+    write(1, 1);
+    write(value & ((1u << (width - 1)) - 1), width - 1);
+  }
+
+  void finish() {
+    if (count)
+      out.push_back(static_cast<uint8_t>(buffer));
+    buffer = 0;
+    count = 0;
+  }
+};
+
+class BitReader {
+private:
+  const uint8_t *next;
+  const uint8_t *end;
+  uint64_t buffer = 0;
+  int count = 0;
+
+public:
+  BitReader(const uint8_t *begin, const uint8_t *end)
+      : next(begin), end(end) {}
+
+  uint32_t peek(int n) {
+    while (count <= 56 && next < end) {
+      buffer |= uint64_t{*next++} << count;
+      count += 8;
+    }
+    return buffer & ((uint64_t{1} << n) - 1);
+  }
+
+  void skip(int n) {
+    buffer >>= n;
+    count -= n;
+  }
+
+  uint32_t read(int n) {
+    uint32_t bits = peek(n);
+    skip(n);
+    return bits;
+  }
+
+  // Zero on a malformed code
+  uint32_t readGamma() {
+    uint32_t bits = peek(32);
+    int zeros = std::countr_zero(bits);
+    if (zeros > 16)
+      return 0;
+    skip(zeros + 1);
+    return 1u << zeros | read(zeros);
+  }
+
+  bool overrun() const { return count < 0; }
+};
+
+// Huffman code lengths for the symbols that occur, at most MaxCodeBits.
+// Longer codes are avoided by flattening the counts until none is needed.
+std::array<uint8_t, 256> codeLengths(std::array<uint64_t, 256> counts) {
+  std::array<uint8_t, 256> lengths{};
+  while (true) {
+    struct Node {
+      uint64_t weight;
+      int parent;
+    };
+    std::vector<Node> nodes;
+    using Entry = std::pair<uint64_t, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    for (int s = 0; s < 256; s++) {
+      nodes.push_back({counts[s], -1});
+      if (counts[s])
+        heap.push({counts[s], s});
+    }
+    if (heap.size() == 1) {
+      lengths[heap.top().second] = 1;
+      return lengths;
+    }
+    while (heap.size() > 1) {
+      auto [weightA, a] = heap.top();
+      heap.pop();
+      auto [weightB, b] = heap.top();
+      heap.pop();
+      nodes.push_back({weightA + weightB, -1});
+      nodes[a].parent = nodes[b].parent = int(nodes.size()) - 1;
+      heap.push({weightA + weightB, int(nodes.size()) - 1});
+    }
+
+    int longest = 0;
+    for (int s = 0; s < 256; s++) {
+      int length = 0;
+      for (int n = s; counts[s] && nodes[n].parent >= 0; n = nodes[n].parent)
+        length++;
+      lengths[s] = length;
+      longest = std::max(longest, length);
+    }
+    if (longest <= MaxCodeBits)
+      return lengths;
+    for (uint64_t &count : counts)
+      count = count ? (count + 1) / 2 : 0;
+  }
+}
+
+// Canonical codes for the lengths, bit-reversed to be read lowest bit first
+std::array<uint16_t, 256>
+canonicalCodes(const std::array<uint8_t, 256> &lengths) {
+  std::array<uint16_t, 256> codes{};
+  uint32_t code = 0;
+  for (int length = 1; length <= MaxCodeBits; length++) {
+    for (int s = 0; s < 256; s++) {
+      if (lengths[s] != length)
+        continue;
+      uint16_t reversed = 0;
+      for (int bit = 0; bit < length; bit++)
+        reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+      codes[s] = reversed;
+      code++;
+    }
+    code <<= 1;
+  }
+  return codes;
+}
+
+// Runs work(block) for blocks first to last, one at a time on each thread
+template <typename Work>
+void forEachBlock(uint32_t first, uint32_t last, unsigned threads,
+                  Work &&work) {
+  std::atomic<uint32_t> next{first};
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++)
+    workers.emplace_back([&] {
+      for (uint32_t block; (block = next.fetch_add(1)) < last;)
+        work(block);
+    });
+  for (std::thread &worker : workers)
+    worker.join();
+}
+
+} // namespace
+
+bool writeGameArchive(const GameDatabase &database, const std::string &path,
+                      const GameArchiveOptions &options) {
+  uint64_t games = database.size();
+  uint32_t perBlock = std::max<uint32_t>(1, options.gamesPerBlock);
+  uint64_t blockCount = (games + perBlock - 1) / perBlock;
+  if (blockCount > UINT32_MAX)
+    return false;
+  uint32_t blocks = static_cast<uint32_t>(blockCount);
+  unsigned threads = std::max(1u, options.threads);
+
+  auto gamesOf = [&](uint32_t block) {
+    uint64_t first = uint64_t{block} * perBlock;
+    return std::pair(first, std::min(first + perBlock, games));
+  };
+
+  // First pass: how often each rank is played
+  std::vector<std::array<uint64_t, 256>> histograms(threads);
+  {
+    std::atomic<uint32_t> next{0};
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+      workers.emplace_back([&, t] {
+        std::array<uint64_t, 256> &histogram = histograms[t];
+        histogram.fill(0);
+        std::vector<Move> moves;
+        OrderedMoves ordered;
+        for (uint32_t block; (block = next.fetch_add(1)) < blocks;) {
+          auto [first, last] = gamesOf(block);
+          for (uint64_t game = first; game < last; game++) {
+            database.getMoves(game, moves);
+            Position pos;
+            pos.setStartPos();
+            for (Move m : moves) {
+              ordered.generate(pos);
+              histogram[ordered.rank(m)]++;
+              pos.makeMove(m);
+            }
+          }
+        }
+      });
+    for (std::thread &worker : workers)
+      worker.join();
+  }
+
+  std::array<uint64_t, 256> counts{};
+  for (const auto &histogram : histograms)
+    for (int s = 0; s < 256; s++)
+      counts[s] += histogram[s];
+  std::array<uint8_t, 256> lengths = codeLengths(counts);
+  std::array<uint16_t, 256> codes = canonicalCodes(lengths);
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  uint8_t header[OffsetsStart];
+  store(header, ArchiveMagic, 4);
+  store(header + 4, Version, 4);
+  store(header + 8, games, 8);
+  store(header + 16, perBlock, 4);
+  store(header + 20, blocks, 4);
+  std::copy(lengths.begin(), lengths.end(), header + HeaderSize);
+  out.write(reinterpret_cast<const char *>(header), OffsetsStart);
+
+  std::vector<uint64_t> offsets{0};
+  out.seekp(OffsetsStart + 8 * (uint64_t{blocks} + 1));
+
+  // Second pass: blocks are coded in parallel a batch at a time and written
+  // in order
+  const uint32_t batch = 16 * threads;
+  std::vector<std::vector<uint8_t>> coded(batch);
+  for (uint32_t first = 0; first < blocks; first += batch) {
+    uint32_t last = std::min<uint64_t>(uint64_t{first} + batch, blocks);
+    forEachBlock(first, last, threads, [&](uint32_t block) {
+      std::vector<uint8_t> &bytes = coded[block - first];
+      bytes.clear();
+      BitWriter writer(bytes);
+      std::vector<Move> moves;
+      OrderedMoves ordered;
+      auto [begin, end] = gamesOf(block);
+      for (uint64_t game = begin; game < end; game++) {
+        database.getMoves(game, moves);
+        writer.writeGamma(moves.size() + 1);
+        Position pos;
+        pos.setStartPos();
+        for (Move m : moves) {
+          ordered.generate(pos);
+          int rank = ordered.rank(m);
+          writer.write(codes[rank], lengths[rank]);
+          pos.makeMove(m);
+        }
+      }
+      writer.finish();
+    });
+    for (uint32_t block = first; block < last; block++) {
+      const std::vector<uint8_t> &bytes = coded[block - first];
+      out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+      offsets.push_back(offsets.back() + bytes.size());
+    }
+  }
+
+  out.seekp(OffsetsStart);
+  for (uint64_t offset : offsets) {
+    uint8_t bytes[8];
+    store(bytes, offset, 8);
+    out.write(reinterpret_cast<const char *>(bytes), 8);
+  }
+  return static_cast<bool>(out);
+}
+
+bool GameArchive::open(const std::string &path) {
+  close();
+  if (!file.open(path, false))
+    return false;
+
+  const uint8_t *bytes =
+      reinterpret_cast<const uint8_t *>(file.getView().data());
+  if (file.size() < OffsetsStart || load(bytes, 4) != ArchiveMagic ||
+      load(bytes + 4, 4) != Version) {
+    close();
+    return false;
+  }
+  games = load(bytes + 8, 8);
+  gamesPerBlock = load(bytes + 16, 4);
+  blocks = load(bytes + 20, 4);
+  uint64_t dataStart = OffsetsStart + 8 * (uint64_t{blocks} + 1);
+
+  // The code must fit the decoding table without overlaps
+  const uint8_t *lengths = bytes + HeaderSize;
+  uint64_t space = 0;
+  for (int s = 0; s < 256; s++)
+    if (lengths[s])
+      space += lengths[s] <= MaxCodeBits ? 1 << (MaxCodeBits - lengths[s])
+                                         : 1 << MaxCodeBits;
+  if (!gamesPerBlock || space > (1 << MaxCodeBits) ||
+      uint64_t{blocks} != (games + gamesPerBlock - 1) / gamesPerBlock ||
+      dataStart > file.size()) {
+    close();
+    return false;
+  }
+  offsets = bytes + OffsetsStart;
+  data = bytes + dataStart;
+
+  // decode trusts the offsets: they start at zero, never decrease and end
+  // at the last byte of the file
+  uint64_t previous = 0;
+  for (uint64_t b = 0; b <= blocks; b++) {
+    uint64_t offset = load(offsets + 8 * b, 8);
+    if ((b == 0 && offset) || offset < previous) {
+      close();
+      return false;
+    }
+    previous = offset;
+  }
+  if (previous != file.size() - dataStart) {
+    close();
+    return false;
+  }
+
+  std::array<uint8_t, 256> lengthArray;
+  std::copy(lengths, lengths + 256, lengthArray.begin());
+  std::array<uint16_t, 256> codes = canonicalCodes(lengthArray);
+  // Unused entries decode as length zero, which stops the decoder
+  table.assign(1 << MaxCodeBits, 0);
+  for (int s = 0; s < 256; s++)
+    for (uint32_t i = codes[s]; lengths[s] && i < table.size();
+         i += 1 << lengths[s])
+      table[i] = s | lengths[s] << 8;
+  return true;
+}
+
+void GameArchive::close() {
+  file.close();
+  games = 0;
+  gamesPerBlock = blocks = 0;
+  offsets = data = nullptr;
+  table.clear();
+}
+
+template <typename Visit>
+bool GameArchive::decode(uint32_t block, Visit &&visit) const {
+  if (block >= blocks)
+    return false;
+  uint64_t begin = load(offsets + 8 * uint64_t{block}, 8);
+  uint64_t end = load(offsets + 8 * (uint64_t{block} + 1), 8);
+  BitReader reader(data + begin, data + end);
+
+  uint64_t first = uint64_t{block} * gamesPerBlock;
+  uint64_t last = std::min(first + gamesPerBlock, games);
+  std::vector<Move> moves;
+  OrderedMoves ordered;
+
+  for (uint64_t game = first; game < last; game++) {
+    uint32_t plies = reader.readGamma();
+    if (!plies--)
+      return false;
+    moves.clear();
+    Position pos;
+    pos.setStartPos();
+    for (uint32_t ply = 0; ply < plies; ply++) {
+      uint16_t entry = table[reader.peek(MaxCodeBits)];
+      int length = entry >> 8, rank = entry & 255;
+      ordered.generate(pos);
+      if (!length || rank >= ordered.moves.size())
+        return false;
+      reader.skip(length);
+      Move m = ordered.atRank(rank);
+      moves.push_back(m);
+      pos.makeMove(m);
+    }
+    if (reader.overrun())
+      return false;
+    if (!visit(static_cast<uint32_t>(game), moves))
+      return true;
+  }
+  return true;
+}
+
+bool GameArchive::getMoves(uint32_t game, std::vector<Move> &moves) const {
+  if (game >= games)
+    return false;
+  bool found = false;
+  decode(game / gamesPerBlock, [&](uint32_t id, const std::vector<Move> &m) {
+    if (id != game)
+      return true;
+    moves = m;
+    found = true;
+    return false;
+  });
+  return found;
+}
+
+bool GameArchive::decodeBlock(uint32_t block, std::vector<Move> &moves,
+                              std::vector<uint32_t> &ends) const {
+  moves.clear();
+  ends.clear();
+  return decode(block, [&](uint32_t, const std::vector<Move> &m) {
+    moves.insert(moves.end(), m.begin(), m.end());
+    ends.push_back(moves.size());
+    return true;
+  });
+}
@@ -0,0 +1,389 @@
+#include "GameDatabase.h"
+#include "SortedRuns.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t GamesMagic = 0x42444743; // "CGDB"
+constexpr uint32_t IndexMagic = 0x58444743; // "CGDX"
+constexpr uint32_t Version = 1;
+constexpr size_t GamesHeaderSize = 16;
+constexpr size_t IndexHeaderSize = 24;
+constexpr size_t KeyEntrySize = 16;
+
+void store16(uint8_t *out, uint16_t value) {
+  out[0] = value;
+  out[1] = value >> 8;
+}
+
+void store32(uint8_t *out, uint32_t value) {
+  for (int i = 0; i < 4; i++)
+    out[i] = value >> (8 * i);
+}
+
+void store64(uint8_t *out, uint64_t value) {
+  for (int i = 0; i < 8; i++)
+    out[i] = value >> (8 * i);
+}
+
+uint16_t load16(const uint8_t *in) { return in[0] | in[1] << 8; }
+
+uint32_t load32(const uint8_t *in) {
+  return in[0] | in[1] << 8 | in[2] << 16 | uint32_t(in[3]) << 24;
+}
+
+uint64_t load64(const uint8_t *in) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--)
+    value = value << 8 | in[i];
+  return value;
+}
+
+void copyName(char (&out)[22], std::string_view name) {
+  std::memset(out, 0, sizeof(out));
+  if (name == "?")
+    return;
+  std::memcpy(out, name.data(), std::min(name.size(), sizeof(out)));
+}
+
+// "2023.05.01", with "??" for unknown parts
+uint32_t parseDate(std::string_view date) {
+  uint32_t parts[3] = {};
+  for (int i = 0; i < 3 && !date.empty(); i++) {
+    size_t dot = date.find('.');
+    std::string_view part = date.substr(0, dot);
+    std::from_chars(part.data(), part.data() + part.size(), parts[i]);
+    date = dot == std::string_view::npos ? std::string_view()
+                                         : date.substr(dot + 1);
+  }
+  if (parts[0] > 9999 || parts[1] > 12 || parts[2] > 31)
+    return 0;
+  return parts[0] * 10000 + parts[1] * 100 + parts[2];
+}
+
+uint16_t parseElo(std::string_view elo) {
+  unsigned value = 0;
+  std::from_chars(elo.data(), elo.data() + elo.size(), value);
+  return value > 65535 ? 0 : value;
+}
+
+} // namespace
+
+// Key and game in native byte order
+struct GameDatabaseWriter::RunFormat {
+  using Record = Pair;
+  static constexpr size_t Size = 12;
+
+  static void store(const Pair &pair, uint8_t *out) {
+    std::memcpy(out, &pair.key, 8);
+    std::memcpy(out + 8, &pair.game, 4);
+  }
+
+  static Pair load(const uint8_t *in) {
+    Pair pair;
+    std::memcpy(&pair.key, in, 8);
+    std::memcpy(&pair.game, in + 8, 4);
+    return pair;
+  }
+};
+
+// Bytes 0-7 first move, 8-9 plies, 10 result, 11 zero, 12-13 and 14-15 the
+// ratings, 16-19 date, 20-41 white, 42-63 black
+void writeGameHeader(const GameHeader &header, uint8_t *out) {
+  store64(out, header.firstMove);
+  store16(out + 8, header.plies);
+  out[10] = static_cast<uint8_t>(header.result);
+  out[11] = 0;
+  store16(out + 12, header.whiteElo);
+  store16(out + 14, header.blackElo);
+  store32(out + 16, header.date);
+  std::memcpy(out + 20, header.white, sizeof(header.white));
+  std::memcpy(out + 42, header.black, sizeof(header.black));
+}
+
+GameHeader readGameHeader(const uint8_t *in) {
+  GameHeader header;
+  header.firstMove = load64(in);
+  header.plies = load16(in + 8);
+  header.result = static_cast<int8_t>(in[10]);
+  header.whiteElo = load16(in + 12);
+  header.blackElo = load16(in + 14);
+  header.date = load32(in + 16);
+  std::memcpy(header.white, in + 20, sizeof(header.white));
+  std::memcpy(header.black, in + 42, sizeof(header.black));
+  return header;
+}
+
+void readGameTags(const PgnGame &game, GameHeader &header) {
+  header.result = game.result == "1-0"       ? 1
+                  : game.result == "0-1"     ? -1
+                  : game.result == "1/2-1/2" ? 0
+                                             : UnknownResult;
+  header.whiteElo = parseElo(game.getTag("WhiteElo"));
+  header.blackElo = parseElo(game.getTag("BlackElo"));
+  header.date = parseDate(game.getTag("Date"));
+  copyName(header.white, game.getTag("White"));
+  copyName(header.black, game.getTag("Black"));
+}
+
+GameDatabaseWriter::GameDatabaseWriter(const GameDatabaseOptions &options)
+    : options(options) {}
+
+GameDatabaseWriter::~GameDatabaseWriter() {
+  for (const std::string &run : runs)
+    std::remove(run.c_str());
+}
+
+bool GameDatabaseWriter::open(const std::string &base) {
+  this->base = base;
+  games.open(base + ".games", std::ios::binary | std::ios::trunc);
+  moves.open(base + ".moves", std::ios::binary | std::ios::trunc);
+  // The game count is filled in by finish
+  uint8_t header[GamesHeaderSize] = {};
+  games.write(reinterpret_cast<const char *>(header), GamesHeaderSize);
+  return games && moves;
+}
+
+bool GameDatabaseWriter::addGame(const PgnGame &game,
+                                 const std::vector<Move> &gameMoves) {
+  if (gameCount > UINT32_MAX)
+    return false;
+
+  GameHeader header;
+  readGameTags(game, header);
+  header.firstMove = moveCount;
+  header.plies = std::min<size_t>(gameMoves.size(), UINT16_MAX);
+
+  uint8_t bytes[GameHeaderSize];
+  writeGameHeader(header, bytes);
+  games.write(reinterpret_cast<const char *>(bytes), GameHeaderSize);
+
+  // The position after every move; the start position, in every game, is
+  // left out
+  Position pos;
+  pos.setStartPos();
+  uint32_t id = static_cast<uint32_t>(gameCount);
+  int indexed = options.maxPly ? options.maxPly : header.plies;
+  for (int ply = 0; ply < header.plies; ply++) {
+    uint8_t move[2];
+    store16(move, gameMoves[ply].getRaw());
+    moves.write(reinterpret_cast<const char *>(move), 2);
+    if (ply < indexed) {
+      pos.makeMove(gameMoves[ply]);
+      pairs.push_back({pos.getKey(), id});
+    }
+  }
+
+  gameCount++;
+  moveCount += header.plies;
+  if (pairs.size() * sizeof(Pair) > options.memoryLimit && !spill())
+    return false;
+  return static_cast<bool>(games) && static_cast<bool>(moves);
+}
+
+bool GameDatabaseWriter::spill() {
+  if (pairs.empty())
+    return true;
+
+  std::string path = options.tempDirectory + "/gamedb-" +
+                     std::to_string(getpid()) + "-" +
+                     std::to_string(runs.size()) + ".run";
+  runs.push_back(path);
+  bool written = writeSortedRun<RunFormat>(path, pairs);
+  pairCount += pairs.size();
+  pairs.clear();
+  return written;
+}
+
+bool GameDatabaseWriter::finish() {
+  uint8_t header[GamesHeaderSize] = {};
+  store32(header, GamesMagic);
+  store32(header + 4, Version);
+  store64(header + 8, gameCount);
+  games.seekp(0);
+  games.write(reinterpret_cast<const char *>(header), GamesHeaderSize);
+  games.close();
+  moves.close();
+  if (!games || !moves || !spill())
+    return false;
+  return writeIndex();
+}
+
+bool GameDatabaseWriter::writeIndex() {
+  // About four positions per bucket if every pair were a new position
+  int bits = std::clamp(int(std::bit_width(pairCount / 4)), 1, 28);
+  size_t buckets = size_t{1} << bits;
+  std::vector<uint64_t> directory(buckets + 1);
+
+  // Key entries go straight to the index, postings to a side file that is
+  // appended once the number of keys is known
+  std::ofstream out(base + ".index", std::ios::binary | std::ios::trunc);
+  std::string postingsPath = base + ".index.tmp";
+  std::ofstream postings(postingsPath, std::ios::binary | std::ios::trunc);
+  out.seekp(IndexHeaderSize + 8 * (buckets + 1));
+
+  uint64_t keyCount = 0, postingCount = 0;
+  size_t filled = 0; // Buckets whose start is known
+  Pair last{0, 0};
+  bool any = false;
+  uint8_t bytes[KeyEntrySize];
+
+  bool merged = mergeRuns<RunFormat>(runs, [&](const Pair &pair) {
+    // A game that reaches a position twice is listed once
+    if (any && pair.key == last.key && pair.game == last.game)
+      return;
+    if (!any || pair.key != last.key) {
+      size_t bucket = pair.key >> (64 - bits);
+      while (filled <= bucket)
+        directory[filled++] = keyCount;
+      store64(bytes, pair.key);
+      store64(bytes + 8, postingCount);
+      out.write(reinterpret_cast<const char *>(bytes), KeyEntrySize);
+      keyCount++;
+    }
+    store32(bytes, pair.game);
+    postings.write(reinterpret_cast<const char *>(bytes), 4);
+    postingCount++;
+    last = pair;
+    any = true;
+  });
+  while (filled <= buckets)
+    directory[filled++] = keyCount;
+
+  // A final entry ends the last key's postings
+  store64(bytes, UINT64_MAX);
+  store64(bytes + 8, postingCount);
+  out.write(reinterpret_cast<const char *>(bytes), KeyEntrySize);
+
+  postings.close();
+  std::ifstream in(postingsPath, std::ios::binary);
+  if (postingCount)
+    out << in.rdbuf();
+  in.close();
+  std::remove(postingsPath.c_str());
+
+  uint8_t header[IndexHeaderSize];
+  store32(header, IndexMagic);
+  store32(header + 4, bits);
+  store64(header + 8, keyCount);
+  store64(header + 16, postingCount);
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(header), IndexHeaderSize);
+  for (uint64_t start : directory) {
+    store64(bytes, start);
+    out.write(reinterpret_cast<const char *>(bytes), 8);
+  }
+  return merged && static_cast<bool>(postings) && static_cast<bool>(out);
+}
+
+bool GameDatabase::open(const std::string &base) {
+  close();
+  if (!games.open(base + ".games", false) ||
+      !index.open(base + ".index", false)) {
+    close();
+    return false;
+  }
+  // Fails for an empty file, which games without moves leave
+  moves.open(base + ".moves", false);
+
+  auto bytes = [](const MappedFile &file) {
+    return reinterpret_cast<const uint8_t *>(file.getView().data());
+  };
+  const uint8_t *g = bytes(games), *x = bytes(index);
+  if (games.size() < GamesHeaderSize || load32(g) != GamesMagic ||
+      load32(g + 4) != Version || index.size() < IndexHeaderSize ||
+      load32(x) != IndexMagic) {
+    close();
+    return false;
+  }
+
+  gameCount = load64(g + 8);
+  bits = load32(x + 4);
+  keyCount = load64(x + 8);
+  postingCount = load64(x + 16);
+  // Counts are bounded by the file sizes before any size is computed from
+  // them, so a damaged header cannot overflow the checks below
+  if (bits < 1 || bits > 28 || gameCount > games.size() / GameHeaderSize ||
+      keyCount >= index.size() / KeyEntrySize ||
+      postingCount > index.size() / 4) {
+    close();
+    return false;
+  }
+  size_t directorySize = 8 * ((size_t{1} << bits) + 1);
+  if (games.size() != GamesHeaderSize + gameCount * GameHeaderSize ||
+      index.size() != IndexHeaderSize + directorySize +
+                          (keyCount + 1) * KeyEntrySize + 4 * postingCount) {
+    close();
+    return false;
+  }
+
+  directory = x + IndexHeaderSize;
+  keys = directory + directorySize;
+  postings = keys + (keyCount + 1) * KeyEntrySize;
+  return true;
+}
+
+void GameDatabase::close() {
+  games.close();
+  moves.close();
+  index.close();
+  gameCount = keyCount = postingCount = 0;
+  directory = keys = postings = nullptr;
+}
+
+GameHeader GameDatabase::getHeader(uint32_t game) const {
+  if (game >= gameCount)
+    return {};
+  return readGameHeader(
+      reinterpret_cast<const uint8_t *>(games.getView().data()) +
+      GamesHeaderSize + size_t{game} * GameHeaderSize);
+}
+
+void GameDatabase::getMoves(uint32_t game, std::vector<Move> &out) const {
+  GameHeader header = getHeader(game);
+  out.clear();
+  if ((header.firstMove + header.plies) * 2 > moves.size())
+    return;
+  const uint8_t *data =
+      reinterpret_cast<const uint8_t *>(moves.getView().data()) +
+      header.firstMove * 2;
+  for (int ply = 0; ply < header.plies; ply++)
+    out.push_back(Move(load16(data + 2 * ply)));
+}
+
+GameIdList GameDatabase::findGames(uint64_t key) const {
+  if (!directory)
+    return {};
+  size_t bucket = key >> (64 - bits);
+  uint64_t low = load64(directory + 8 * bucket);
+  uint64_t high = load64(directory + 8 * (bucket + 1));
+  if (low > high || high > keyCount)
+    return {};
+
+  while (low < high) {
+    uint64_t middle = (low + high) / 2;
+    uint64_t found = load64(keys + middle * KeyEntrySize);
+    if (found == key) {
+      const uint8_t *entry = keys + middle * KeyEntrySize;
+      uint64_t first = load64(entry + 8);
+      uint64_t last = load64(entry + KeyEntrySize + 8);
+      if (first > last || last > postingCount)
+        return {};
+      GameIdList games(postings + 4 * first, last - first);
+      for (size_t i = 0; i < games.size(); i++)
+        if (games[i] >= gameCount)
+          return {};
+      return games;
+    }
+    if (found < key)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return {};
+}
@@ -0,0 +1,253 @@
+#include "GameSession.h"
+#include "Board.h"
+#include "Piece.h"
+#include "Position.h"
+#include <algorithm>
+#include <iostream>
+
+GameSession::GameSession(Board &board, EngineWorker &engine,
+                         const PlayOptions &options, int64_t nowMs)
+    : board(board), engine(engine), options(options),
+      remainingMs{options.initialMs, options.initialMs}, turnStartMs(nowMs),
+      seenMoves(board.getMoveCount()) {}
+
+Color GameSession::getSideToMove() const {
+  return board.isWhiteTurn() ? White : Black;
+}
+
+Color GameSession::getRunningClock() const {
+  Color side = getSideToMove();
+  return board.getMoveCount() != seenMoves ? ~side : side;
+}
+
+bool GameSession::isHumanTurn() const {
+  return !options.engineSide[getSideToMove()];
+}
+
+int64_t GameSession::getRemainingMs(Color side, int64_t nowMs) const {
+  if (!isTimed())
+    return 0;
+  int64_t remaining = remainingMs[side];
+  if (side == getRunningClock() && !flagged)
+    remaining -= nowMs - turnStartMs;
+  return std::max<int64_t>(remaining, 0);
+}
+
+TimeBudget GameSession::budgetFor(Color side, int64_t nowMs) const {
+  if (!isTimed())
+    return {0, options.untimedMoveMs};
+  TimeControl control;
+  control.remainingMs = getRemainingMs(side, nowMs);
+  control.incrementMs = options.incrementMs;
+  return allocateTime(control);
+}
+
+SearchLimits GameSession::limitsFor(const TimeBudget &budget) const {
+  SearchLimits limits;
+  limits.softTimeMs = budget.softMs;
+  limits.moveTimeMs = budget.hardMs;
+  return limits;
+}
+
+void GameSession::settleClock(int64_t nowMs) {
+  // A promotion is settled once the piece is chosen
+  if (board.getMoveCount() == seenMoves ||
+      board.getGameState() != GameState::Playing)
+    return;
+  Color mover = ~getSideToMove();
+  remainingMs[mover] += options.incrementMs - (nowMs - turnStartMs);
+  turnStartMs = nowMs;
+  seenMoves = board.getMoveCount();
+}
+
+bool GameSession::lastMoveWas(Move move) const {
+  BoardMove last = board.getLastMove();
+  if (last.from != Board::gridSquare(move.getFrom()) ||
+      last.to != Board::gridSquare(move.getTo()))
+    return false;
+  if (move.getFlag() != MoveFlag::Promotion)
+    return true;
+  // The pawn may have become another piece than expected
+  Piece *piece = board.getPieceAt(last.to.x, last.to.y);
+  return piece && piece->getType() == move.getPromotion();
+}
+
+void GameSession::update(int64_t nowMs) {
+  if (board.getMoveCount() != seenMoves &&
+      board.getGameState() == GameState::Playing) {
+    settleClock(nowMs);
+    // A human moved while the engine searched a move for them
+    if (searchId) {
+      engine.cancel();
+      searchId = 0;
+    }
+  }
+
+  if (!flagged && isTimed() &&
+      getRemainingMs(getRunningClock(), nowMs) == 0) {
+    flagged = getRunningClock();
+    remainingMs[*flagged] = 0;
+  }
+  if (flagged || stopped || board.checkIfWon()) {
+    if (searchId || ponderId)
+      engine.cancel();
+    searchId = ponderId = 0;
+    return;
+  }
+
+  EngineEvent event;
+  while (engine.poll(event)) {
+    if (event.kind != EngineEvent::Kind::BestMove)
+      continue;
+    if (searchId && event.searchId == searchId) {
+      searchId = 0;
+      bool played = !event.best.isNull() &&
+                    playEngineMove(event.best, event.ponder, nowMs);
+      // After a pondered search that missed, the board is searched afresh
+      // below. A search of the board itself only finds no move when the
+      // game is over.
+      if (!played && !searchPondered) {
+        if (event.best.isNull()) {
+          std::cout << "The engine has no move to play\n";
+          stopped = true;
+        } else
+          playAllowedMove(nowMs);
+      }
+    } else if (ponderId && event.searchId == ponderId) {
+      ponderFinished = true;
+      ponderBest = event.best;
+      ponderNext = event.ponder;
+    }
+  }
+
+  if (!isHumanTurn() && !searchId && !stopped &&
+      board.getGameState() == GameState::Playing && !board.checkIfWon())
+    startSearch(nowMs);
+}
+
+void GameSession::requestEngineMove(int64_t nowMs) {
+  if (!isHumanTurn() || searchId || flagged || stopped ||
+      board.getGameState() != GameState::Playing || board.checkIfWon())
+    return;
+  cancelPonder();
+  TimeBudget budget = budgetFor(getSideToMove(), nowMs);
+  SearchLimits limits = limitsFor(budget);
+  Position pos = board.getPosition();
+  if (!prepareSearch(pos, limits, nowMs))
+    return;
+  searchPondered = false;
+  searchId = engine.startSearch(pos, limits);
+}
+
+bool GameSession::prepareSearch(const Position &pos, SearchLimits &limits,
+                                int64_t nowMs) {
+  // The GUI rules let a king be left attacked and end the game when it is
+  // taken; search and move generation assume it never can be
+  if (!pos.isValid()) {
+    Color us = pos.getSideToMove();
+    if (popCount(pos.getPieces(White, PieceType::King)) == 1 &&
+        popCount(pos.getPieces(Black, PieceType::King)) == 1) {
+      int king = pos.getKingSquare(~us);
+      Bitboard attackers =
+          pos.attackersTo(king, pos.getOccupied()) & pos.getPieces(us);
+      while (attackers)
+        if (board.playMove(Move(popLsb(attackers), king))) {
+          settleClock(nowMs);
+          return false;
+        }
+    }
+    std::cout << "The engine cannot play on from this position\n";
+    stopped = true;
+    return false;
+  }
+
+  // Only moves both rule sets allow are searched. The core may call the
+  // position mate or stalemate while the GUI, which lets a king be left
+  // attacked, still has moves; one of those is played instead.
+  MoveList legal;
+  pos.generateLegalMoves(legal);
+  limits.searchMoves.clear();
+  for (Move m : board.getAllowedMoves())
+    if (std::find(legal.begin(), legal.end(), m) != legal.end())
+      limits.searchMoves.push_back(m);
+  if (limits.searchMoves.empty()) {
+    playAllowedMove(nowMs);
+    return false;
+  }
+  return true;
+}
+
+void GameSession::playAllowedMove(int64_t nowMs) {
+  std::vector<Move> allowed = board.getAllowedMoves();
+  if (allowed.empty() || !board.playMove(allowed.front())) {
+    std::cout << "The engine has no move to play\n";
+    stopped = true;
+    return;
+  }
+  std::cout << "The engine plays " << allowed.front().toUci()
+            << ", which the GUI rules allow\n";
+  settleClock(nowMs);
+}
+
+void GameSession::startSearch(int64_t nowMs) {
+  TimeBudget budget = budgetFor(getSideToMove(), nowMs);
+  if (ponderId && lastMoveWas(expectedReply)) {
+    // The expected reply came: the ponder search goes on as this move's
+    uint64_t hit = ponderId;
+    ponderId = 0;
+    searchPondered = true;
+    if (ponderFinished) {
+      if (!ponderBest.isNull() && playEngineMove(ponderBest, ponderNext, nowMs))
+        return;
+    } else {
+      engine.setTimeLimits(hit, budget.softMs, budget.hardMs);
+      searchId = hit;
+      return;
+    }
+  }
+  cancelPonder();
+  SearchLimits limits = limitsFor(budget);
+  Position pos = board.getPosition();
+  if (!prepareSearch(pos, limits, nowMs))
+    return;
+  searchPondered = false;
+  searchId = engine.startSearch(pos, limits);
+}
+
+void GameSession::startPonder(Move reply) {
+  Position pos = board.getPosition();
+  if (!pos.isValid())
+    return;
+  MoveList moves;
+  pos.generateLegalMoves(moves);
+  if (std::find(moves.begin(), moves.end(), reply) == moves.end())
+    return;
+  pos.makeMove(reply);
+  // No limits: it runs until the reply comes or turns out different
+  ponderId = engine.startSearch(pos, SearchLimits());
+  expectedReply = reply;
+  ponderFinished = false;
+}
+
+void GameSession::cancelPonder() {
+  if (ponderId)
+    engine.cancel();
+  ponderId = 0;
+  ponderFinished = false;
+}
+
+bool GameSession::playEngineMove(Move best, Move ponder, int64_t nowMs) {
+  // A ponder search sees the reply made with the core's rules, so its move
+  // may not fit the GUI's; the caller then searches the board afresh
+  if (!board.playMove(best)) {
+    if (!searchPondered)
+      std::cout << "The engine's move " << best.toUci()
+                << " is not allowed here\n";
+    return false;
+  }
+  settleClock(nowMs);
+  if (options.ponder && !ponder.isNull() && isHumanTurn() &&
+      options.engineSide[~getSideToMove()])
+    startPonder(ponder);
+  return true;
+}
@@ -0,0 +1,35 @@
+#include "MappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string &path, bool sequential) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  void *mapping = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0)
+    mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED)
+    return false;
+
+  madvise(mapping, info.st_size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+  data = static_cast<const char *>(mapping);
+  length = info.st_size;
+  return true;
+}
+
+void MappedFile::close() {
+  if (data)
+    munmap(const_cast<char *>(data), length);
+  data = nullptr;
+  length = 0;
+}
@@ -0,0 +1,200 @@
+#include "Nnue.h"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <memory>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define NNUE_AVX2 1
+#endif
+
+namespace {
+
+std::unique_ptr<Nnue::Network> network;
+
+// Little-endian arrays, converted in place on big-endian hosts
+template <typename T> bool readArray(std::FILE *file, T *data, size_t count) {
+  if (std::fread(data, sizeof(T), count, file) != count)
+    return false;
+  if constexpr (std::endian::native == std::endian::big)
+    for (size_t i = 0; i < count; i++)
+      data[i] = std::byteswap(data[i]);
+  return true;
+}
+
+template <typename T>
+bool writeArray(std::FILE *file, const T *data, size_t count) {
+  if constexpr (std::endian::native == std::endian::big) {
+    for (size_t i = 0; i < count; i++) {
+      T value = std::byteswap(data[i]);
+      if (std::fwrite(&value, sizeof(T), 1, file) != 1)
+        return false;
+    }
+    return true;
+  }
+  return std::fwrite(data, sizeof(T), count, file) == count;
+}
+
+void addRowScalar(int16_t *values, const int16_t *row, int hidden) {
+  for (int i = 0; i < hidden; i++)
+    values[i] += row[i];
+}
+
+int32_t outputScalar(const int16_t *values, const int16_t *weights,
+                     int hidden) {
+  int32_t sum = 0;
+  for (int i = 0; i < hidden; i++)
+    sum += std::clamp<int32_t>(values[i], 0, Nnue::QA) * weights[i];
+  return sum;
+}
+
+#ifdef NNUE_AVX2
+__attribute__((target("avx2"))) void addRowAvx2(int16_t *values,
+                                                const int16_t *row,
+                                                int hidden) {
+  for (int i = 0; i < hidden; i += 16) {
+    __m256i v = _mm256_load_si256(reinterpret_cast<__m256i *>(values + i));
+    __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i));
+    _mm256_store_si256(reinterpret_cast<__m256i *>(values + i),
+                       _mm256_add_epi16(v, w));
+  }
+}
+
+__attribute__((target("avx2"))) int32_t
+outputAvx2(const int16_t *values, const int16_t *weights, int hidden) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i ceiling = _mm256_set1_epi16(Nnue::QA);
+  __m256i sum = _mm256_setzero_si256();
+  for (int i = 0; i < hidden; i += 16) {
+    __m256i v =
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(values + i));
+    __m256i w =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + i));
+    v = _mm256_min_epi16(_mm256_max_epi16(v, zero), ceiling);
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, w));
+  }
+  __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                               _mm256_extracti128_si256(sum, 1));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+  return _mm_cvtsi128_si32(half);
+}
+
+const bool hasAvx2 = __builtin_cpu_supports("avx2");
+#endif
+
+void addRow(int16_t *values, const int16_t *row, int hidden) {
+#ifdef NNUE_AVX2
+  if (hasAvx2)
+    return addRowAvx2(values, row, hidden);
+#endif
+  addRowScalar(values, row, hidden);
+}
+
+int32_t outputSum(const int16_t *values, const int16_t *weights, int hidden) {
+#ifdef NNUE_AVX2
+  if (hasAvx2)
+    return outputAvx2(values, weights, hidden);
+#endif
+  return outputScalar(values, weights, hidden);
+}
+
+} // namespace
+
+namespace Nnue {
+
+bool Network::assign(int hidden, std::vector<int16_t> inputWeights,
+                     std::vector<int16_t> hiddenBias,
+                     std::vector<int16_t> outputWeights, int32_t outputBias) {
+  if (hidden <= 0 || hidden > MaxHidden || hidden % 16 ||
+      inputWeights.size() != size_t(Inputs) * hidden ||
+      hiddenBias.size() != size_t(hidden) ||
+      outputWeights.size() != 2 * size_t(hidden))
+    return false;
+  this->hidden = hidden;
+  this->inputWeights = std::move(inputWeights);
+  this->hiddenBias = std::move(hiddenBias);
+  this->outputWeights = std::move(outputWeights);
+  this->outputBias = outputBias;
+  return true;
+}
+
+bool Network::load(const std::string &path) {
+  std::FILE *file = std::fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+
+  uint32_t header[2];
+  bool ok = readArray(file, header, 2) && header[0] == Magic &&
+            header[1] > 0 && header[1] <= MaxHidden;
+  int size = ok ? header[1] : 0;
+  std::vector<int16_t> input(size_t(Inputs) * size), bias(size),
+      output(2 * size);
+  int32_t outBias = 0;
+  ok = ok && readArray(file, input.data(), input.size()) &&
+       readArray(file, bias.data(), bias.size()) &&
+       readArray(file, output.data(), output.size()) &&
+       readArray(file, &outBias, 1) && std::fgetc(file) == EOF;
+  std::fclose(file);
+
+  return ok && assign(size, std::move(input), std::move(bias),
+                      std::move(output), outBias);
+}
+
+bool Network::save(const std::string &path) const {
+  std::FILE *file = std::fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+
+  uint32_t header[2] = {Magic, uint32_t(hidden)};
+  bool ok = writeArray(file, header, 2) &&
+            writeArray(file, inputWeights.data(), inputWeights.size()) &&
+            writeArray(file, hiddenBias.data(), hiddenBias.size()) &&
+            writeArray(file, outputWeights.data(), outputWeights.size()) &&
+            writeArray(file, &outputBias, 1);
+  return std::fclose(file) == 0 && ok;
+}
+
+void Network::refresh(const Position &pos, Accumulator &accumulator) const {
+  for (Color perspective : {White, Black}) {
+    int16_t *values = accumulator.values[perspective];
+    std::copy(hiddenBias.begin(), hiddenBias.end(), values);
+
+    Bitboard occupied = pos.getOccupied();
+    while (occupied) {
+      int sq = popLsb(occupied);
+      int feature = featureIndex(perspective, pos.getPieceOn(sq), sq);
+      addRow(values, &inputWeights[size_t(feature) * hidden], hidden);
+    }
+  }
+}
+
+int Network::output(const Accumulator &accumulator, Color sideToMove) const {
+  int64_t sum =
+      outputBias +
+      outputSum(accumulator.values[sideToMove], &outputWeights[0], hidden) +
+      outputSum(accumulator.values[~sideToMove], &outputWeights[hidden],
+                hidden);
+  return static_cast<int>(sum * OutputScale / (QA * QB));
+}
+
+int Network::evaluate(const Position &pos) const {
+  Accumulator accumulator;
+  refresh(pos, accumulator);
+  return output(accumulator, pos.getSideToMove());
+}
+
+bool loadNetwork(const std::string &path) {
+  auto loaded = std::make_unique<Network>();
+  if (!loaded->load(path))
+    return false;
+  network = std::move(loaded);
+  return true;
+}
+
+void unloadNetwork() { network.reset(); }
+
+const Network *getNetwork() { return network.get(); }
+
+} // namespace Nnue
@@ -0,0 +1,147 @@
+#include "PackedPosition.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool PackedPosition::pack(const Position &pos) {
+  std::memset(bytes, 0, sizeof(bytes));
+
+  Bitboard occupied = pos.getOccupied();
+  if (popCount(occupied) > 32)
+    return false;
+  for (int i = 0; i < 8; i++)
+    bytes[i] = occupied >> (8 * i);
+
+  int i = 0;
+  for (Bitboard pieces = occupied; pieces; i++)
+    bytes[8 + i / 2] |= pos.getPieceOn(popLsb(pieces)) << (4 * (i & 1));
+
+  int ep = pos.getEpSquare();
+  int fullmove = std::clamp(pos.getFullmoveNumber(), 1, 65535);
+  bytes[24] = pos.getSideToMove() | pos.getCastlingRights() << 1;
+  bytes[25] = ep == NoSquare ? 64 : ep;
+  bytes[26] = std::min(pos.getHalfmoveClock(), 255);
+  bytes[27] = fullmove;
+  bytes[28] = fullmove >> 8;
+  return true;
+}
+
+bool PackedPosition::unpack(Position &pos) const {
+  pos.clear();
+
+  // forEachPiece reads 32 piece codes at most, and the padding is zero
+  bool valid = popCount(getOccupied()) <= 32 && !bytes[29] && !bytes[30] &&
+               !bytes[31];
+  forEachPiece([&](int square, int piece) {
+    if (piece < 12)
+      pos.putPiece(colorOf(piece), typeOf(piece), square);
+    else
+      valid = false;
+  });
+
+  Color us = getSideToMove();
+  pos.setSideToMove(us);
+
+  uint8_t rights = bytes[24] >> 1 & 15;
+  for (int right = 0; right < 4; right++) {
+    Color c = right < 2 ? White : Black;
+    int rank = c == White ? 0 : 7;
+    int rook = makeSquare(right % 2 == 0 ? 7 : 0, rank);
+    if ((rights & 1 << right) &&
+        (pos.getPieceOn(makeSquare(4, rank)) !=
+             makePiece(c, PieceType::King) ||
+         pos.getPieceOn(rook) != makePiece(c, PieceType::Rook)))
+      valid = false;
+  }
+  pos.setCastlingRights(rights);
+
+  int ep = bytes[25];
+  if (ep < 64) {
+    // The pawn that moved stands one square past it, towards us
+    int pushed = us == White ? ep - 8 : ep + 8;
+    if (rankOf(ep) != (us == White ? 5 : 2) || pos.getPieceOn(ep) != NoPiece ||
+        pos.getPieceOn(pushed) != makePiece(~us, PieceType::Pawn) ||
+        !(pawnAttacks(~us, ep) & pos.getPieces(us, PieceType::Pawn)))
+      valid = false;
+    pos.setEpSquare(ep);
+  } else if (ep > 64)
+    valid = false;
+
+  pos.setClocks(bytes[26], bytes[27] | bytes[28] << 8);
+  return valid && pos.isValid();
+}
+
+void writePackedRecord(const PackedRecord &record, uint8_t *out) {
+  std::memcpy(out, record.position.bytes, sizeof(record.position.bytes));
+  uint16_t score = record.score;
+  out[32] = score;
+  out[33] = score >> 8;
+  out[34] = record.result;
+  out[35] = 0;
+}
+
+bool PackedReader::open(const std::string &path) {
+  records = 0;
+  if (!file.open(path) || file.size() % PackedRecordSize) {
+    file.close();
+    return false;
+  }
+  records = file.size() / PackedRecordSize;
+  return true;
+}
+
+PackedFile::~PackedFile() { close(); }
+
+bool PackedFile::open(const std::string &path, bool append) {
+  close();
+  fd = ::open(path.c_str(), O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC),
+              0644);
+  if (fd < 0)
+    return false;
+
+  // Appending starts after the last whole record
+  off_t size = append ? lseek(fd, 0, SEEK_END) : 0;
+  end = size < 0 ? 0 : size - size % PackedRecordSize;
+  return true;
+}
+
+bool PackedFile::close() {
+  if (fd < 0)
+    return true;
+  bool closed = ::close(fd) == 0;
+  fd = -1;
+  return closed;
+}
+
+bool PackedFile::append(const uint8_t *data, size_t size) {
+  uint64_t offset = end.fetch_add(size);
+  while (size) {
+    ssize_t written = pwrite(fd, data, size, offset);
+    if (written <= 0)
+      return false;
+    data += written;
+    offset += written;
+    size -= written;
+  }
+  return true;
+}
+
+PackedWriter::PackedWriter(PackedFile &file, size_t bufferRecords)
+    : file(file),
+      buffer(std::max<size_t>(bufferRecords, 1) * PackedRecordSize) {}
+
+PackedWriter::~PackedWriter() { flush(); }
+
+bool PackedWriter::write(const PackedRecord &record) {
+  if (used == buffer.size() && !flush())
+    return false;
+  writePackedRecord(record, buffer.data() + used);
+  used += PackedRecordSize;
+  return true;
+}
+
+bool PackedWriter::flush() {
+  bool written = used == 0 || file.append(buffer.data(), used);
+  used = 0;
+  return written;
+}
@@ -0,0 +1,222 @@
+#include "Pgn.h"
+#include <cctype>
+
+namespace {
+
+bool isResult(std::string_view token) {
+  return token == "1-0" || token == "0-1" || token == "1/2-1/2" ||
+         token == "*";
+}
+
+PieceType pieceFromLetter(char c) {
+  switch (c) {
+  case 'N':
+    return PieceType::Knight;
+  case 'B':
+    return PieceType::Bishop;
+  case 'R':
+    return PieceType::Rook;
+  case 'Q':
+    return PieceType::Queen;
+  case 'K':
+    return PieceType::King;
+  default:
+    return PieceType::Pawn;
+  }
+}
+
+} // namespace
+
+std::string_view PgnGame::getTag(std::string_view name) const {
+  for (const auto &[tag, value] : tags)
+    if (tag == name)
+      return value;
+  return {};
+}
+
+bool PgnParser::next(PgnGame &game) {
+  game.tags.clear();
+  game.moves.clear();
+  game.result = {};
+
+  auto isSpace = [](char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  };
+  auto skipLine = [&] {
+    size_t end = input.find('\n', offset);
+    offset = end == std::string_view::npos ? input.size() : end + 1;
+  };
+
+  // Whitespace and escape lines between games
+  while (offset < input.size()) {
+    if (isSpace(input[offset]))
+      offset++;
+    else if (input[offset] == '%' && (offset == 0 || input[offset - 1] == '\n'))
+      skipLine();
+    else
+      break;
+  }
+  if (offset >= input.size())
+    return false;
+
+  size_t start = offset;
+  int variationDepth = 0;
+  bool inMoves = false;
+
+  while (offset < input.size()) {
+    char c = input[offset];
+    bool lineStart = offset == 0 || input[offset - 1] == '\n';
+
+    if (lineStart && c == '%') {
+      skipLine();
+    } else if (lineStart && c == '[' && variationDepth == 0) {
+      // A tag after movetext without a result starts the next game
+      if (inMoves)
+        break;
+      size_t nameEnd = input.find_first_of(" \t]", offset);
+      size_t open = input.find('"', offset);
+      size_t close = open;
+      while (close != std::string_view::npos) {
+        close = input.find('"', close + 1);
+        if (close == std::string_view::npos || input[close - 1] != '\\')
+          break;
+      }
+      size_t lineEnd = input.find('\n', offset);
+      if (nameEnd != std::string_view::npos &&
+          close != std::string_view::npos && close < lineEnd)
+        game.tags.push_back({input.substr(offset + 1, nameEnd - offset - 1),
+                             input.substr(open + 1, close - open - 1)});
+      skipLine();
+    } else if (c == '{') {
+      size_t end = input.find('}', offset);
+      offset = end == std::string_view::npos ? input.size() : end + 1;
+    } else if (c == ';') {
+      skipLine();
+    } else if (c == '(') {
+      variationDepth++;
+      offset++;
+    } else if (c == ')') {
+      variationDepth -= variationDepth > 0;
+      offset++;
+    } else if (isSpace(c)) {
+      offset++;
+    } else {
+      size_t end = offset;
+      while (end < input.size() && !isSpace(input[end]) &&
+             input[end] != '{' && input[end] != '(' && input[end] != ')' &&
+             input[end] != ';')
+        end++;
+      std::string_view token = input.substr(offset, end - offset);
+      offset = end;
+      if (variationDepth)
+        continue;
+
+      inMoves = true;
+      if (isResult(token)) {
+        game.result = token;
+        break;
+      }
+      if (token[0] == '$')
+        continue;
+      // Move numbers, alone or glued to the move ("12." or "12...Nf6")
+      size_t digits = 0;
+      while (digits < token.size() &&
+             std::isdigit(static_cast<unsigned char>(token[digits])))
+        digits++;
+      if (digits < token.size() && token[digits] == '.') {
+        token.remove_prefix(digits);
+        while (!token.empty() && token.front() == '.')
+          token.remove_prefix(1);
+      }
+      if (!token.empty())
+        game.moves.push_back(token);
+    }
+  }
+
+  if (game.result.empty())
+    game.result = "*";
+  game.text = input.substr(start, offset - start);
+  return true;
+}
+
+Move parseSan(const Position &pos, std::string_view san) {
+  while (!san.empty() && (san.back() == '+' || san.back() == '#' ||
+                          san.back() == '!' || san.back() == '?'))
+    san.remove_suffix(1);
+  if (san.size() < 2)
+    return Move();
+
+  MoveList moves;
+  pos.generateLegalMoves(moves);
+
+  if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+    bool kingSide = san.size() == 3;
+    for (Move m : moves)
+      if (m.getFlag() == MoveFlag::Castling &&
+          (m.getTo() > m.getFrom()) == kingSide)
+        return m;
+    return Move();
+  }
+
+  PieceType type = pieceFromLetter(san[0]);
+  if (type != PieceType::Pawn)
+    san.remove_prefix(1);
+
+  // Promotion, written "e8=Q" or "e8Q"
+  PieceType promotion = PieceType::Pawn;
+  if (std::isupper(static_cast<unsigned char>(san.back()))) {
+    promotion = pieceFromLetter(san.back());
+    san.remove_suffix(1);
+    if (!san.empty() && san.back() == '=')
+      san.remove_suffix(1);
+  }
+  if (san.size() < 2)
+    return Move();
+
+  int toFile = san[san.size() - 2] - 'a', toRank = san[san.size() - 1] - '1';
+  if (toFile < 0 || toFile > 7 || toRank < 0 || toRank > 7)
+    return Move();
+  int to = makeSquare(toFile, toRank);
+  san.remove_suffix(2);
+
+  // Whatever is left is disambiguation, possibly with a capture mark
+  int fromFile = -1, fromRank = -1;
+  for (char c : san) {
+    if (c >= 'a' && c <= 'h')
+      fromFile = c - 'a';
+    else if (c >= '1' && c <= '8')
+      fromRank = c - '1';
+  }
+
+  for (Move m : moves) {
+    int from = m.getFrom();
+    if (m.getTo() != to || typeOf(pos.getPieceOn(from)) != type ||
+        m.getFlag() == MoveFlag::Castling ||
+        (fromFile >= 0 && fileOf(from) != fromFile) ||
+        (fromRank >= 0 && rankOf(from) != fromRank))
+      continue;
+    bool promotes = m.getFlag() == MoveFlag::Promotion;
+    if (promotes != (promotion != PieceType::Pawn) ||
+        (promotes && m.getPromotion() != promotion))
+      continue;
+    return m;
+  }
+  return Move();
+}
+
+bool replayGame(const PgnGame &game, Position &pos,
+                std::vector<Move> &moves) {
+  pos.setStartPos();
+  moves.clear();
+  if (!game.getTag("FEN").empty())
+    return false;
+
+  for (std::string_view san : game.moves) {
+    Move m = parseSan(pos, san);
+    if (m.isNull())
+      return false;
+    pos.makeMove(m);
+    moves.push_back(m);
+  }
+  return true;
+}
@@ -0,0 +1,116 @@
+#include "PgnPipeline.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// The start of the first game beginning at or after offset: a tag line that
+// does not follow another tag line
+size_t gameStart(std::string_view text, size_t offset) {
+  while (offset < text.size()) {
+    size_t tag = text.find("\n[", offset);
+    if (tag == std::string_view::npos)
+      return text.size();
+    if (tag == 0)
+      return 1;
+    size_t lineStart = text.rfind('\n', tag - 1);
+    lineStart = lineStart == std::string_view::npos ? 0 : lineStart + 1;
+    if (text[lineStart] != '[')
+      return tag + 1;
+    offset = tag + 1;
+  }
+  return text.size();
+}
+
+} // namespace
+
+PgnPipeline::PgnPipeline(std::string_view text, unsigned threads,
+                         size_t chunkBytes, size_t capacity)
+    : text(text) {
+  threads = std::max(1u, threads);
+  chunkBytes = std::max<size_t>(chunkBytes, 1);
+
+  boundaries.push_back(0);
+  while (boundaries.back() < text.size())
+    boundaries.push_back(
+        gameStart(text, std::min(boundaries.back() + chunkBytes, text.size())));
+  if (boundaries.size() == 1)
+    boundaries.push_back(0);
+
+  slots.resize(capacity ? capacity : 2 * threads);
+  for (unsigned t = 0; t < threads; t++)
+    workers.emplace_back(&PgnPipeline::work, this);
+}
+
+PgnPipeline::~PgnPipeline() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  slotFree.notify_all();
+  for (std::thread &worker : workers)
+    worker.join();
+}
+
+void PgnPipeline::work() {
+  PgnChunk chunk;
+  while (true) {
+    size_t index;
+    {
+      std::unique_lock lock(mutex);
+      if (stopping || claimed == getChunks())
+        return;
+      index = claimed++;
+      // Wait for the reader to free this chunk's slot
+      slotFree.wait(lock, [&] {
+        return stopping || index < delivered + slots.size();
+      });
+      if (stopping)
+        return;
+    }
+
+    importChunk(index, chunk);
+
+    {
+      std::lock_guard lock(mutex);
+      Slot &slot = slots[index % slots.size()];
+      std::swap(slot.chunk, chunk);
+      slot.ready = true;
+    }
+    chunkReady.notify_all();
+  }
+}
+
+void PgnPipeline::importChunk(size_t index, PgnChunk &chunk) const {
+  chunk.index = index;
+  size_t begin = boundaries[index], end = boundaries[index + 1];
+  PgnParser parser(text.substr(begin, end - begin));
+  Position pos;
+  size_t count = 0;
+  while (true) {
+    if (count == chunk.games.size())
+      chunk.games.emplace_back();
+    ImportedGame &imported = chunk.games[count];
+    if (!parser.next(imported.game))
+      break;
+    imported.legal = replayGame(imported.game, pos, imported.moves);
+    count++;
+  }
+  chunk.games.resize(count);
+}
+
+bool PgnPipeline::next(PgnChunk &chunk) {
+  Slot *slot;
+  {
+    std::unique_lock lock(mutex);
+    if (delivered == getChunks())
+      return false;
+    slot = &slots[delivered % slots.size()];
+    chunkReady.wait(lock, [&] { return slot->ready; });
+    std::swap(slot->chunk, chunk);
+    slot->ready = false;
+    delivered++;
+  }
+  slotFree.notify_all();
+  return true;
+}
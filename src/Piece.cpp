@@ -1,24 +1,11 @@
-// clang-format off
-#include "Shader.h"
-#include "GLFW/glfw3.h"
-// clang-format on
-
 #include "Piece.h"
 #include "Board.h"
-#include "SpriteSheet.h"
 #include <algorithm>
 #include <cstdint>
-#include <glm/gtc/matrix_transform.hpp>
 #include <print>
-#include <tuple>
-
-#define SQUARE_SIZE 100
 
-Piece::Piece(glm::ivec2 pos, bool white, PieceType type, SpriteSheet &sheet)
-    : boardPos(pos), isWhite(white), type(type) {
-  std::tie(u0, v0, u1, v1) = sheet.getUV(static_cast<int>(type));
-  this->sheet = &sheet;
-}
+Piece::Piece(glm::ivec2 pos, bool white, PieceType type)
+    : boardPos(pos), isWhite(white), type(type) {}
 
 bool Piece::checkifWhite() { return isWhite; }
 
@@ -28,8 +15,6 @@ void Piece::setBoardPos(const glm::ivec2 to) { boardPos = to; }
 
 PieceType Piece::getType() { return type; }
 
-SpriteSheet *Piece::getSheet() const { return sheet; }
-
 int Pawn::promotion() {
   int promotionType;
   std::println("Promotion to what?");
@@ -92,44 +77,6 @@ std::vector<glm::ivec2> Pawn::getValidMoves(Board &board) {
   return potentialMoves;
 }
 
-void Pawn::render(SpriteSheet &sheet, Shader &shader) {
-  // Calculate screen space coordinates
-  // float screenX = boardPos.x * SQUARE_SIZE;
-  // float screenY = (7 - boardPos.y) * SQUARE_SIZE;
-  float screenX, screenY;
-
-  if (animation.isAnimating) {
-    float t = glm::clamp((float)(glfwGetTime() - animation.startTime) / 0.3f,
-                         0.0f, 1.0f);
-    glm::vec2 interpolated =
-        glm::mix(animation.startPos, animation.targetPos, t);
-    screenX = interpolated.x;
-    screenY = interpolated.y;
-
-    if (t >= 1.0)
-      animation.isAnimating = false;
-  } else {
-    screenX = boardPos.x * SQUARE_SIZE;
-    screenY = (7 - boardPos.y) * SQUARE_SIZE;
-  }
-
-  // Now to place the pieces in the correct world coordinates, we need a model
-  // matrix for translation and scaling (because pixels)
-  glm::mat4 model = glm::translate(
-      glm::mat4(1.0f), glm::vec3(screenX + (SQUARE_SIZE / 4.0f),
-                                 screenY + (SQUARE_SIZE / 8.0f), 0.1f));
-  model = glm::scale(model, glm::vec3(SQUARE_SIZE / 2, SQUARE_SIZE / 2, 1.0f));
-
-  shader.use();
-  shader.setMat4("uModel", model);
-  shader.setVec2("uUV0", u0, v0);
-  shader.setVec2("uUV1", u1, v1);
-
-  sheet.bind();
-  sheet.bindQuadVAO();
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-}
-
 void Pawn::firstMoveFalse() { firstMove = false; }
 
 std::vector<glm::ivec2> Rook::getValidMoves(Board &board) {
@@ -228,43 +175,6 @@ std::vector<glm::ivec2> Rook::getValidMoves(Board &board) {
   return potentialMoves;
 }
 
-void Rook::render(SpriteSheet &sheet, Shader &shader) {
-  // Calculate screen space coordinates
-  float screenX = boardPos.x * SQUARE_SIZE;
-  float screenY = (7 - boardPos.y) * SQUARE_SIZE;
-
-  if (animation.isAnimating) {
-    float t = glm::clamp((float)(glfwGetTime() - animation.startTime) / 0.3f,
-                         0.0f, 1.0f);
-    glm::vec2 interpolated =
-        glm::mix(animation.startPos, animation.targetPos, t);
-    screenX = interpolated.x;
-    screenY = interpolated.y;
-
-    if (t >= 1.0)
-      animation.isAnimating = false;
-  } else {
-    screenX = boardPos.x * SQUARE_SIZE;
-    screenY = (7 - boardPos.y) * SQUARE_SIZE;
-  }
-
-  // Now to place the pieces in the correct world coordinates, we need a model
-  // matrix for translation and scaling (because pixels)
-  glm::mat4 model = glm::translate(
-      glm::mat4(1.0f), glm::vec3(screenX + (SQUARE_SIZE / 4.0f),
-                                 screenY + (SQUARE_SIZE / 8.0f), 0.1f));
-  model = glm::scale(model, glm::vec3(SQUARE_SIZE / 2, SQUARE_SIZE / 2, 1.0f));
-
-  shader.use();
-  shader.setMat4("uModel", model);
-  shader.setVec2("uUV0", u0, v0);
-  shader.setVec2("uUV1", u1, v1);
-
-  sheet.bind();
-  sheet.bindQuadVAO();
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-}
-
 std::vector<glm::ivec2> Bishop::getValidMoves(Board &board) {
   std::vector<glm::ivec2> potentialMoves;
 
@@ -373,43 +283,6 @@ std::vector<glm::ivec2> Bishop::getValidMoves(Board &board) {
   return potentialMoves;
 }
 
-void Bishop::render(SpriteSheet &sheet, Shader &shader) {
-  // Calculate screen space coordinates
-  float screenX = boardPos.x * SQUARE_SIZE;
-  float screenY = (7 - boardPos.y) * SQUARE_SIZE;
-
-  if (animation.isAnimating) {
-    float t = glm::clamp((float)(glfwGetTime() - animation.startTime) / 0.3f,
-                         0.0f, 1.0f);
-    glm::vec2 interpolated =
-        glm::mix(animation.startPos, animation.targetPos, t);
-    screenX = interpolated.x;
-    screenY = interpolated.y;
-
-    if (t >= 1.0)
-      animation.isAnimating = false;
-  } else {
-    screenX = boardPos.x * SQUARE_SIZE;
-    screenY = (7 - boardPos.y) * SQUARE_SIZE;
-  }
-
-  // Now to place the pieces in the correct world coordinates, we need a model
-  // matrix for translation and scaling (because pixels)
-  glm::mat4 model = glm::translate(
-      glm::mat4(1.0f), glm::vec3(screenX + (SQUARE_SIZE / 4.0f),
-                                 screenY + (SQUARE_SIZE / 8.0f), 0.1f));
-  model = glm::scale(model, glm::vec3(SQUARE_SIZE / 2, SQUARE_SIZE / 2, 1.0f));
-
-  shader.use();
-  shader.setMat4("uModel", model);
-  shader.setVec2("uUV0", u0, v0);
-  shader.setVec2("uUV1", u1, v1);
-
-  sheet.bind();
-  sheet.bindQuadVAO();
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-}
-
 std::vector<glm::ivec2> Knight::getValidMoves(Board &board) {
   std::vector<glm::ivec2> potentialMoves;
 
@@ -478,43 +351,6 @@ std::vector<glm::ivec2> Knight::getValidMoves(Board &board) {
   return potentialMoves;
 }
 
-void Knight::render(SpriteSheet &sheet, Shader &shader) {
-  // Calculate screen space coordinates
-  float screenX = boardPos.x * SQUARE_SIZE;
-  float screenY = (7 - boardPos.y) * SQUARE_SIZE;
-
-  if (animation.isAnimating) {
-    float t = glm::clamp((float)(glfwGetTime() - animation.startTime) / 0.3f,
-                         0.0f, 1.0f);
-    glm::vec2 interpolated =
-        glm::mix(animation.startPos, animation.targetPos, t);
-    screenX = interpolated.x;
-    screenY = interpolated.y;
-
-    if (t >= 1.0)
-      animation.isAnimating = false;
-  } else {
-    screenX = boardPos.x * SQUARE_SIZE;
-    screenY = (7 - boardPos.y) * SQUARE_SIZE;
-  }
-
-  // Now to place the pieces in the correct world coordinates, we need a model
-  // matrix for translation and scaling (because pixels)
-  glm::mat4 model = glm::translate(
-      glm::mat4(1.0f), glm::vec3(screenX + (SQUARE_SIZE / 4.0f),
-                                 screenY + (SQUARE_SIZE / 8.0f), 0.1f));
-  model = glm::scale(model, glm::vec3(SQUARE_SIZE / 2, SQUARE_SIZE / 2, 1.0f));
-
-  shader.use();
-  shader.setMat4("uModel", model);
-  shader.setVec2("uUV0", u0, v0);
-  shader.setVec2("uUV1", u1, v1);
-
-  sheet.bind();
-  sheet.bindQuadVAO();
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-}
-
 std::vector<glm::ivec2> Queen::getValidMoves(Board &board) {
   std::vector<glm::ivec2> potentialMoves;
 
@@ -705,43 +541,6 @@ std::vector<glm::ivec2> Queen::getValidMoves(Board &board) {
   return potentialMoves;
 }
 
-void Queen::render(SpriteSheet &sheet, Shader &shader) {
-  // Calculate screen space coordinates
-  float screenX = boardPos.x * SQUARE_SIZE;
-  float screenY = (7 - boardPos.y) * SQUARE_SIZE;
-
-  if (animation.isAnimating) {
-    float t = glm::clamp((float)(glfwGetTime() - animation.startTime) / 0.3f,
-                         0.0f, 1.0f);
-    glm::vec2 interpolated =
-        glm::mix(animation.startPos, animation.targetPos, t);
-    screenX = interpolated.x;
-    screenY = interpolated.y;
-
-    if (t >= 1.0)
-      animation.isAnimating = false;
-  } else {
-    screenX = boardPos.x * SQUARE_SIZE;
-    screenY = (7 - boardPos.y) * SQUARE_SIZE;
-  }
-
-  // Now to place the pieces in the correct world coordinates, we need a model
-  // matrix for translation and scaling (because pixels)
-  glm::mat4 model = glm::translate(
-      glm::mat4(1.0f), glm::vec3(screenX + (SQUARE_SIZE / 4.0f),
-                                 screenY + (SQUARE_SIZE / 8.0f), 0.1f));
-  model = glm::scale(model, glm::vec3(SQUARE_SIZE / 2, SQUARE_SIZE / 2, 1.0f));
-
-  shader.use();
-  shader.setMat4("uModel", model);
-  shader.setVec2("uUV0", u0, v0);
-  shader.setVec2("uUV1", u1, v1);
-
-  sheet.bind();
-  sheet.bindQuadVAO();
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-}
-
 std::vector<glm::ivec2> King::getValidMoves(Board &board) {
   std::vector<glm::ivec2> potentialMoves{
       boardPos + glm::ivec2{0, -1},  // 1 forward
@@ -781,39 +580,3 @@ std::vector<glm::ivec2> King::getValidMoves(Board &board) {
   return potentialMoves;
 }
 
-void King::render(SpriteSheet &sheet, Shader &shader) {
-  // Calculate screen space coordinates
-  float screenX = boardPos.x * SQUARE_SIZE;
-  float screenY = (7 - boardPos.y) * SQUARE_SIZE;
-
-  if (animation.isAnimating) {
-    float t = glm::clamp((float)(glfwGetTime() - animation.startTime) / 0.3f,
-                         0.0f, 1.0f);
-    glm::vec2 interpolated =
-        glm::mix(animation.startPos, animation.targetPos, t);
-    screenX = interpolated.x;
-    screenY = interpolated.y;
-
-    if (t >= 1.0)
-      animation.isAnimating = false;
-  } else {
-    screenX = boardPos.x * SQUARE_SIZE;
-    screenY = (7 - boardPos.y) * SQUARE_SIZE;
-  }
-
-  // Now to place the pieces in the correct world coordinates, we need a model
-  // matrix for translation and scaling (because pixels)
-  glm::mat4 model = glm::translate(
-      glm::mat4(1.0f), glm::vec3(screenX + (SQUARE_SIZE / 4.0f),
-                                 screenY + (SQUARE_SIZE / 8.0f), 0.1f));
-  model = glm::scale(model, glm::vec3(SQUARE_SIZE / 2, SQUARE_SIZE / 2, 1.0f));
-
-  shader.use();
-  shader.setMat4("uModel", model);
-  shader.setVec2("uUV0", u0, v0);
-  shader.setVec2("uUV1", u1, v1);
-
-  sheet.bind();
-  sheet.bindQuadVAO();
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-}
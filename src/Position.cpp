@@ -0,0 +1,600 @@
+#include "Position.h"
+#include <algorithm>
+#include <charconv>
+
+namespace {
+
+constexpr uint64_t splitMix(uint64_t &state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+struct ZobristKeys {
+  uint64_t pieceSquare[12][64];
+  uint64_t castling[16];
+  uint64_t epFile[8];
+  uint64_t side;
+};
+
+constexpr ZobristKeys zobrist = [] {
+  ZobristKeys keys{};
+  uint64_t state = 0x43484553534B4559ULL;
+  for (auto &piece : keys.pieceSquare)
+    for (uint64_t &k : piece)
+      k = splitMix(state);
+  for (uint64_t &k : keys.castling)
+    k = splitMix(state);
+  for (uint64_t &k : keys.epFile)
+    k = splitMix(state);
+  keys.side = splitMix(state);
+  return keys;
+}();
+
+// Rights that survive a move touching each square
+constexpr auto castlingMask = [] {
+  std::array<uint8_t, 64> mask{};
+  mask.fill(0xF);
+  mask[makeSquare(4, 0)] &= ~(WhiteKingSide | WhiteQueenSide);
+  mask[makeSquare(7, 0)] &= ~WhiteKingSide;
+  mask[makeSquare(0, 0)] &= ~WhiteQueenSide;
+  mask[makeSquare(4, 7)] &= ~(BlackKingSide | BlackQueenSide);
+  mask[makeSquare(7, 7)] &= ~BlackKingSide;
+  mask[makeSquare(0, 7)] &= ~BlackQueenSide;
+  return mask;
+}();
+
+// FEN letters by piece code
+constexpr char pieceLetters[] = "PNRBQKpnrbqk";
+constexpr char castlingLetters[] = "KQkq";
+
+constexpr PieceType promotionTypes[] = {PieceType::Queen, PieceType::Knight,
+                                        PieceType::Rook, PieceType::Bishop};
+
+} // namespace
+
+Position::Position() { clear(); }
+
+void Position::clear() {
+  pieceBB.fill(0);
+  colorBB.fill(0);
+  board.fill(NoPiece);
+  sideToMove = White;
+  castlingRights = 0;
+  epSquare = NoSquare;
+  halfmoveClock = 0;
+  fullmoveNumber = 1;
+  key = zobrist.castling[0];
+  materialKey = 0;
+  history.clear();
+}
+
+void Position::setStartPos() {
+  clear();
+
+  constexpr PieceType backRank[] = {
+      PieceType::Rook,  PieceType::Knight, PieceType::Bishop, PieceType::Queen,
+      PieceType::King,  PieceType::Bishop, PieceType::Knight, PieceType::Rook};
+
+  for (int file = 0; file < 8; file++) {
+    putPiece(White, backRank[file], makeSquare(file, 0));
+    putPiece(White, PieceType::Pawn, makeSquare(file, 1));
+    putPiece(Black, PieceType::Pawn, makeSquare(file, 6));
+    putPiece(Black, backRank[file], makeSquare(file, 7));
+  }
+
+  setCastlingRights(WhiteKingSide | WhiteQueenSide | BlackKingSide |
+                    BlackQueenSide);
+}
+
+void Position::putPiece(Color c, PieceType type, int square) {
+  int piece = makePiece(c, type);
+  board[square] = piece;
+  pieceBB[piece] |= squareBB(square);
+  colorBB[c] |= squareBB(square);
+  key ^= zobrist.pieceSquare[piece][square];
+  materialKey += uint64_t{1} << (4 * piece);
+}
+
+void Position::removePiece(int square) {
+  int piece = board[square];
+  board[square] = NoPiece;
+  pieceBB[piece] ^= squareBB(square);
+  colorBB[colorOf(piece)] ^= squareBB(square);
+  key ^= zobrist.pieceSquare[piece][square];
+  materialKey -= uint64_t{1} << (4 * piece);
+}
+
+void Position::movePieceTo(int from, int to) {
+  int piece = board[from];
+  Bitboard fromTo = squareBB(from) | squareBB(to);
+  board[from] = NoPiece;
+  board[to] = piece;
+  pieceBB[piece] ^= fromTo;
+  colorBB[colorOf(piece)] ^= fromTo;
+  key ^= zobrist.pieceSquare[piece][from] ^ zobrist.pieceSquare[piece][to];
+}
+
+void Position::setSideToMove(Color c) {
+  if (c != sideToMove)
+    key ^= zobrist.side;
+  sideToMove = c;
+}
+
+void Position::setCastlingRights(uint8_t rights) {
+  key ^= zobrist.castling[castlingRights] ^ zobrist.castling[rights];
+  castlingRights = rights;
+}
+
+void Position::setEpSquare(int square) {
+  if (epSquare != NoSquare)
+    key ^= zobrist.epFile[fileOf(epSquare)];
+  epSquare = square;
+  if (epSquare != NoSquare)
+    key ^= zobrist.epFile[fileOf(epSquare)];
+}
+
+void Position::setClocks(int halfmove, int fullmove) {
+  halfmoveClock = halfmove;
+  fullmoveNumber = fullmove;
+}
+
+bool Position::setFen(std::string_view fen) {
+  clear();
+
+  size_t i = 0;
+  auto nextField = [&] {
+    while (i < fen.size() && (fen[i] == ' ' || fen[i] == '\t'))
+      i++;
+    size_t start = i;
+    while (i < fen.size() && fen[i] != ' ' && fen[i] != '\t')
+      i++;
+    return fen.substr(start, i - start);
+  };
+  auto fail = [&] {
+    clear();
+    return false;
+  };
+
+  int file = 0, rank = 7;
+  for (char c : nextField()) {
+    if (c == '/') {
+      if (file != 8 || rank == 0)
+        return fail();
+      file = 0;
+      rank--;
+    } else if (c >= '1' && c <= '8') {
+      file += c - '0';
+      if (file > 8)
+        return fail();
+    } else {
+      const char *letter = std::char_traits<char>::find(pieceLetters, 12, c);
+      if (!letter || file > 7)
+        return fail();
+      int piece = letter - pieceLetters;
+      putPiece(colorOf(piece), typeOf(piece), makeSquare(file++, rank));
+    }
+  }
+  if (file != 8 || rank != 0)
+    return fail();
+
+  std::string_view side = nextField();
+  if (side != "w" && side != "b")
+    return fail();
+  setSideToMove(side == "w" ? White : Black);
+
+  std::string_view castling = nextField();
+  uint8_t rights = 0;
+  for (char c : castling) {
+    const char *letter = std::char_traits<char>::find(castlingLetters, 4, c);
+    if (letter)
+      rights |= 1 << (letter - castlingLetters);
+    else if (c != '-')
+      return fail();
+  }
+  // Only rights whose king and rook are still at home
+  for (int right = 0; right < 4; right++) {
+    Color c = right < 2 ? White : Black;
+    int rank = c == White ? 0 : 7;
+    int rook = makeSquare(right % 2 == 0 ? 7 : 0, rank);
+    if (board[makeSquare(4, rank)] != makePiece(c, PieceType::King) ||
+        board[rook] != makePiece(c, PieceType::Rook))
+      rights &= ~(1 << right);
+  }
+  setCastlingRights(rights);
+
+  std::string_view ep = nextField();
+  if (ep.size() == 2 && ep[0] >= 'a' && ep[0] <= 'h' &&
+      (ep[1] == '3' || ep[1] == '6')) {
+    // Kept only behind a pawn of the other side that has just moved two
+    // squares, on the rank it crossed, and with a pawn of ours to take it
+    int square = makeSquare(ep[0] - 'a', ep[1] - '1');
+    int pushed = sideToMove == White ? square - 8 : square + 8;
+    if (rankOf(square) == (sideToMove == White ? 5 : 2) &&
+        board[square] == NoPiece &&
+        board[pushed] == makePiece(~sideToMove, PieceType::Pawn) &&
+        (pawnAttacks(~sideToMove, square) &
+         getPieces(sideToMove, PieceType::Pawn)))
+      setEpSquare(square);
+  } else if (ep != "-")
+    return fail();
+
+  // Optional clocks; an EPD record has operations here instead
+  int clocks[2] = {0, 1};
+  for (int &clock : clocks) {
+    size_t save = i;
+    std::string_view field = nextField();
+    auto [end, error] =
+        std::from_chars(field.data(), field.data() + field.size(), clock);
+    if (field.empty() || error != std::errc() ||
+        end != field.data() + field.size()) {
+      i = save;
+      break;
+    }
+  }
+  setClocks(clocks[0], std::max(clocks[1], 1));
+
+  if (!isValid())
+    return fail();
+  return true;
+}
+
+bool Position::isValid() const {
+  return popCount(getPieces(White, PieceType::King)) == 1 &&
+         popCount(getPieces(Black, PieceType::King)) == 1 &&
+         !(getPieces(PieceType::Pawn) & (Rank1 | Rank8)) &&
+         !isSquareAttacked(getKingSquare(~sideToMove), sideToMove);
+}
+
+size_t Position::writeFen(char *out) const {
+  char *p = out;
+
+  for (int rank = 7; rank >= 0; rank--) {
+    int empty = 0;
+    for (int file = 0; file < 8; file++) {
+      int piece = board[makeSquare(file, rank)];
+      if (piece == NoPiece) {
+        empty++;
+        continue;
+      }
+      if (empty)
+        *p++ = '0' + empty;
+      empty = 0;
+      *p++ = pieceLetters[piece];
+    }
+    if (empty)
+      *p++ = '0' + empty;
+    if (rank)
+      *p++ = '/';
+  }
+
+  *p++ = ' ';
+  *p++ = sideToMove == White ? 'w' : 'b';
+
+  *p++ = ' ';
+  if (!castlingRights)
+    *p++ = '-';
+  for (int right = 0; right < 4; right++)
+    if (castlingRights & (1 << right))
+      *p++ = castlingLetters[right];
+
+  *p++ = ' ';
+  if (epSquare == NoSquare)
+    *p++ = '-';
+  else {
+    *p++ = 'a' + fileOf(epSquare);
+    *p++ = '1' + rankOf(epSquare);
+  }
+
+  *p++ = ' ';
+  p = std::to_chars(p, out + MaxFenLength, halfmoveClock).ptr;
+  *p++ = ' ';
+  p = std::to_chars(p, out + MaxFenLength, fullmoveNumber).ptr;
+  return p - out;
+}
+
+std::string Position::getFen() const {
+  char buffer[MaxFenLength];
+  return std::string(buffer, writeFen(buffer));
+}
+
+Bitboard Position::attackersTo(int square, Bitboard occupied) const {
+  Bitboard diagonal =
+      getPieces(PieceType::Bishop) | getPieces(PieceType::Queen);
+  Bitboard straight = getPieces(PieceType::Rook) | getPieces(PieceType::Queen);
+
+  return (pawnAttacks(Black, square) & getPieces(White, PieceType::Pawn)) |
+         (pawnAttacks(White, square) & getPieces(Black, PieceType::Pawn)) |
+         (knightAttacks(square) & getPieces(PieceType::Knight)) |
+         (kingAttacks(square) & getPieces(PieceType::King)) |
+         (bishopAttacks(square, occupied) & diagonal) |
+         (rookAttacks(square, occupied) & straight);
+}
+
+bool Position::isSquareAttacked(int square, Color by) const {
+  return attackersTo(square, getOccupied()) & colorBB[by];
+}
+
+bool Position::inCheck() const {
+  return isSquareAttacked(getKingSquare(sideToMove), ~sideToMove);
+}
+
+bool Position::isCapture(Move m) const {
+  return board[m.getTo()] != NoPiece || m.getFlag() == MoveFlag::EnPassant;
+}
+
+// Pseudo-legal moves are filtered here by replaying the occupancy change and
+// asking whether anything still attacks our king, which covers pins, checks
+// and en passant discoveries alike.
+bool Position::isLegal(Move m) const {
+  Color us = sideToMove;
+  int from = m.getFrom(), to = m.getTo();
+
+  if (m.getFlag() == MoveFlag::Castling)
+    return true; // Path and destination already checked while generating
+
+  if (typeOf(board[from]) == PieceType::King)
+    return !(attackersTo(to, getOccupied() ^ squareBB(from)) & colorBB[~us]);
+
+  Bitboard occupied = (getOccupied() ^ squareBB(from)) | squareBB(to);
+  Bitboard captured = squareBB(to);
+  if (m.getFlag() == MoveFlag::EnPassant) {
+    captured = squareBB(to ^ 8);
+    occupied ^= captured;
+  }
+
+  return !(attackersTo(getKingSquare(us), occupied) & colorBB[~us] &
+           ~captured);
+}
+
+template <bool CapturesOnly>
+void Position::generate(MoveList &list) const {
+  MoveList pseudo;
+  Color us = sideToMove, them = ~us;
+  Bitboard occupied = getOccupied();
+  Bitboard targets = CapturesOnly ? colorBB[them] : ~colorBB[us];
+
+  // Pawns
+  int up = us == White ? 8 : -8;
+  Bitboard promotionRank = us == White ? Rank8 : Rank1;
+  Bitboard pawns = getPieces(us, PieceType::Pawn);
+  while (pawns) {
+    int from = popLsb(pawns);
+    Bitboard moves = pawnAttacks(us, from) & colorBB[them];
+    int forward = from + up;
+
+    if (!(occupied & squareBB(forward))) {
+      if (!CapturesOnly || (squareBB(forward) & promotionRank))
+        moves |= squareBB(forward);
+
+      int startRank = us == White ? 1 : 6;
+      if (!CapturesOnly && rankOf(from) == startRank &&
+          !(occupied & squareBB(forward + up)))
+        moves |= squareBB(forward + up);
+    }
+
+    while (moves) {
+      int to = popLsb(moves);
+      if (squareBB(to) & promotionRank) {
+        for (PieceType promotion : promotionTypes) {
+          if (CapturesOnly && promotion != PieceType::Queen &&
+              board[to] == NoPiece)
+            continue;
+          pseudo.add(Move(from, to, MoveFlag::Promotion, promotion));
+        }
+      } else
+        pseudo.add(Move(from, to));
+    }
+
+    if (epSquare != NoSquare && (pawnAttacks(us, from) & squareBB(epSquare)))
+      pseudo.add(Move(from, epSquare, MoveFlag::EnPassant));
+  }
+
+  // Pieces
+  for (PieceType type : {PieceType::Knight, PieceType::Bishop, PieceType::Rook,
+                         PieceType::Queen, PieceType::King}) {
+    Bitboard pieces = getPieces(us, type);
+    while (pieces) {
+      int from = popLsb(pieces);
+      Bitboard moves = pieceAttacks(type, from, occupied) & targets;
+      while (moves)
+        pseudo.add(Move(from, popLsb(moves)));
+    }
+  }
+
+  // Castling
+  if (!CapturesOnly && castlingRights && !inCheck()) {
+    int rank = us == White ? 0 : 7;
+    int kingFrom = makeSquare(4, rank);
+    uint8_t kingSide = us == White ? WhiteKingSide : BlackKingSide;
+    uint8_t queenSide = us == White ? WhiteQueenSide : BlackQueenSide;
+
+    if ((castlingRights & kingSide) &&
+        !(occupied & betweenBB(kingFrom, makeSquare(7, rank))) &&
+        !isSquareAttacked(makeSquare(5, rank), them) &&
+        !isSquareAttacked(makeSquare(6, rank), them))
+      pseudo.add(Move(kingFrom, makeSquare(6, rank), MoveFlag::Castling));
+
+    if ((castlingRights & queenSide) &&
+        !(occupied & betweenBB(kingFrom, makeSquare(0, rank))) &&
+        !isSquareAttacked(makeSquare(3, rank), them) &&
+        !isSquareAttacked(makeSquare(2, rank), them))
+      pseudo.add(Move(kingFrom, makeSquare(2, rank), MoveFlag::Castling));
+  }
+
+  for (Move m : pseudo)
+    if (isLegal(m))
+      list.add(m);
+}
+
+void Position::generateLegalMoves(MoveList &list) const {
+  generate<false>(list);
+}
+
+void Position::generateCaptures(MoveList &list) const { generate<true>(list); }
+
+void Position::makeMove(Move m) {
+  int from = m.getFrom(), to = m.getTo();
+  int piece = board[from];
+  int capturedSquare = m.getFlag() == MoveFlag::EnPassant ? to ^ 8 : to;
+  Color us = sideToMove;
+
+  history.push_back({key, static_cast<int8_t>(board[capturedSquare]),
+                     castlingRights, static_cast<int8_t>(epSquare),
+                     static_cast<uint16_t>(halfmoveClock)});
+
+  setEpSquare(NoSquare);
+  halfmoveClock++;
+
+  if (board[capturedSquare] != NoPiece) {
+    removePiece(capturedSquare);
+    halfmoveClock = 0;
+  }
+
+  movePieceTo(from, to);
+
+  if (typeOf(piece) == PieceType::Pawn) {
+    halfmoveClock = 0;
+
+    // Only record en passant when it can actually be taken, so transpositions
+    // hash the same
+    if ((to ^ from) == 16 &&
+        (pawnAttacks(us, (from + to) / 2) & getPieces(~us, PieceType::Pawn)))
+      setEpSquare((from + to) / 2);
+
+    if (m.getFlag() == MoveFlag::Promotion) {
+      removePiece(to);
+      putPiece(us, m.getPromotion(), to);
+    }
+  }
+
+  if (m.getFlag() == MoveFlag::Castling) {
+    bool kingSide = to > from;
+    movePieceTo(kingSide ? to + 1 : to - 2, kingSide ? to - 1 : to + 1);
+  }
+
+  setCastlingRights(castlingRights & castlingMask[from] & castlingMask[to]);
+
+  setSideToMove(~us);
+  if (sideToMove == White)
+    fullmoveNumber++;
+}
+
+void Position::unmakeMove(Move m) {
+  const UndoInfo &undo = history.back();
+  int from = m.getFrom(), to = m.getTo();
+
+  if (sideToMove == White)
+    fullmoveNumber--;
+  sideToMove = ~sideToMove;
+  Color us = sideToMove;
+
+  if (m.getFlag() == MoveFlag::Promotion) {
+    removePiece(to);
+    putPiece(us, PieceType::Pawn, to);
+  }
+
+  if (m.getFlag() == MoveFlag::Castling) {
+    bool kingSide = to > from;
+    movePieceTo(kingSide ? to - 1 : to + 1, kingSide ? to + 1 : to - 2);
+  }
+
+  movePieceTo(to, from);
+
+  if (undo.captured != NoPiece) {
+    int capturedSquare = m.getFlag() == MoveFlag::EnPassant ? to ^ 8 : to;
+    putPiece(colorOf(undo.captured), typeOf(undo.captured), capturedSquare);
+  }
+
+  castlingRights = undo.castlingRights;
+  epSquare = undo.epSquare;
+  halfmoveClock = undo.halfmoveClock;
+  key = undo.key;
+  history.pop_back();
+}
+
+void Position::makeNullMove() {
+  history.push_back({key, NoPiece, castlingRights,
+                     static_cast<int8_t>(epSquare),
+                     static_cast<uint16_t>(halfmoveClock)});
+  setEpSquare(NoSquare);
+  halfmoveClock++;
+  setSideToMove(~sideToMove);
+}
+
+void Position::unmakeNullMove() {
+  const UndoInfo &undo = history.back();
+  sideToMove = ~sideToMove;
+  epSquare = undo.epSquare;
+  halfmoveClock = undo.halfmoveClock;
+  key = undo.key;
+  history.pop_back();
+}
+
+void Position::generateUnmoves(MoveList &list) const {
+  Color mover = ~sideToMove;
+  Bitboard occupied = getOccupied();
+  int theirKing = getKingSquare(sideToMove);
+
+  auto add = [&](int from, int to, PieceType type) {
+    // In the earlier position the side now to move was not on move, so its
+    // king must not have been attacked there
+    Bitboard before = (occupied ^ squareBB(to)) | squareBB(from);
+    Bitboard attackers =
+        attackersTo(theirKing, before) & colorBB[mover] & ~squareBB(to);
+    Bitboard fromAttacks = type == PieceType::Pawn
+                               ? pawnAttacks(mover, from)
+                               : pieceAttacks(type, from, before);
+    if (!attackers && !(fromAttacks & squareBB(theirKing)))
+      list.add(Move(from, to));
+  };
+
+  Bitboard pieces = colorBB[mover];
+  while (pieces) {
+    int to = popLsb(pieces);
+    PieceType type = typeOf(board[to]);
+
+    if (type == PieceType::Pawn) {
+      int down = mover == White ? -8 : 8;
+      int from = to + down;
+      int relativeRank = mover == White ? rankOf(to) : 7 - rankOf(to);
+      if (relativeRank < 2 || board[from] != NoPiece)
+        continue;
+      add(from, to, type);
+      if (relativeRank == 3 && board[from + down] == NoPiece)
+        add(from + down, to, type);
+      continue;
+    }
+
+    Bitboard origins = pieceAttacks(type, to, occupied) & ~occupied;
+    while (origins)
+      add(popLsb(origins), to, type);
+  }
+}
+
+void Position::retractMove(Move m) {
+  movePieceTo(m.getTo(), m.getFrom());
+  setSideToMove(~sideToMove);
+}
+
+bool Position::isRepetition() const {
+  int plies = std::min<int>(halfmoveClock, history.size());
+  for (int i = 4; i <= plies; i += 2)
+    if (history[history.size() - i].key == key)
+      return true;
+  return false;
+}
+
+bool Position::hasInsufficientMaterial() const {
+  if (getPieces(PieceType::Pawn) || getPieces(PieceType::Rook) ||
+      getPieces(PieceType::Queen))
+    return false;
+
+  // Bare kings, or a single minor piece against a bare king
+  return popCount(getOccupied()) <= 3;
+}
+
+bool Position::isDraw() const {
+  return halfmoveClock >= 100 || isRepetition() || hasInsufficientMaterial();
+}
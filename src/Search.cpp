@@ -0,0 +1,365 @@
+#include "Search.h"
+#include "Evaluation.h"
+#include "Tablebase.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+constexpr int pieceValue[6] = {100, 320, 500, 330, 900, 20000};
+
+// Mate scores are stored relative to the node, not the root
+int scoreToTT(int score, int ply) {
+  return score > MateBound ? score + ply : score < -MateBound ? score - ply
+                                                             : score;
+}
+
+int scoreFromTT(int score, int ply) {
+  return score > MateBound ? score - ply : score < -MateBound ? score + ply
+                                                             : score;
+}
+
+int tablebaseScore(uint8_t value, int ply) {
+  if (TbValue::isWin(value))
+    return MateScore - ply - TbValue::plies(value);
+  if (TbValue::isLoss(value))
+    return -MateScore + ply + TbValue::plies(value);
+  return 0;
+}
+
+bool hasNonPawnMaterial(const Position &pos, Color c) {
+  return pos.getPieces(c) & ~pos.getPieces(c, PieceType::Pawn) &
+         ~pos.getPieces(c, PieceType::King);
+}
+
+int64_t steadyMs(std::chrono::steady_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+// Moves the best scored remaining move to position i
+void pickMove(MoveList &moves, int *scores, int i) {
+  int best = i;
+  for (int j = i + 1; j < moves.size(); j++)
+    if (scores[j] > scores[best])
+      best = j;
+  std::swap(moves[i], moves[best]);
+  std::swap(scores[i], scores[best]);
+}
+
+} // namespace
+
+Search::Search(size_t hashMegabytes) : tt(hashMegabytes) {}
+
+void Search::setTablebases(const Tablebases *tablebases) {
+  this->tablebases = tablebases;
+}
+
+void Search::setHashSize(size_t megabytes) { tt.resize(megabytes); }
+
+void Search::clearHash() { tt.clear(); }
+
+void Search::stop() { stopRequested.store(true, std::memory_order_relaxed); }
+
+void Search::setTimeLimits(int64_t softMs, int64_t hardMs) {
+  int64_t now = steadyMs(std::chrono::steady_clock::now());
+  softDeadlineMs.store(softMs ? now + softMs : 0, std::memory_order_relaxed);
+  hardDeadlineMs.store(hardMs ? now + hardMs : 0, std::memory_order_relaxed);
+}
+
+bool Search::isExcludedAtRoot(Move m) const {
+  return std::find(excludedRootMoves.begin(), excludedRootMoves.end(), m) !=
+         excludedRootMoves.end();
+}
+
+int64_t Search::elapsedMs() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - startTime)
+      .count();
+}
+
+bool Search::shouldStop() {
+  if (aborted)
+    return true;
+
+  int64_t deadline = hardDeadlineMs.load(std::memory_order_relaxed);
+  if (stopRequested.load(std::memory_order_relaxed) ||
+      (limits.nodes && nodes >= limits.nodes) ||
+      (deadline && (nodes & 1023) == 0 &&
+       steadyMs(std::chrono::steady_clock::now()) >= deadline))
+    aborted = true;
+
+  return aborted;
+}
+
+Move Search::think(const Position &root, const SearchLimits &limits,
+                   const std::function<void(const SearchInfo &)> &onIteration) {
+  pos = root;
+  this->limits = limits;
+  startTime = std::chrono::steady_clock::now();
+  int64_t start = steadyMs(startTime);
+  softDeadlineMs = limits.softTimeMs ? start + limits.softTimeMs : 0;
+  hardDeadlineMs = limits.moveTimeMs ? start + limits.moveTimeMs : 0;
+  stopRequested = false;
+  aborted = false;
+  nodes = 0;
+  tbHits = 0;
+  std::memset(killers, 0, sizeof(killers));
+  std::memset(history, 0, sizeof(history));
+  tt.newSearch();
+
+  MoveList rootMoves;
+  pos.generateLegalMoves(rootMoves);
+  excludedRootMoves.clear();
+  if (!limits.searchMoves.empty())
+    for (Move m : rootMoves)
+      if (std::find(limits.searchMoves.begin(), limits.searchMoves.end(),
+                    m) == limits.searchMoves.end())
+        excludedRootMoves.push_back(m);
+  int searchable = rootMoves.size() - excludedRootMoves.size();
+  if (searchable == 0)
+    return Move();
+
+  // Known endgames are read straight from the tables, by distance to mate
+  uint8_t value;
+  if (tablebases && excludedRootMoves.empty() && limits.multiPV <= 1 &&
+      tablebases->canProbe(pos)) {
+    Move best = tablebases->probeRoot(pos, value);
+    if (!best.isNull()) {
+      tbHits++;
+      if (onIteration)
+        onIteration({1, tablebaseScore(value, 0), nodes, tbHits, elapsedMs(),
+                     {best}});
+      return best;
+    }
+  }
+
+  Move bestMove =
+      *std::find_if(rootMoves.begin(), rootMoves.end(),
+                    [&](Move m) { return !isExcludedAtRoot(m); });
+  int lines = std::clamp(limits.multiPV, 1, searchable);
+  size_t fixedExclusions = excludedRootMoves.size();
+
+  for (int depth = 1; depth <= limits.depth && depth < MaxPly; depth++) {
+    // Each further line searches the root again without the moves of the
+    // lines before it
+    excludedRootMoves.resize(fixedExclusions);
+    int bestScore = 0;
+    for (int line = 1; line <= lines; line++) {
+      int score = negamax(depth, 0, -InfiniteScore, InfiniteScore, false);
+      if (aborted && (depth > 1 || line > 1))
+        break;
+
+      if (line == 1) {
+        bestScore = score;
+        if (pvLength[0] > 0)
+          bestMove = pvTable[0][0];
+      }
+
+      if (onIteration)
+        onIteration({depth, score, nodes, tbHits, elapsedMs(),
+                     std::vector<Move>(pvTable[0], pvTable[0] + pvLength[0]),
+                     line});
+
+      if (aborted || pvLength[0] == 0)
+        break;
+      excludedRootMoves.push_back(pvTable[0][0]);
+    }
+
+    int64_t softDeadline = softDeadlineMs.load(std::memory_order_relaxed);
+    if (aborted || std::abs(bestScore) > MateBound ||
+        (softDeadline &&
+         steadyMs(std::chrono::steady_clock::now()) >= softDeadline))
+      break;
+  }
+
+  return bestMove;
+}
+
+void Search::scoreMoves(const MoveList &moves, Move ttMove, int ply,
+                        int *scores) const {
+  for (int i = 0; i < moves.size(); i++) {
+    Move m = moves[i];
+    int victim = pos.getPieceOn(m.getTo());
+
+    if (m == ttMove)
+      scores[i] = 1 << 30;
+    else if (victim != NoPiece || m.getFlag() == MoveFlag::EnPassant) {
+      int captured = victim == NoPiece ? 0 : pieceValue[int(typeOf(victim))];
+      int attacker = pieceValue[int(typeOf(pos.getPieceOn(m.getFrom())))];
+      scores[i] = (1 << 24) + captured * 16 - attacker / 16;
+    } else if (m.getFlag() == MoveFlag::Promotion)
+      scores[i] = m.getPromotion() == PieceType::Queen ? (1 << 23) : -1;
+    else if (m == killers[ply][0])
+      scores[i] = (1 << 22) + 1;
+    else if (m == killers[ply][1])
+      scores[i] = 1 << 22;
+    else
+      scores[i] = history[pos.getSideToMove()][m.getFrom()][m.getTo()];
+  }
+}
+
+int Search::negamax(int depth, int ply, int alpha, int beta, bool allowNull) {
+  pvLength[ply] = ply;
+
+  if (ply > 0 && pos.isDraw())
+    return 0;
+  if (ply >= MaxPly - 1)
+    return evaluate(pos, materials);
+
+  bool inCheck = pos.inCheck();
+  if (inCheck)
+    depth++;
+  if (depth <= 0)
+    return quiescence(ply, alpha, beta);
+
+  nodes++;
+  if (shouldStop())
+    return 0;
+
+  bool pvNode = beta - alpha > 1;
+  bool probeTables = tablebases && ply > 0 && tablebases->canProbe(pos);
+  if (probeTables)
+    tablebases->prefetch(pos);
+
+  uint64_t key = pos.getKey();
+  TTEntry entry;
+  Move ttMove;
+  if (tt.probe(key, entry)) {
+    ttMove = entry.move;
+    int score = scoreFromTT(entry.score, ply);
+    if (!pvNode && ply > 0 && entry.depth >= depth &&
+        (entry.bound == Bound::Exact ||
+         (entry.bound == Bound::Lower && score >= beta) ||
+         (entry.bound == Bound::Upper && score <= alpha)))
+      return score;
+  }
+
+  if (probeTables) {
+    if (std::optional<uint8_t> value = tablebases->probe(pos)) {
+      tbHits++;
+      return tablebaseScore(*value, ply);
+    }
+  }
+
+  // Null move: if passing still beats beta, a real move surely would
+  if (!pvNode && !inCheck && allowNull && depth >= 3 &&
+      hasNonPawnMaterial(pos, pos.getSideToMove()) &&
+      evaluate(pos, materials) >= beta) {
+    int reduction = 2 + depth / 6;
+    pos.makeNullMove();
+    int score =
+        -negamax(depth - 1 - reduction, ply + 1, -beta, -beta + 1, false);
+    pos.unmakeNullMove();
+    if (aborted)
+      return 0;
+    if (score >= beta)
+      return score > MateBound ? beta : score;
+  }
+
+  MoveList moves;
+  pos.generateLegalMoves(moves);
+  if (moves.size() == 0)
+    return inCheck ? -MateScore + ply : 0;
+
+  int scores[256];
+  scoreMoves(moves, ttMove, ply, scores);
+
+  int bestScore = -InfiniteScore;
+  Move bestMove;
+  int originalAlpha = alpha;
+
+  for (int i = 0; i < moves.size(); i++) {
+    pickMove(moves, scores, i);
+    Move m = moves[i];
+    if (ply == 0 && isExcludedAtRoot(m))
+      continue;
+    bool quiet = !pos.isCapture(m) && m.getFlag() != MoveFlag::Promotion;
+
+    pos.makeMove(m);
+
+    int score;
+    if (i == 0)
+      score = -negamax(depth - 1, ply + 1, -beta, -alpha, true);
+    else {
+      // Late quiet moves are searched shallower with a null window first
+      int reduction =
+          quiet && !inCheck && depth >= 3 && i >= 4 ? 1 + (i >= 10) : 0;
+      score = -negamax(depth - 1 - reduction, ply + 1, -alpha - 1, -alpha,
+                       true);
+      if (score > alpha && (reduction || score < beta))
+        score = -negamax(depth - 1, ply + 1, -beta, -alpha, true);
+    }
+
+    pos.unmakeMove(m);
+    if (aborted)
+      return 0;
+
+    if (score > bestScore) {
+      bestScore = score;
+      bestMove = m;
+    }
+
+    if (score > alpha) {
+      alpha = score;
+      pvTable[ply][ply] = m;
+      std::copy(pvTable[ply + 1] + ply + 1,
+                pvTable[ply + 1] + pvLength[ply + 1], pvTable[ply] + ply + 1);
+      pvLength[ply] = pvLength[ply + 1];
+    }
+
+    if (alpha >= beta) {
+      if (quiet) {
+        if (killers[ply][0] != m) {
+          killers[ply][1] = killers[ply][0];
+          killers[ply][0] = m;
+        }
+        history[pos.getSideToMove()][m.getFrom()][m.getTo()] += depth * depth;
+      }
+      break;
+    }
+  }
+
+  Bound bound = bestScore >= beta            ? Bound::Lower
+                : bestScore > originalAlpha ? Bound::Exact
+                                            : Bound::Upper;
+  // A root searched without some of its moves proves nothing about it
+  if (ply > 0 || excludedRootMoves.empty())
+    tt.store(key, bestMove, scoreToTT(bestScore, ply), depth, bound);
+  return bestScore;
+}
+
+int Search::quiescence(int ply, int alpha, int beta) {
+  pvLength[ply] = ply;
+  nodes++;
+  if (shouldStop())
+    return 0;
+
+  int standPat = evaluate(pos, materials);
+  if (ply >= MaxPly - 1 || standPat >= beta)
+    return standPat;
+  alpha = std::max(alpha, standPat);
+
+  MoveList moves;
+  pos.generateCaptures(moves);
+  int scores[256];
+  scoreMoves(moves, Move(), ply, scores);
+
+  for (int i = 0; i < moves.size(); i++) {
+    pickMove(moves, scores, i);
+    pos.makeMove(moves[i]);
+    int score = -quiescence(ply + 1, -beta, -alpha);
+    pos.unmakeMove(moves[i]);
+    if (aborted)
+      return 0;
+
+    if (score >= beta)
+      return score;
+    alpha = std::max(alpha, score);
+  }
+
+  return alpha;
+}
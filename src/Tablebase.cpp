@@ -0,0 +1,448 @@
+#include "Tablebase.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tuple>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+
+constexpr int pieceValue(PieceType type) {
+  switch (type) {
+  case PieceType::Queen:
+    return 9;
+  case PieceType::Rook:
+    return 5;
+  case PieceType::Bishop:
+    return 3;
+  case PieceType::Knight:
+    return 3;
+  default:
+    return 1;
+  }
+}
+
+// Higher is stronger: pawn, knight, bishop, rook, queen
+constexpr int strengthRank(PieceType type) {
+  constexpr int rank[] = {0, 1, 3, 2, 4, 5};
+  return rank[static_cast<int>(type)];
+}
+
+constexpr PieceType countedTypes[] = {PieceType::Queen, PieceType::Rook,
+                                      PieceType::Bishop, PieceType::Knight,
+                                      PieceType::Pawn};
+
+// Tables smaller than this are asked to be read in whole right away
+constexpr size_t WillNeedLimit = 64 * 1024 * 1024;
+
+constexpr char pieceLetter(PieceType type) {
+  return "PNRBQK"[static_cast<int>(type)];
+}
+
+std::optional<PieceType> pieceFromLetter(char c) {
+  switch (c) {
+  case 'Q':
+    return PieceType::Queen;
+  case 'R':
+    return PieceType::Rook;
+  case 'B':
+    return PieceType::Bishop;
+  case 'N':
+    return PieceType::Knight;
+  case 'P':
+    return PieceType::Pawn;
+  default:
+    return std::nullopt;
+  }
+}
+
+void sortStrongestFirst(std::vector<PieceType> &pieces) {
+  std::sort(pieces.begin(), pieces.end(), [](PieceType a, PieceType b) {
+    return strengthRank(a) > strengthRank(b);
+  });
+}
+
+// Without pawns the white king is folded into the a1-d1-d4 triangle
+constexpr auto triangleIndex = [] {
+  std::array<int8_t, 64> index{};
+  index.fill(-1);
+  int next = 0;
+  for (int rank = 0; rank < 4; rank++)
+    for (int file = rank; file < 4; file++)
+      index[makeSquare(file, rank)] = next++;
+  return index;
+}();
+
+constexpr auto triangleSquare = [] {
+  std::array<int8_t, 10> squares{};
+  for (int sq = 0; sq < 64; sq++)
+    if (triangleIndex[sq] >= 0)
+      squares[triangleIndex[sq]] = sq;
+  return squares;
+}();
+
+struct Symmetry {
+  bool files = false, ranks = false, diagonal = false;
+
+  int apply(int square) const {
+    int file = fileOf(square), rank = rankOf(square);
+    if (files)
+      file = 7 - file;
+    if (ranks)
+      rank = 7 - rank;
+    if (diagonal)
+      std::swap(file, rank);
+    return makeSquare(file, rank);
+  }
+};
+
+} // namespace
+
+std::optional<MaterialSignature>
+MaterialSignature::parse(std::string_view name) {
+  if (name.size() < 2 || name[0] != 'K')
+    return std::nullopt;
+
+  size_t second = name.find('K', 1);
+  if (second == std::string_view::npos)
+    return std::nullopt;
+
+  MaterialSignature signature;
+  for (size_t i = 1; i < name.size(); i++) {
+    if (i == second)
+      continue;
+    std::optional<PieceType> type = pieceFromLetter(name[i]);
+    if (!type)
+      return std::nullopt;
+    (i < second ? signature.white : signature.black).push_back(*type);
+  }
+
+  sortStrongestFirst(signature.white);
+  sortStrongestFirst(signature.black);
+  return signature;
+}
+
+MaterialSignature MaterialSignature::fromPosition(const Position &pos) {
+  MaterialSignature signature;
+  for (Color c : {White, Black}) {
+    std::vector<PieceType> &side = c == White ? signature.white
+                                              : signature.black;
+    for (PieceType type : {PieceType::Queen, PieceType::Rook,
+                           PieceType::Bishop, PieceType::Knight,
+                           PieceType::Pawn})
+      side.insert(side.end(), popCount(pos.getPieces(c, type)), type);
+  }
+  return signature;
+}
+
+std::string MaterialSignature::getName() const {
+  std::string name = "K";
+  for (PieceType type : white)
+    name += pieceLetter(type);
+  name += 'K';
+  for (PieceType type : black)
+    name += pieceLetter(type);
+  return name;
+}
+
+bool MaterialSignature::hasPawns() const {
+  auto isPawn = [](PieceType type) { return type == PieceType::Pawn; };
+  return std::any_of(white.begin(), white.end(), isPawn) ||
+         std::any_of(black.begin(), black.end(), isPawn);
+}
+
+bool MaterialSignature::canonicalize() {
+  auto strength = [](const std::vector<PieceType> &side) {
+    int total = 0;
+    for (PieceType type : side)
+      total += pieceValue(type);
+    std::vector<int> ranks;
+    for (PieceType type : side)
+      ranks.push_back(strengthRank(type));
+    return std::make_tuple(total, side.size(), ranks);
+  };
+
+  if (strength(black) > strength(white)) {
+    std::swap(white, black);
+    return true;
+  }
+  return false;
+}
+
+TablebaseLayout::TablebaseLayout(const MaterialSignature &signature)
+    : signature(signature), pawns(signature.hasPawns()) {
+  for (PieceType type : signature.white) {
+    colors.push_back(White);
+    types.push_back(type);
+  }
+  for (PieceType type : signature.black) {
+    colors.push_back(Black);
+    types.push_back(type);
+  }
+
+  kingSquares = pawns ? 32 : 10;
+  size = 2 * kingSquares * 64;
+  for (size_t i = 0; i < types.size(); i++)
+    size *= 64;
+}
+
+uint64_t TablebaseLayout::index(const Position &pos, bool flipped) const {
+  // Reads a square from the table's point of view
+  auto view = [&](int square) { return flipped ? flipRank(square) : square; };
+  auto viewColor = [&](Color c) { return flipped ? ~c : c; };
+
+  int whiteKing = view(pos.getKingSquare(viewColor(White)));
+
+  Symmetry symmetry;
+  symmetry.files = fileOf(whiteKing) > 3;
+  if (!pawns) {
+    symmetry.ranks = rankOf(whiteKing) > 3;
+    int king = symmetry.apply(whiteKing);
+    symmetry.diagonal = rankOf(king) > fileOf(king);
+  }
+
+  auto indexWith = [&](const Symmetry &symmetry) {
+    int king = symmetry.apply(whiteKing);
+    uint64_t idx = viewColor(pos.getSideToMove());
+    idx = idx * kingSquares + (pawns ? rankOf(king) * 4 + fileOf(king)
+                                     : triangleIndex[king]);
+    idx = idx * 64 + symmetry.apply(view(pos.getKingSquare(viewColor(Black))));
+
+    // Identical pieces are listed in ascending square order
+    for (size_t i = 0; i < types.size();) {
+      size_t group = i;
+      while (group < types.size() && types[group] == types[i] &&
+             colors[group] == colors[i])
+        group++;
+
+      std::array<int, 8> squares{};
+      int count = 0;
+      Bitboard pieces = pos.getPieces(viewColor(colors[i]), types[i]);
+      // A layout never has more than eight of one piece; each square is
+      // inserted in order as it comes
+      while (pieces && count < 8) {
+        int square = symmetry.apply(view(popLsb(pieces)));
+        int j = count++;
+        for (; j > 0 && squares[j - 1] > square; j--)
+          squares[j] = squares[j - 1];
+        squares[j] = square;
+      }
+
+      for (int j = 0; j < count; j++)
+        idx = idx * 64 + squares[j];
+      i = group;
+    }
+    return idx;
+  };
+
+  uint64_t idx = indexWith(symmetry);
+
+  // A king on the a1-h8 diagonal stays in the triangle when the board is
+  // reflected in that diagonal, so both readings are tried and the smaller
+  // one is used
+  int king = symmetry.apply(whiteKing);
+  if (!pawns && rankOf(king) == fileOf(king)) {
+    symmetry.diagonal = !symmetry.diagonal;
+    idx = std::min(idx, indexWith(symmetry));
+  }
+
+  return idx;
+}
+
+bool TablebaseLayout::decode(uint64_t idx, Position &pos) const {
+  uint64_t original = idx;
+  std::array<int, 8> squares{};
+  for (size_t i = types.size(); i-- > 0;) {
+    squares[i] = idx % 64;
+    idx /= 64;
+  }
+  int blackKing = idx % 64;
+  idx /= 64;
+  uint64_t kingIdx = idx % kingSquares;
+  Color side = Color(idx / kingSquares);
+  int whiteKing = pawns ? makeSquare(kingIdx % 4, kingIdx / 4)
+                        : triangleSquare[kingIdx];
+
+  Bitboard occupied = squareBB(whiteKing);
+  if (occupied & squareBB(blackKing))
+    return false;
+  occupied |= squareBB(blackKing);
+
+  for (size_t i = 0; i < types.size(); i++) {
+    if (occupied & squareBB(squares[i]))
+      return false;
+    occupied |= squareBB(squares[i]);
+
+    if (types[i] == PieceType::Pawn &&
+        (squareBB(squares[i]) & (Rank1 | Rank8)))
+      return false;
+    if (i > 0 && types[i] == types[i - 1] && colors[i] == colors[i - 1] &&
+        squares[i] < squares[i - 1])
+      return false;
+  }
+
+  pos.clear();
+  pos.putPiece(White, PieceType::King, whiteKing);
+  pos.putPiece(Black, PieceType::King, blackKing);
+  for (size_t i = 0; i < types.size(); i++)
+    pos.putPiece(colors[i], types[i], squares[i]);
+  pos.setSideToMove(side);
+
+  // The side that just moved cannot be left in check
+  if (pos.isSquareAttacked(pos.getKingSquare(~side), side))
+    return false;
+
+  return pawns || whiteKing % 9 != 0 || index(pos, false) == original;
+}
+
+uint64_t tablebaseId(const MaterialSignature &signature) {
+  uint64_t id = 0;
+  for (PieceType type : signature.white)
+    id += uint64_t{1} << (4 * static_cast<int>(type));
+  for (PieceType type : signature.black)
+    id += uint64_t{1} << (4 * (PieceTypeCount + static_cast<int>(type)));
+  return id;
+}
+
+uint64_t tablebaseId(const Position &pos, bool flipped) {
+  uint64_t id = 0;
+  for (Color c : {White, Black})
+    for (PieceType type : countedTypes) {
+      int side = flipped ? ~c : c;
+      id += uint64_t(popCount(pos.getPieces(c, type)))
+            << (4 * (side * PieceTypeCount + static_cast<int>(type)));
+    }
+  return id;
+}
+
+Tablebases::~Tablebases() {
+  for (auto &[id, table] : tables)
+    munmap(table.mapping, table.length);
+}
+
+int Tablebases::load(const std::string &directory) {
+  std::error_code error;
+  int added = 0;
+
+  for (const auto &file :
+       std::filesystem::directory_iterator(directory, error)) {
+    if (file.path().extension() != TablebaseExtension)
+      continue;
+
+    int fd = open(file.path().c_str(), O_RDONLY);
+    if (fd < 0)
+      continue;
+
+    struct stat info;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 &&
+        static_cast<size_t>(info.st_size) >= sizeof(TablebaseHeader))
+      mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+      continue;
+
+    size_t length = info.st_size;
+    TablebaseHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    std::optional<MaterialSignature> signature =
+        MaterialSignature::parse(std::string_view(
+            header.signature, strnlen(header.signature, sizeof(header.signature))));
+
+    if (std::memcmp(header.magic, TablebaseMagic, sizeof(header.magic)) != 0 ||
+        header.version != TablebaseVersion || !signature ||
+        TablebaseLayout(*signature).getSize() != header.entries ||
+        length != sizeof(header) + header.entries ||
+        tables.contains(tablebaseId(*signature))) {
+      munmap(mapping, length);
+      continue;
+    }
+
+    // Probes land all over the table, so read-ahead would only waste I/O
+    madvise(mapping, length,
+            length <= WillNeedLimit ? MADV_WILLNEED : MADV_RANDOM);
+
+    tables.emplace(tablebaseId(*signature),
+                   MappedTable{TablebaseLayout(*signature),
+                               static_cast<const uint8_t *>(mapping) +
+                                   sizeof(header),
+                               mapping, length});
+    maxPieces = std::max(maxPieces, signature->getPieceCount());
+    added++;
+  }
+
+  return added;
+}
+
+const Tablebases::MappedTable *Tablebases::find(const Position &pos,
+                                                bool &flipped) const {
+  for (bool flip : {false, true}) {
+    auto it = tables.find(tablebaseId(pos, flip));
+    if (it != tables.end()) {
+      flipped = flip;
+      return &it->second;
+    }
+  }
+  return nullptr;
+}
+
+bool Tablebases::canProbe(const Position &pos) const {
+  return pos.getPieceCount() <= maxPieces && pos.getCastlingRights() == 0 &&
+         pos.getEpSquare() == NoSquare;
+}
+
+void Tablebases::prefetch(const Position &pos) const {
+  bool flipped;
+  if (const MappedTable *table = find(pos, flipped))
+    __builtin_prefetch(&table->values[table->layout.index(pos, flipped)]);
+}
+
+std::optional<uint8_t> Tablebases::probe(const Position &pos) const {
+  if (pos.getPieceCount() == 2)
+    return TbValue::Draw;
+  if (!canProbe(pos))
+    return std::nullopt;
+
+  bool flipped;
+  const MappedTable *table = find(pos, flipped);
+  if (!table)
+    return std::nullopt;
+  return table->values[table->layout.index(pos, flipped)];
+}
+
+Move Tablebases::probeRoot(Position &pos, uint8_t &value) const {
+  std::optional<uint8_t> root = probe(pos);
+  if (!root)
+    return Move();
+
+  MoveList moves;
+  pos.generateLegalMoves(moves);
+
+  Move best;
+  int bestRank = -1;
+  for (Move m : moves) {
+    pos.makeMove(m);
+    std::optional<uint8_t> child = probe(pos);
+    pos.unmakeMove(m);
+    if (!child)
+      return Move();
+
+    // Fastest mate first, then draws, then the slowest defeat
+    int plies = TbValue::plies(*child);
+    int rank = TbValue::isLoss(*child)  ? 1000 - plies
+               : TbValue::isWin(*child) ? plies
+                                        : 500;
+    if (rank > bestRank) {
+      bestRank = rank;
+      best = m;
+    }
+  }
+
+  value = *root;
+  return best;
+}
@@ -0,0 +1,251 @@
+#include "TablebaseGenerator.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+namespace {
+
+// Runs work(begin, end) over [0, size) in chunks shared between threads
+void parallelFor(uint64_t size, unsigned threads,
+                 const std::function<void(uint64_t, uint64_t)> &work) {
+  constexpr uint64_t chunk = 1 << 14;
+  std::atomic<uint64_t> next{0};
+  std::vector<std::thread> workers;
+
+  for (unsigned t = 0; t < threads; t++)
+    workers.emplace_back([&] {
+      for (uint64_t begin; (begin = next.fetch_add(chunk)) < size;)
+        work(begin, std::min(begin + chunk, size));
+    });
+
+  for (std::thread &worker : workers)
+    worker.join();
+}
+
+bool isConversion(const Position &pos, Move m) {
+  return pos.isCapture(m) || m.getFlag() == MoveFlag::Promotion;
+}
+
+uint8_t load(uint8_t &value) {
+  return std::atomic_ref<uint8_t>(value).load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+TablebaseGenerator::TablebaseGenerator(unsigned threads)
+    : threads(std::max(1u, threads)) {}
+
+uint8_t TablebaseGenerator::probe(const Position &pos) const {
+  if (pos.getPieceCount() == 2)
+    return TbValue::Draw;
+
+  for (bool flipped : {false, true}) {
+    auto it = tables.find(tablebaseId(pos, flipped));
+    if (it != tables.end()) {
+      const Table &table = *it->second;
+      return table.values[table.layout.index(pos, flipped)];
+    }
+  }
+  return TbValue::Draw;
+}
+
+const std::vector<uint8_t> &
+TablebaseGenerator::generate(MaterialSignature signature) {
+  signature.canonicalize();
+  uint64_t id = tablebaseId(signature);
+  if (auto it = tables.find(id); it != tables.end())
+    return it->second->values;
+
+  // Every material set one capture or promotion away
+  for (Color c : {White, Black}) {
+    std::vector<PieceType> &side =
+        c == White ? signature.white : signature.black;
+    for (size_t i = 0; i < side.size(); i++) {
+      MaterialSignature smaller = signature;
+      std::vector<PieceType> &pieces =
+          c == White ? smaller.white : smaller.black;
+      pieces.erase(pieces.begin() + i);
+      if (smaller.getPieceCount() > 2)
+        generate(smaller);
+
+      if (side[i] != PieceType::Pawn)
+        continue;
+      for (PieceType promotion : {PieceType::Queen, PieceType::Rook,
+                                  PieceType::Bishop, PieceType::Knight}) {
+        MaterialSignature promoted = signature;
+        std::vector<PieceType> &promotedSide =
+            c == White ? promoted.white : promoted.black;
+        promotedSide[i] = promotion;
+        generate(*MaterialSignature::parse(promoted.getName()));
+      }
+    }
+  }
+
+  std::unique_ptr<Table> table = build(signature);
+  const std::vector<uint8_t> &values = table->values;
+  tables.emplace(id, std::move(table));
+  generated.push_back(signature);
+  return values;
+}
+
+std::unique_ptr<TablebaseGenerator::Table>
+TablebaseGenerator::build(const MaterialSignature &signature) {
+  auto table = std::make_unique<Table>(
+      Table{TablebaseLayout(signature), std::vector<uint8_t>()});
+  const TablebaseLayout &layout = table->layout;
+  std::vector<uint8_t> &values = table->values;
+  values.assign(layout.getSize(), TbValue::Draw);
+
+  // Ply at which a capture or promotion decides the position: odd for the
+  // fastest winning conversion, even for the slowest losing one when every
+  // conversion loses
+  std::vector<uint8_t> conversion(layout.getSize(), 0);
+  std::atomic<int> lastConversion{0};
+
+  parallelFor(layout.getSize(), threads, [&](uint64_t begin, uint64_t end) {
+    Position pos;
+    for (uint64_t idx = begin; idx < end; idx++) {
+      if (!layout.decode(idx, pos))
+        continue;
+
+      MoveList moves;
+      pos.generateLegalMoves(moves);
+      if (moves.size() == 0) {
+        values[idx] = pos.inCheck() ? TbValue::lossIn(0) : TbValue::Draw;
+        continue;
+      }
+
+      int fastestWin = 256, slowestLoss = 0;
+      bool canHold = false, converts = false;
+      for (Move m : moves) {
+        if (!isConversion(pos, m))
+          continue;
+        converts = true;
+        pos.makeMove(m);
+        uint8_t child = probe(pos);
+        pos.unmakeMove(m);
+
+        if (TbValue::isLoss(child))
+          fastestWin = std::min(fastestWin, TbValue::plies(child) + 1);
+        else if (TbValue::isWin(child))
+          slowestLoss = std::max(slowestLoss, TbValue::plies(child) + 1);
+        else
+          canHold = true;
+      }
+
+      int ply = fastestWin < 256          ? fastestWin
+                : converts && !canHold ? slowestLoss
+                                          : 0;
+      conversion[idx] = std::min(ply, 255);
+      if (ply) {
+        int last = lastConversion.load();
+        while (ply > last && !lastConversion.compare_exchange_weak(last, ply))
+          ;
+      }
+    }
+  });
+
+  // A position is lost in ply moves once every move leads to a win for the
+  // opponent, the slowest of them in ply - 1
+  auto provesLoss = [&](Position &pos, int ply) {
+    MoveList moves;
+    pos.generateLegalMoves(moves);
+    for (Move m : moves) {
+      uint8_t child;
+      if (isConversion(pos, m)) {
+        pos.makeMove(m);
+        child = probe(pos);
+        pos.unmakeMove(m);
+      } else {
+        pos.makeMove(m);
+        child = load(values[layout.index(pos, false)]);
+        pos.unmakeMove(m);
+      }
+      if (!TbValue::isWin(child) || TbValue::plies(child) > ply - 1)
+        return false;
+    }
+    return moves.size() > 0;
+  };
+
+  int quietPlies = 0;
+  for (int ply = 1; ply <= 254; ply++) {
+    bool winning = ply % 2 == 1;
+    uint8_t previous = winning ? TbValue::lossIn(ply - 1)
+                               : TbValue::winIn(ply - 1);
+    uint8_t result = winning ? TbValue::winIn(ply) : TbValue::lossIn(ply);
+    std::atomic<uint64_t> found{0};
+
+    parallelFor(layout.getSize(), threads, [&](uint64_t begin, uint64_t end) {
+      Position pos, predecessor;
+      uint64_t count = 0;
+
+      auto resolve = [&](uint64_t idx, Position &candidate) {
+        uint8_t expected = TbValue::Draw;
+        if (load(values[idx]) != TbValue::Draw)
+          return;
+        if (!winning && !provesLoss(candidate, ply))
+          return;
+        if (std::atomic_ref<uint8_t>(values[idx])
+                .compare_exchange_strong(expected, result,
+                                         std::memory_order_relaxed))
+          count++;
+      };
+
+      for (uint64_t idx = begin; idx < end; idx++) {
+        uint8_t value = load(values[idx]);
+
+        if (value == TbValue::Draw && conversion[idx] == ply &&
+            layout.decode(idx, pos))
+          resolve(idx, pos);
+
+        if (value != previous || !layout.decode(idx, pos))
+          continue;
+
+        MoveList unmoves;
+        pos.generateUnmoves(unmoves);
+        for (Move m : unmoves) {
+          predecessor = pos;
+          predecessor.retractMove(m);
+          resolve(layout.index(predecessor, false), predecessor);
+        }
+      }
+      found += count;
+    });
+
+    quietPlies = found ? 0 : quietPlies + 1;
+    if (quietPlies >= 2 && ply >= lastConversion)
+      break;
+  }
+
+  return table;
+}
+
+bool TablebaseGenerator::write(const MaterialSignature &signature,
+                               const std::string &directory) const {
+  MaterialSignature canonical = signature;
+  canonical.canonicalize();
+  auto it = tables.find(tablebaseId(canonical));
+  if (it == tables.end())
+    return false;
+
+  TablebaseHeader header{};
+  std::memcpy(header.magic, TablebaseMagic, sizeof(header.magic));
+  header.version = TablebaseVersion;
+  header.pieceCount = canonical.getPieceCount();
+  std::string name = canonical.getName();
+  std::strncpy(header.signature, name.c_str(), sizeof(header.signature) - 1);
+  header.entries = it->second->values.size();
+
+  std::ofstream file(directory + "/" + name + TablebaseExtension,
+                     std::ios::binary);
+  if (!file)
+    return false;
+
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(it->second->values.data()),
+             it->second->values.size());
+  return static_cast<bool>(file);
+}
@@ -0,0 +1,23 @@
+#include "TimeManager.h"
+#include <algorithm>
+
+namespace {
+
+// Moves still to play when the clock does not say
+constexpr int Horizon = 30;
+
+} // namespace
+
+TimeBudget allocateTime(const TimeControl &control) {
+  int64_t usable =
+      std::max<int64_t>(control.remainingMs - control.overheadMs, 1);
+  int moves = control.movesToGo > 0 ? std::min(control.movesToGo, Horizon)
+                                    : Horizon;
+
+  int64_t soft = usable / moves + control.incrementMs * 3 / 4;
+  // With one move left before the control there is nothing to save for
+  int64_t hard = moves == 1 ? usable : std::min(usable / 4, soft * 5);
+  soft = std::min(soft, usable);
+  hard = std::clamp<int64_t>(hard, std::min(soft, usable), usable);
+  return {std::max<int64_t>(soft, 1), std::max<int64_t>(hard, 1)};
+}
@@ -0,0 +1,46 @@
+#include "TranspositionTable.h"
+#include <algorithm>
+#include <bit>
+
+TranspositionTable::TranspositionTable(size_t megabytes) { resize(megabytes); }
+
+void TranspositionTable::resize(size_t megabytes) {
+  // Power of two entry count so the key can be masked into an index
+  size_t count = std::bit_floor(std::max<size_t>(
+      1, megabytes * 1024 * 1024 / sizeof(TTEntry)));
+  entries.assign(count, TTEntry{});
+}
+
+void TranspositionTable::clear() {
+  std::fill(entries.begin(), entries.end(), TTEntry{});
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry &entry) const {
+  entry = entries[key & (entries.size() - 1)];
+  return entry.key == key && entry.bound != Bound::None;
+}
+
+void TranspositionTable::store(uint64_t key, Move move, int score, int depth,
+                               Bound bound) {
+  TTEntry &entry = entries[key & (entries.size() - 1)];
+
+  // Keep the old move when this search found none for the same position
+  if (move.isNull() && entry.key == key)
+    move = entry.move;
+
+  entry = {key, move, static_cast<int16_t>(score), static_cast<int8_t>(depth),
+           bound, generation};
+}
+
+void TranspositionTable::prefetch(uint64_t key) const {
+  __builtin_prefetch(&entries[key & (entries.size() - 1)]);
+}
+
+int TranspositionTable::hashfull() const {
+  size_t sample = std::min<size_t>(1000, entries.size());
+  size_t used = 0;
+  for (size_t i = 0; i < sample; i++)
+    if (entries[i].bound != Bound::None && entries[i].generation == generation)
+      used++;
+  return used * 1000 / sample;
+}
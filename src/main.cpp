@@ -1,131 +1,246 @@
-// clang-format off
-#include "Board.h"
-#include "glm/gtc/matrix_transform.hpp"
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
-// clang-format on
-#include "SpriteSheet.h"
-#include <stb_image.h>
-
-#include <glm/glm.hpp>
-#include <glm/gtc/type_ptr.hpp>
-
-#include <iostream>
-
-#include <Shader.h>
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-#include <stb_image_resize2.h>
-
-void framebuffer_size_callback(GLFWwindow *window, int width, int height);
-void processInput(GLFWwindow *window);
-
-// settings
-const float SCR_WIDTH = 800;
-const float SCR_HEIGHT = 800;
-
-int main() {
-  glfwInit();
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-#ifdef __APPLE__
-  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-  // glfw window creation
-  // --------------------
-  GLFWwindow *window =
-      glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Chess", NULL, NULL);
-  if (window == NULL) {
-    std::cout << "Failed to create GLFW window" << std::endl;
-    glfwTerminate();
-    return -1;
-  }
-  glfwMakeContextCurrent(window);
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    std::cout << "Failed to initialize GLAD" << std::endl;
-    return -1;
-  }
-
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-#ifdef _WIN32
-  Shader ourShader("src\\vShader.vert", "src\\fShader.frag");
-#else
-  Shader boardShader("src/vShader.vert", "src/fShader.frag");
-  Shader pieceShader("src/piece.vert", "src/piece.frag");
-#endif
-
-  Board board;
-  glfwSetWindowUserPointer(window, &board);
-
-  // Mouse button callback
-  glfwSetMouseButtonCallback(
-      window, [](GLFWwindow *win, int button, int action, int) {
-        if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
-          double x, y;
-          glfwGetCursorPos(win, &x, &y);
-
-          Board *board = static_cast<Board *>(glfwGetWindowUserPointer(win));
-          if (board) {
-            if (board->getGameState() == GameState::Playing)
-              board->handleClick(static_cast<float>(x), static_cast<float>(y));
-            else if (board->getGameState() == GameState::PromotionPending)
-              board->handlePromotionClick(static_cast<float>(x),
-                                          static_cast<float>(y));
-          }
-        }
-      });
-
-  SpriteSheet blackSheet("chess_sprites/16x16_pieces/BlackPieces.png");
-  SpriteSheet whiteSheet("chess_sprites/16x16_pieces/WhitePieces_Wood.png");
-
-  board.initializeBoard(blackSheet, whiteSheet);
-  blackSheet.initQuad();
-  whiteSheet.initQuad();
-
-  boardShader.use();
-  glm::mat4 projection = glm::ortho(0.f, SCR_WIDTH, 0.f, SCR_HEIGHT);
-  boardShader.setMat4("uProjection", projection);
-
-  pieceShader.use();
-  pieceShader.setInt("uTexture", 0);
-  pieceShader.setMat4("uProjection", projection);
-
-  while (!glfwWindowShouldClose(window)) {
-    processInput(window);
-
-    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    boardShader.use();
-    board.render(blackSheet, whiteSheet, pieceShader, projection);
-
-    if (board.checkIfWon()) {
-      std::cout << "GAME OVER!\n\n";
-      break;
-    }
-
-    glfwSwapBuffers(window);
-    glfwPollEvents();
-  }
-
-  glfwTerminate();
-  return 0;
-}
-
-void processInput(GLFWwindow *window) {
-  if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-    glfwSetWindowShouldClose(window, true);
-}
-
-void framebuffer_size_callback(GLFWwindow *, int width, int height) {
-  // make sure the viewport matches the new window dimensions; note that width
-  // and height will be significantly larger than specified on retina displays.
-  glViewport(0, 0, width, height);
-}
+// clang-format off
+#include "Analysis.h"
+#include "Board.h"
+#include "BoardRenderer.h"
+#include "EngineWorker.h"
+#include "GameSession.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+#include "SpriteSheet.h"
+#include <stb_image.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <Shader.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#include <stb_image_resize2.h>
+
+void framebuffer_size_callback(GLFWwindow *window, int width, int height);
+void processInput(GLFWwindow *window);
+
+// settings
+const float SCR_WIDTH = 800;
+const float SCR_HEIGHT = 800;
+
+// What the input callbacks reach through the window user pointer
+struct Gui {
+  Board &board;
+  BoardRenderer &renderer;
+  GameSession &session;
+  Analysis &analysis;
+  bool analysing = false;
+};
+
+int64_t nowMs() { return static_cast<int64_t>(glfwGetTime() * 1000); }
+std::optional<PlayOptions> parseOptions(int argc, char **argv);
+std::string clockTitle(const GameSession &session);
+
+int main(int argc, char **argv) {
+  std::optional<PlayOptions> options = parseOptions(argc, argv);
+  if (!options) {
+    std::cout << "Usage: OpenGLProject [-e white|black|both|none] "
+                 "[-c minutes+increment] [--no-ponder]\n";
+    return 1;
+  }
+
+  glfwInit();
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+  // glfw window creation
+  // --------------------
+  GLFWwindow *window =
+      glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Chess", NULL, NULL);
+  if (window == NULL) {
+    std::cout << "Failed to create GLFW window" << std::endl;
+    glfwTerminate();
+    return -1;
+  }
+  glfwMakeContextCurrent(window);
+  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    std::cout << "Failed to initialize GLAD" << std::endl;
+    return -1;
+  }
+
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+#ifdef _WIN32
+  Shader ourShader("src\\vShader.vert", "src\\fShader.frag");
+#else
+  Shader boardShader("src/vShader.vert", "src/fShader.frag");
+  Shader pieceShader("src/piece.vert", "src/piece.frag");
+#endif
+
+  SpriteSheet blackSheet("chess_sprites/16x16_pieces/BlackPieces.png");
+  SpriteSheet whiteSheet("chess_sprites/16x16_pieces/WhitePieces_Wood.png");
+
+  Board board;
+  board.initializeBoard();
+  blackSheet.initQuad();
+  whiteSheet.initQuad();
+  BoardRenderer renderer(blackSheet, whiteSheet);
+
+  EngineWorker engine;
+  GameSession session(board, engine, *options, nowMs());
+  Analysis analysis;
+  Gui gui{board, renderer, session, analysis};
+  glfwSetWindowUserPointer(window, &gui);
+
+  // Space has the engine play for a human side to move; the search runs on
+  // the worker while frames keep coming. A turns live analysis on and off.
+  glfwSetKeyCallback(
+      window, [](GLFWwindow *win, int key, int, int action, int) {
+        Gui *gui = static_cast<Gui *>(glfwGetWindowUserPointer(win));
+        if (!gui || action != GLFW_PRESS)
+          return;
+        if (key == GLFW_KEY_SPACE)
+          gui->session.requestEngineMove(nowMs());
+        else if (key == GLFW_KEY_A) {
+          gui->analysing = !gui->analysing;
+          if (!gui->analysing)
+            gui->analysis.stop();
+        }
+      });
+
+  // Mouse button callback
+  glfwSetMouseButtonCallback(
+      window, [](GLFWwindow *win, int button, int action, int) {
+        if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+          double x, y;
+          glfwGetCursorPos(win, &x, &y);
+
+          Gui *gui = static_cast<Gui *>(glfwGetWindowUserPointer(win));
+          if (gui) {
+            Board &board = gui->board;
+            if (!gui->session.isHumanTurn())
+              return;
+            if (board.getGameState() == GameState::Playing) {
+              glm::ivec2 square = gui->renderer.squareAt(x, y);
+              board.handleClick(square.x, square.y);
+            } else if (board.getGameState() == GameState::PromotionPending) {
+              if (std::optional<PieceType> type =
+                      gui->renderer.promotionChoiceAt(x, y))
+                board.promote(*type);
+            }
+          }
+        }
+      });
+
+  boardShader.use();
+  glm::mat4 projection = glm::ortho(0.f, SCR_WIDTH, 0.f, SCR_HEIGHT);
+  boardShader.setMat4("uProjection", projection);
+
+  pieceShader.use();
+  pieceShader.setInt("uTexture", 0);
+  pieceShader.setMat4("uProjection", projection);
+
+  std::string shownTitle = "Chess";
+  while (!glfwWindowShouldClose(window)) {
+    processInput(window);
+    session.update(nowMs());
+    if (gui.analysing)
+      analysis.update(board);
+    std::string title = clockTitle(session);
+    if (title != shownTitle) {
+      glfwSetWindowTitle(window, title.c_str());
+      shownTitle = title;
+    }
+
+    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    boardShader.use();
+    renderer.render(board, pieceShader, projection, glfwGetTime(),
+                    gui.analysing ? &analysis : nullptr);
+
+    if (board.checkIfWon()) {
+      std::cout << "GAME OVER!\n\n";
+      break;
+    }
+    if (std::optional<Color> flagged = session.getFlagged()) {
+      std::cout << (*flagged == White ? "White" : "Black")
+                << " lost on time\n\n";
+      break;
+    }
+    if (session.hasStopped()) {
+      std::cout << "GAME OVER!\n\n";
+      break;
+    }
+
+    glfwSwapBuffers(window);
+    glfwPollEvents();
+  }
+
+  glfwTerminate();
+  return 0;
+}
+
+// -e picks the engine's side, -c the clock as minutes+increment in seconds
+std::optional<PlayOptions> parseOptions(int argc, char **argv) {
+  PlayOptions options;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-e" && i + 1 < argc) {
+      std::string_view side = argv[++i];
+      if (side != "white" && side != "black" && side != "both" &&
+          side != "none")
+        return std::nullopt;
+      options.engineSide[White] = side == "white" || side == "both";
+      options.engineSide[Black] = side == "black" || side == "both";
+    } else if (arg == "-c" && i + 1 < argc) {
+      char *end;
+      double minutes = std::strtod(argv[++i], &end);
+      double increment = *end == '+' ? std::strtod(end + 1, &end) : 0;
+      if (*end || minutes <= 0 || increment < 0)
+        return std::nullopt;
+      options.initialMs = static_cast<int64_t>(minutes * 60000);
+      options.incrementMs = static_cast<int64_t>(increment * 1000);
+    } else if (arg == "--no-ponder")
+      options.ponder = false;
+    else
+      return std::nullopt;
+  }
+  return options;
+}
+
+std::string clockTitle(const GameSession &session) {
+  if (!session.isTimed())
+    return "Chess";
+  auto show = [&](Color side) {
+    int64_t tenths = session.getRemainingMs(side, nowMs()) / 100;
+    std::string seconds = std::to_string(tenths / 10 % 60);
+    return std::to_string(tenths / 600) + ":" +
+           (seconds.size() < 2 ? "0" : "") + seconds + "." +
+           std::to_string(tenths % 10);
+  };
+  return "Chess - White " + show(White) + "  Black " + show(Black);
+}
+
+void processInput(GLFWwindow *window) {
+  if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    glfwSetWindowShouldClose(window, true);
+}
+
+void framebuffer_size_callback(GLFWwindow *, int width, int height) {
+  // make sure the viewport matches the new window dimensions; note that width
+  // and height will be significantly larger than specified on retina displays.
+  glViewport(0, 0, width, height);
+}
@@ -0,0 +1,9 @@
+#version 420 core
+
+in vec4 vColor;
+
+out vec4 FragColor;
+
+void main() {
+    FragColor = vColor;
+}
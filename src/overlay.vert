@@ -0,0 +1,13 @@
+#version 420 core
+
+layout(location = 0) in vec2 aPos;
+layout(location = 1) in vec4 aColor;
+
+out vec4 vColor;
+
+uniform mat4 uProjection;
+
+void main() {
+    gl_Position = uProjection * vec4(aPos, 0.0, 1.0);
+    vColor = aColor;
+}
@@ -0,0 +1,159 @@
+#include "BookBuilder.h"
+#include "MappedFile.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t BatchSize = 512;
+
+// Hands batches of games from the reader to the workers, blocking the reader
+// while every slot is full so memory stays bounded
+class BatchQueue {
+private:
+  std::mutex mutex;
+  std::condition_variable notEmpty, notFull;
+  std::deque<std::vector<PgnGame>> batches;
+  size_t capacity;
+  bool closed = false;
+
+public:
+  explicit BatchQueue(size_t capacity) : capacity(capacity) {}
+
+  void push(std::vector<PgnGame> batch) {
+    std::unique_lock lock(mutex);
+    notFull.wait(lock, [&] { return batches.size() < capacity; });
+    batches.push_back(std::move(batch));
+    notEmpty.notify_one();
+  }
+
+  bool pop(std::vector<PgnGame> &batch) {
+    std::unique_lock lock(mutex);
+    notEmpty.wait(lock, [&] { return !batches.empty() || closed; });
+    if (batches.empty())
+      return false;
+    batch = std::move(batches.front());
+    batches.pop_front();
+    notFull.notify_one();
+    return true;
+  }
+
+  void close() {
+    std::lock_guard lock(mutex);
+    closed = true;
+    notEmpty.notify_all();
+  }
+};
+
+void printUsage() {
+  std::println("Usage: chess_bookgen -o book.bin [-t threads] [-M megabytes] "
+               "[-p plies] [-m min-games] [-T temp-dir] FILE.pgn...");
+  std::println("Counts the opening moves of every game and writes a Polyglot "
+               "book.");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  std::string output;
+  BookBuilderOptions options;
+  std::vector<std::string> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-o" && i + 1 < argc)
+      output = argv[++i];
+    else if (arg == "-t" && i + 1 < argc)
+      threads = std::atoi(argv[++i]);
+    else if (arg == "-M" && i + 1 < argc)
+      options.memoryLimit = std::strtoull(argv[++i], nullptr, 10) << 20;
+    else if (arg == "-p" && i + 1 < argc)
+      options.maxPly = std::atoi(argv[++i]);
+    else if (arg == "-m" && i + 1 < argc)
+      options.minGames = std::atoi(argv[++i]);
+    else if (arg == "-T" && i + 1 < argc)
+      options.tempDirectory = argv[++i];
+    else if (!arg.empty() && arg[0] != '-')
+      inputs.emplace_back(arg);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (output.empty() || inputs.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  threads = std::max(1u, threads);
+  BookBuilder builder(options);
+  BatchQueue queue(2 * threads);
+  auto start = std::chrono::steady_clock::now();
+
+  // A failed spill has lost counts: the workers drain the queue without
+  // counting, and nothing is written
+  std::atomic<bool> spillFailed{false};
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++)
+    workers.emplace_back([&] {
+      std::vector<PgnGame> batch;
+      while (queue.pop(batch))
+        for (const PgnGame &game : batch)
+          if (!spillFailed && !builder.addGame(game))
+            spillFailed = true;
+    });
+
+  // Games are views into the mapped files, so every file stays mapped until
+  // the workers are done with it
+  std::deque<MappedFile> files;
+  for (const std::string &input : inputs) {
+    MappedFile &file = files.emplace_back();
+    if (!file.open(input)) {
+      std::println(stderr, "Could not open {}", input);
+      continue;
+    }
+    PgnParser parser(file.getView());
+    std::vector<PgnGame> batch(BatchSize);
+    size_t filled = 0;
+    while (parser.next(batch[filled]))
+      if (++filled == BatchSize) {
+        queue.push(std::move(batch));
+        batch.assign(BatchSize, PgnGame());
+        filled = 0;
+      }
+    batch.resize(filled);
+    if (filled)
+      queue.push(std::move(batch));
+  }
+
+  queue.close();
+  for (std::thread &worker : workers)
+    worker.join();
+
+  if (spillFailed) {
+    std::println(stderr, "Could not write a run to {}", options.tempDirectory);
+    return 1;
+  }
+  if (!builder.write(output)) {
+    std::println(stderr, "Could not write {}", output);
+    return 1;
+  }
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::println("{} games counted, {} skipped, {} runs spilled, {:.1f}s",
+               builder.getGames(), builder.getSkipped(), builder.getRuns(),
+               elapsed.count());
+  return 0;
+}
@@ -0,0 +1,191 @@
+#include "PackedPosition.h"
+#include "Search.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <print>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct DatagenOptions {
+  uint64_t games = 1000;
+  uint64_t nodes = 5000;  // Per move
+  int randomPlies = 8;    // Random moves before the engine takes over
+  int maxPlies = 400;     // Longer games are called drawn
+  int scoreLimit = 2000;  // Positions scored beyond this end the game
+  size_t hashMegabytes = 16;
+  uint64_t seed = 1;
+};
+
+struct GameRecord {
+  PackedPosition position;
+  int16_t score;
+  Color sideToMove;
+};
+
+void printUsage() {
+  std::println("Usage: chess_datagen -o data.bin [-a] [-t threads] "
+               "[-g games] [-n nodes] [-r random-plies] [-H hash-mb] "
+               "[-s seed]");
+  std::println("Plays fixed-node self-play games from random openings and "
+               "writes every quiet position with its search score and the "
+               "game result. -a appends to an existing file.");
+}
+
+// Plays random legal moves from the start position; false if the game ended
+// before they were all played
+bool randomOpening(Position &pos, int plies, std::mt19937_64 &rng) {
+  pos.setStartPos();
+  for (int ply = 0; ply < plies; ply++) {
+    MoveList moves;
+    pos.generateLegalMoves(moves);
+    if (moves.size() == 0)
+      return false;
+    pos.makeMove(moves[rng() % moves.size()]);
+  }
+  MoveList moves;
+  pos.generateLegalMoves(moves);
+  return moves.size() > 0;
+}
+
+// Plays one game and returns the result for white: 1, 0 or -1
+int playGame(Search &search, const DatagenOptions &options,
+             std::mt19937_64 &rng, std::vector<GameRecord> &records) {
+  Position pos;
+  while (!randomOpening(pos, options.randomPlies, rng))
+    ;
+
+  SearchLimits limits;
+  limits.nodes = options.nodes;
+  search.clearHash();
+  records.clear();
+
+  for (int ply = 0; ply < options.maxPlies; ply++) {
+    MoveList moves;
+    pos.generateLegalMoves(moves);
+    if (moves.size() == 0)
+      return pos.inCheck() ? (pos.getSideToMove() == White ? -1 : 1) : 0;
+    if (pos.isDraw())
+      return 0;
+
+    int score = 0;
+    Move best = search.think(pos, limits, [&](const SearchInfo &info) {
+      score = info.score;
+    });
+
+    // A clear enough advantage is as good as the mate it leads to
+    if (std::abs(score) >= options.scoreLimit) {
+      Color winner = score > 0 ? pos.getSideToMove() : ~pos.getSideToMove();
+      return winner == White ? 1 : -1;
+    }
+
+    // Only quiet positions, whose score a static evaluation can learn
+    if (!pos.inCheck() && !pos.isCapture(best) &&
+        best.getFlag() != MoveFlag::Promotion) {
+      GameRecord record;
+      if (record.position.pack(pos)) {
+        record.score = static_cast<int16_t>(score);
+        record.sideToMove = pos.getSideToMove();
+        records.push_back(record);
+      }
+    }
+    pos.makeMove(best);
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  DatagenOptions options;
+  std::string output;
+  bool append = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-o" && i + 1 < argc)
+      output = argv[++i];
+    else if (arg == "-a")
+      append = true;
+    else if (arg == "-t" && i + 1 < argc)
+      threads = std::atoi(argv[++i]);
+    else if (arg == "-g" && i + 1 < argc)
+      options.games = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "-n" && i + 1 < argc)
+      options.nodes = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "-r" && i + 1 < argc)
+      options.randomPlies = std::atoi(argv[++i]);
+    else if (arg == "-H" && i + 1 < argc)
+      options.hashMegabytes = std::atoi(argv[++i]);
+    else if (arg == "-s" && i + 1 < argc)
+      options.seed = std::strtoull(argv[++i], nullptr, 10);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (output.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  PackedFile file;
+  if (!file.open(output, append)) {
+    std::println(stderr, "Could not open {}", output);
+    return 1;
+  }
+  uint64_t startRecords = file.getRecords();
+
+  threads = std::max(1u, threads);
+  std::atomic<uint64_t> nextGame{0};
+  std::atomic<uint64_t> results[3] = {0, 0, 0}; // Black win, draw, white win
+  std::atomic<bool> failed{false};
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++)
+    workers.emplace_back([&, t] {
+      Search search(options.hashMegabytes);
+      std::mt19937_64 rng(options.seed * 0x9E3779B97F4A7C15ULL + t);
+      PackedWriter writer(file);
+      std::vector<GameRecord> records;
+
+      while (nextGame.fetch_add(1) < options.games && !failed) {
+        int result = playGame(search, options, rng, records);
+        results[result + 1]++;
+        for (const GameRecord &record : records) {
+          int8_t forMover = record.sideToMove == White ? result : -result;
+          if (!writer.write({record.position, record.score, forMover}))
+            failed = true;
+        }
+      }
+      if (!writer.flush())
+        failed = true;
+    });
+  for (std::thread &worker : workers)
+    worker.join();
+
+  if (failed || !file.close()) {
+    std::println(stderr, "Could not write {}", output);
+    return 1;
+  }
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  double seconds = std::max(elapsed.count(), 1e-9);
+  uint64_t positions = file.getRecords() - startRecords;
+  std::println("{} games (+{} ={} -{}), {} positions", options.games,
+               results[2].load(), results[1].load(), results[0].load(),
+               positions);
+  std::println("{:.1f}s on {} threads, {:.0f} positions/s", seconds, threads,
+               positions / seconds);
+  return 0;
+}
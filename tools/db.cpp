@@ -0,0 +1,431 @@
+#include "Explorer.h"
+#include "GameArchive.h"
+#include "GameDatabase.h"
+#include "PgnPipeline.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void printUsage() {
+  std::println("Usage: chess_db build -o BASE [-t threads] [-p plies] "
+               "[-M megabytes] [-T temp-dir] FILE.pgn...");
+  std::println("       chess_db find BASE [-n count] FEN | startpos "
+               "[moves UCI...]");
+  std::println("       chess_db show BASE ID");
+  std::println("       chess_db explorer BASE [-p plies] [-m min-games] "
+               "[-M megabytes] [-T temp-dir]");
+  std::println("       chess_db stats BASE FEN | startpos [moves UCI...]");
+  std::println("       chess_db archive BASE [-b games-per-block] "
+               "[-t threads]");
+  std::println("build stores every legal game with 16-bit moves and indexes "
+               "the positions they reach; find lists the games that reached "
+               "a position; show prints one game. explorer sums the opening "
+               "moves of every game into BASE.explorer, which stats reads. archive "
+               "compresses the moves into BASE.archive and compares it with "
+               "the 16-bit store.");
+}
+
+std::string_view resultText(int8_t result) {
+  return result == 1    ? "1-0"
+         : result == -1 ? "0-1"
+         : result == 0  ? "1/2"
+                        : "*";
+}
+
+// yyyymmdd as written in PGN, unknown parts as question marks
+std::string dateText(uint32_t date) {
+  auto part = [](uint32_t value, int width) {
+    std::string digits = std::to_string(value);
+    if (!value)
+      return std::string(width, '?');
+    return std::string(width - std::min<int>(width, digits.size()), '0') +
+           digits;
+  };
+  return part(date / 10000, 4) + "." + part(date / 100 % 100, 2) + "." +
+         part(date % 100, 2);
+}
+
+std::string_view nameText(const char (&name)[22]) {
+  std::string_view text(name, sizeof(name));
+  text = text.substr(0, text.find('\0'));
+  return text.empty() ? "?" : text;
+}
+
+void printHeader(uint32_t id, const GameHeader &header) {
+  std::println("{:>9}  {}  {} ({}) - {} ({})  {}  {} plies", id,
+               dateText(header.date), nameText(header.white), header.whiteElo,
+               nameText(header.black), header.blackElo,
+               resultText(header.result), header.plies);
+}
+
+// A FEN or "startpos", optionally followed by "moves" and UCI moves
+bool parsePosition(const std::vector<std::string_view> &words,
+                   Position &pos) {
+  size_t i = 0;
+  if (!words.empty() && words[0] == "startpos") {
+    pos.setStartPos();
+    i = 1;
+  } else {
+    std::string fen;
+    for (; i < words.size() && words[i] != "moves"; i++)
+      fen += std::string(words[i]) + " ";
+    if (!pos.setFen(fen))
+      return false;
+  }
+  if (i < words.size() && words[i++] != "moves")
+    return false;
+
+  for (; i < words.size(); i++) {
+    MoveList moves;
+    pos.generateLegalMoves(moves);
+    auto found = std::find_if(moves.begin(), moves.end(),
+                              [&](Move m) { return m.toUci() == words[i]; });
+    if (found == moves.end())
+      return false;
+    pos.makeMove(*found);
+  }
+  return true;
+}
+
+int build(int argc, char **argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  GameDatabaseOptions options;
+  std::string output;
+  std::vector<std::string> inputs;
+
+  for (int i = 2; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-o" && i + 1 < argc)
+      output = argv[++i];
+    else if (arg == "-t" && i + 1 < argc)
+      threads = std::atoi(argv[++i]);
+    else if (arg == "-p" && i + 1 < argc)
+      options.maxPly = std::atoi(argv[++i]);
+    else if (arg == "-M" && i + 1 < argc)
+      options.memoryLimit = std::strtoull(argv[++i], nullptr, 10) << 20;
+    else if (arg == "-T" && i + 1 < argc)
+      options.tempDirectory = argv[++i];
+    else if (!arg.empty() && arg[0] != '-')
+      inputs.emplace_back(arg);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (output.empty() || inputs.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  GameDatabaseWriter writer(options);
+  if (!writer.open(output)) {
+    std::println(stderr, "Could not create {}", output);
+    return 1;
+  }
+
+  // Games are parsed and replayed on the workers and stored in file order
+  uint64_t skipped = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const std::string &input : inputs) {
+    MappedFile file;
+    if (!file.open(input)) {
+      std::println(stderr, "Could not open {}", input);
+      continue;
+    }
+    PgnPipeline pipeline(file.getView(), std::max(1u, threads));
+    PgnChunk chunk;
+    while (pipeline.next(chunk))
+      for (const ImportedGame &imported : chunk.games) {
+        if (!imported.legal) {
+          skipped++;
+          continue;
+        }
+        if (!writer.addGame(imported.game, imported.moves)) {
+          std::println(stderr, "Could not write {}", output);
+          return 1;
+        }
+      }
+  }
+
+  if (!writer.finish()) {
+    std::println(stderr, "Could not write the index of {}", output);
+    return 1;
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::println("{} games, {} moves, {} skipped, {} runs spilled, {:.1f}s",
+               writer.getGames(), writer.getMoves(), skipped,
+               writer.getRuns(), elapsed.count());
+  return 0;
+}
+
+int find(int argc, char **argv) {
+  size_t limit = 20;
+  std::vector<std::string_view> words;
+  for (int i = 3; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-n" && i + 1 < argc)
+      limit = std::strtoull(argv[++i], nullptr, 10);
+    else
+      words.push_back(arg);
+  }
+
+  Position pos;
+  if (argc < 3 || !parsePosition(words, pos)) {
+    printUsage();
+    return 1;
+  }
+
+  GameDatabase database;
+  if (!database.open(argv[2])) {
+    std::println(stderr, "Could not open the database {}", argv[2]);
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  GameIdList games = database.findGames(pos);
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::println("{} of {} games reach the position, found in {:.0f}us",
+               games.size(), database.size(), elapsed.count());
+  for (size_t i = 0; i < std::min(limit, games.size()); i++)
+    printHeader(games[i], database.getHeader(games[i]));
+  return 0;
+}
+
+int show(int argc, char **argv) {
+  if (argc != 4) {
+    printUsage();
+    return 1;
+  }
+  GameDatabase database;
+  if (!database.open(argv[2])) {
+    std::println(stderr, "Could not open the database {}", argv[2]);
+    return 1;
+  }
+  uint64_t id = std::strtoull(argv[3], nullptr, 10);
+  if (id >= database.size()) {
+    std::println(stderr, "There is no game {}", id);
+    return 1;
+  }
+
+  printHeader(id, database.getHeader(id));
+  std::vector<Move> moves;
+  database.getMoves(id, moves);
+  std::string line;
+  for (size_t ply = 0; ply < moves.size(); ply++) {
+    if (ply % 2 == 0)
+      line += std::to_string(ply / 2 + 1) + ". ";
+    line += moves[ply].toUci() + " ";
+  }
+  std::println("{}", line);
+  return 0;
+}
+
+int explorer(int argc, char **argv) {
+  ExplorerOptions options;
+  for (int i = 3; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-p" && i + 1 < argc)
+      options.maxPly = std::atoi(argv[++i]);
+    else if (arg == "-m" && i + 1 < argc)
+      options.minGames = std::atoi(argv[++i]);
+    else if (arg == "-M" && i + 1 < argc)
+      options.memoryLimit = std::strtoull(argv[++i], nullptr, 10) << 20;
+    else if (arg == "-T" && i + 1 < argc)
+      options.tempDirectory = argv[++i];
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (argc < 3) {
+    printUsage();
+    return 1;
+  }
+
+  GameDatabase database;
+  if (!database.open(argv[2])) {
+    std::println(stderr, "Could not open the database {}", argv[2]);
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  ExplorerBuilder builder(options);
+  std::vector<Move> moves;
+  std::string output = std::string(argv[2]) + ".explorer";
+  for (uint64_t id = 0; id < database.size(); id++) {
+    database.getMoves(id, moves);
+    if (!builder.addGame(database.getHeader(id), moves)) {
+      std::println(stderr, "Could not write a run to {}",
+                   options.tempDirectory);
+      return 1;
+    }
+  }
+  if (!builder.write(output)) {
+    std::println(stderr, "Could not write {}", output);
+    return 1;
+  }
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::println("{} games counted, {} without a result, {} runs spilled, "
+               "{:.1f}s",
+               builder.getGames(), builder.getSkipped(), builder.getRuns(),
+               elapsed.count());
+  return 0;
+}
+
+int stats(int argc, char **argv) {
+  std::vector<std::string_view> words(argv + std::min(argc, 3), argv + argc);
+  Position pos;
+  if (argc < 3 || !parsePosition(words, pos)) {
+    printUsage();
+    return 1;
+  }
+
+  OpeningExplorer explorer;
+  std::string path = std::string(argv[2]) + ".explorer";
+  if (!explorer.open(path)) {
+    std::println(stderr, "Could not open {}", path);
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<ExplorerMove> moves = explorer.probe(pos);
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  uint64_t total = 0;
+  for (const ExplorerMove &m : moves)
+    total += m.stats.getGames();
+  std::println("{} games from this position, found in {:.0f}us", total,
+               elapsed.count());
+  for (const ExplorerMove &m : moves) {
+    const ExplorerEntry &s = m.stats;
+    double games = s.getGames();
+    std::println("{:<6} {:>9} {:>5.1f}%  +{:.0f}% ={:.0f}% -{:.0f}%  "
+                 "score {:.1f}%  rating {}",
+                 m.move.toUci(), s.getGames(), 100 * games / total,
+                 100 * s.wins / games, 100 * s.draws / games,
+                 100 * s.losses / games, 100 * s.getScore(),
+                 s.getAverageRating());
+  }
+  return 0;
+}
+
+int archive(int argc, char **argv) {
+  GameArchiveOptions options;
+  options.threads = std::thread::hardware_concurrency();
+  for (int i = 3; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-b" && i + 1 < argc)
+      options.gamesPerBlock = std::atoi(argv[++i]);
+    else if (arg == "-t" && i + 1 < argc)
+      options.threads = std::atoi(argv[++i]);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (argc < 3) {
+    printUsage();
+    return 1;
+  }
+
+  GameDatabase database;
+  if (!database.open(argv[2])) {
+    std::println(stderr, "Could not open the database {}", argv[2]);
+    return 1;
+  }
+  std::string path = std::string(argv[2]) + ".archive";
+  auto start = std::chrono::steady_clock::now();
+  if (!writeGameArchive(database, path, options)) {
+    std::println(stderr, "Could not write {}", path);
+    return 1;
+  }
+  std::chrono::duration<double> writeTime =
+      std::chrono::steady_clock::now() - start;
+
+  GameArchive archive;
+  if (!archive.open(path)) {
+    std::println(stderr, "Could not read back {}", path);
+    return 1;
+  }
+
+  // Plain reads of the 16-bit moves against decoding every block
+  std::vector<Move> moves, decoded;
+  std::vector<uint32_t> ends;
+  uint64_t plies = 0;
+  start = std::chrono::steady_clock::now();
+  for (uint64_t id = 0; id < database.size(); id++) {
+    database.getMoves(id, moves);
+    plies += moves.size();
+  }
+  std::chrono::duration<double> plainTime =
+      std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t block = 0; block < archive.getBlocks(); block++)
+    if (!archive.decodeBlock(block, decoded, ends)) {
+      std::println(stderr, "Block {} does not decode", block);
+      return 1;
+    }
+  std::chrono::duration<double> decodeTime =
+      std::chrono::steady_clock::now() - start;
+
+  // Every game must come back exactly
+  for (uint64_t id = 0, block = 0; block < archive.getBlocks(); block++) {
+    archive.decodeBlock(block, decoded, ends);
+    for (size_t game = 0, begin = 0; game < ends.size(); game++, id++) {
+      database.getMoves(id, moves);
+      if (!std::equal(moves.begin(), moves.end(), decoded.begin() + begin,
+                      decoded.begin() + ends[game])) {
+        std::println(stderr, "Game {} does not round-trip", id);
+        return 1;
+      }
+      begin = ends[game];
+    }
+  }
+
+  double moveCount = std::max<uint64_t>(plies, 1);
+  std::println("{} games, {} moves, written in {:.1f}s", database.size(),
+               plies, writeTime.count());
+  std::println("16-bit moves: {:.3f} bytes/move, {:.0f} moves/s", 2.0,
+               plies / std::max(plainTime.count(), 1e-9));
+  std::println("archive:      {:.3f} bytes/move, {:.0f} moves/s decoded, "
+               "{} blocks",
+               archive.getBytes() / moveCount,
+               plies / std::max(decodeTime.count(), 1e-9),
+               archive.getBlocks());
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string_view mode = argc > 1 ? argv[1] : "";
+  if (mode == "build")
+    return build(argc, argv);
+  if (mode == "find")
+    return find(argc, argv);
+  if (mode == "show")
+    return show(argc, argv);
+  if (mode == "explorer")
+    return explorer(argc, argv);
+  if (mode == "stats")
+    return stats(argc, argv);
+  if (mode == "archive")
+    return archive(argc, argv);
+  printUsage();
+  return 1;
+}
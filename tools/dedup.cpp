@@ -0,0 +1,323 @@
+#include "BloomFilter.h"
+#include "PackedPosition.h"
+#include "SortedRuns.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct DedupOptions {
+  size_t bloomBits = 16;                // Filter bits per input position
+  size_t memoryLimit = size_t{1} << 30; // Bytes of sort buffers in memory
+  std::string tempDirectory = ".";
+};
+
+// Records of every input file under one global index
+class Inputs {
+private:
+  std::vector<PackedReader> readers;
+  std::vector<uint64_t> starts{0};
+
+public:
+  bool open(const std::vector<std::string> &paths) {
+    readers = std::vector<PackedReader>(paths.size());
+    for (size_t f = 0; f < paths.size(); f++) {
+      if (!readers[f].open(paths[f])) {
+        std::println(stderr, "Could not read {}", paths[f]);
+        return false;
+      }
+      starts.push_back(starts.back() + readers[f].size());
+    }
+    return true;
+  }
+
+  uint64_t size() const { return starts.back(); }
+
+  PackedRecord get(size_t file, uint64_t index) const {
+    return readers[file].get(index - starts[file]);
+  }
+  size_t fileOf(uint64_t index) const {
+    return std::upper_bound(starts.begin(), starts.end(), index) -
+           starts.begin() - 1;
+  }
+  uint64_t fileEnd(size_t file) const { return starts[file + 1]; }
+  uint64_t fileBegin(size_t file) const { return starts[file]; }
+};
+
+// Runs work(thread, file, begin, end) over every index in chunks that stay
+// within one file
+template <typename Work>
+void parallelChunks(const Inputs &inputs, unsigned threads, Work &&work) {
+  constexpr uint64_t Chunk = 1 << 16;
+  std::atomic<uint64_t> next{0};
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++)
+    workers.emplace_back([&, t] {
+      for (uint64_t begin; (begin = next.fetch_add(Chunk)) < inputs.size();) {
+        uint64_t end = std::min(begin + Chunk, inputs.size());
+        for (uint64_t first = begin; first < end;) {
+          size_t file = inputs.fileOf(first);
+          uint64_t last = std::min(end, inputs.fileEnd(file));
+          work(t, file, first, last);
+          first = last;
+        }
+      }
+    });
+  for (std::thread &worker : workers)
+    worker.join();
+}
+
+struct KeyIndex {
+  uint64_t key;
+  uint64_t index;
+  bool operator<(const KeyIndex &other) const {
+    return key != other.key ? key < other.key : index < other.index;
+  }
+};
+
+// Runs hold KeyIndex entries as they are in memory
+struct KeyIndexFormat {
+  using Record = KeyIndex;
+  static constexpr size_t Size = sizeof(KeyIndex);
+
+  static void store(const KeyIndex &entry, uint8_t *out) {
+    std::memcpy(out, &entry, Size);
+  }
+  static KeyIndex load(const uint8_t *in) {
+    KeyIndex entry;
+    std::memcpy(&entry, in, Size);
+    return entry;
+  }
+};
+
+// Sorted runs of (key, index) pairs, written by any thread and merged in
+// order
+class RunSet {
+private:
+  const DedupOptions &options;
+  std::string name;
+  std::mutex mutex;
+  std::vector<std::string> runs;
+  uint64_t entries = 0;
+
+public:
+  RunSet(const DedupOptions &options, std::string name)
+      : options(options), name(std::move(name)) {}
+  RunSet(const RunSet &) = delete;
+  RunSet &operator=(const RunSet &) = delete;
+  ~RunSet() {
+    for (const std::string &run : runs)
+      std::remove(run.c_str());
+  }
+
+  // Sorts buffer, writes it as a new run and empties it
+  bool spill(std::vector<KeyIndex> &buffer) {
+    if (buffer.empty())
+      return true;
+    std::string path;
+    {
+      std::lock_guard lock(mutex);
+      path = options.tempDirectory + "/dedup-" + std::to_string(getpid()) +
+             "-" + name + "-" + std::to_string(runs.size()) + ".run";
+      runs.push_back(path);
+      entries += buffer.size();
+    }
+    bool written = writeSortedRun<KeyIndexFormat>(path, buffer);
+    buffer.clear();
+    return written;
+  }
+
+  uint64_t getEntries() const { return entries; }
+  size_t getRuns() const { return runs.size(); }
+
+  // Calls visit(entry) for every entry in sorted order
+  template <typename Visit> bool merge(Visit &&visit) {
+    return mergeRuns<KeyIndexFormat>(runs, visit);
+  }
+};
+
+// One bit per input position, set from any thread
+class AtomicBitmap {
+private:
+  std::unique_ptr<std::atomic<uint64_t>[]> words;
+
+public:
+  explicit AtomicBitmap(uint64_t bits)
+      : words(std::make_unique<std::atomic<uint64_t>[]>(bits / 64 + 1)) {}
+  void set(uint64_t i) {
+    words[i / 64].fetch_or(uint64_t{1} << (i % 64), std::memory_order_relaxed);
+  }
+  bool test(uint64_t i) const {
+    return words[i / 64].load(std::memory_order_relaxed) >> (i % 64) & 1;
+  }
+};
+
+void printUsage() {
+  std::println("Usage: chess_dedup -o out.bin [-t threads] [-B bits] "
+               "[-M megabytes] [-T temp-dir] DATA.bin...");
+  std::println("Writes the first record of every distinct position, in "
+               "input order. A Bloom filter of -B bits per record finds the "
+               "positions that may repeat; only those are sorted on disk "
+               "to settle them exactly.");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  DedupOptions options;
+  std::string output;
+  std::vector<std::string> paths;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-o" && i + 1 < argc)
+      output = argv[++i];
+    else if (arg == "-t" && i + 1 < argc)
+      threads = std::atoi(argv[++i]);
+    else if (arg == "-B" && i + 1 < argc)
+      options.bloomBits = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "-M" && i + 1 < argc)
+      options.memoryLimit = std::strtoull(argv[++i], nullptr, 10) << 20;
+    else if (arg == "-T" && i + 1 < argc)
+      options.tempDirectory = argv[++i];
+    else if (!arg.empty() && arg[0] != '-')
+      paths.emplace_back(arg);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (output.empty() || paths.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  Inputs inputs;
+  if (!inputs.open(paths))
+    return 1;
+  threads = std::max(1u, threads);
+  uint64_t total = inputs.size();
+  size_t bufferEntries =
+      std::max<size_t>(options.memoryLimit / threads / sizeof(KeyIndex), 1024);
+  std::atomic<bool> failed{false};
+  auto start = std::chrono::steady_clock::now();
+  auto lap = [&] {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+  };
+
+  // Pass 1: a key whose filter bits were all set already may repeat. Every
+  // repeat of a key is caught this way, since the filter never forgets.
+  BloomFilter seen(std::max<uint64_t>(total, 1) * options.bloomBits);
+  AtomicBitmap dropped(total);
+  std::atomic<uint64_t> invalid{0};
+  RunSet flagged(options, "flagged");
+  std::vector<std::vector<KeyIndex>> buffers(threads);
+  auto spillAll = [&](RunSet &runs) {
+    for (std::vector<KeyIndex> &buffer : buffers)
+      if (!runs.spill(buffer))
+        failed = true;
+  };
+  parallelChunks(inputs, threads, [&](unsigned thread, size_t file,
+                                      uint64_t begin, uint64_t end) {
+    std::vector<KeyIndex> &buffer = buffers[thread];
+    Position pos;
+    for (uint64_t i = begin; i < end; i++) {
+      if (!inputs.get(file, i).position.unpack(pos)) {
+        dropped.set(i);
+        invalid++;
+      } else if (seen.insert(pos.getKey())) {
+        buffer.push_back({pos.getKey(), i});
+      }
+    }
+    if (buffer.size() >= bufferEntries && !flagged.spill(buffer))
+      failed = true;
+  });
+  spillAll(flagged);
+  double filterTime = lap();
+
+  // The flagged keys, some of them false positives, go into a second filter
+  // sized for them alone
+  BloomFilter repeated(std::max<uint64_t>(flagged.getEntries(), 1) *
+                       options.bloomBits);
+  auto remember = [&](const KeyIndex &entry) { repeated.insert(entry.key); };
+  if (!flagged.merge(remember))
+    failed = true;
+
+  // Pass 2: every record of a flagged key, first occurrences included, is
+  // sorted by key to find which copy comes first
+  RunSet candidates(options, "candidates");
+  parallelChunks(inputs, threads, [&](unsigned thread, size_t file,
+                                      uint64_t begin, uint64_t end) {
+    std::vector<KeyIndex> &buffer = buffers[thread];
+    Position pos;
+    for (uint64_t i = begin; i < end; i++)
+      if (!dropped.test(i) && inputs.get(file, i).position.unpack(pos) &&
+          repeated.mayContain(pos.getKey()))
+        buffer.push_back({pos.getKey(), i});
+    if (buffer.size() >= bufferEntries && !candidates.spill(buffer))
+      failed = true;
+  });
+  spillAll(candidates);
+
+  uint64_t duplicates = 0;
+  uint64_t lastKey = 0;
+  bool any = false;
+  if (!candidates.merge([&](const KeyIndex &entry) {
+        if (any && entry.key == lastKey) {
+          dropped.set(entry.index);
+          duplicates++;
+        }
+        lastKey = entry.key;
+        any = true;
+      }))
+    failed = true;
+  double exactTime = lap() - filterTime;
+
+  // Pass 3: copy what is left in input order
+  PackedFile file;
+  if (failed || !file.open(output)) {
+    std::println(stderr, "Could not write {}", failed ? "a sort run" : output);
+    return 1;
+  }
+  {
+    PackedWriter writer(file);
+    for (size_t f = 0; f < paths.size(); f++)
+      for (uint64_t i = inputs.fileBegin(f); i < inputs.fileEnd(f) && !failed;
+           i++)
+        if (!dropped.test(i) && !writer.write(inputs.get(f, i)))
+          failed = true;
+    if (!writer.flush())
+      failed = true;
+  }
+  if (failed || !file.close()) {
+    std::println(stderr, "Could not write {}", output);
+    return 1;
+  }
+
+  double seconds = std::max(lap(), 1e-9);
+  std::println("{} positions, {} unique, {} duplicates, {} invalid", total,
+               total - duplicates - invalid, duplicates, invalid.load());
+  std::println("filter: {} MB, {} flagged, {} sorted exactly in {} runs",
+               seen.getBytes() >> 20, flagged.getEntries(),
+               candidates.getEntries(), candidates.getRuns());
+  std::println("{:.1f}s on {} threads (filter {:.1f}s, exact pass {:.1f}s), "
+               "{:.0f} positions/s",
+               seconds, threads, filterTime, exactTime, total / seconds);
+  return 0;
+}
@@ -0,0 +1,237 @@
+#include "Pgn.h"
+#include "Search.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct TestPosition {
+  std::string id;
+  Position pos;
+  std::vector<Move> best;  // bm: any of these solves it
+  std::vector<Move> avoid; // am: anything but these solves it
+};
+
+struct TestResult {
+  Move played;
+  bool solved = false;
+  int64_t solvedMs = -1; // Iteration after which the answer stayed right
+  uint64_t nodes = 0;
+};
+
+void printUsage() {
+  std::println("Usage: chess_epd [-t threads] [-d depth] [-n nodes] "
+               "[-m movetime-ms] [-H hash-mb] [-v] FILE.epd...");
+  std::println("Searches every position with bm or am operations and "
+               "reports how many are solved. Without limits each position "
+               "gets one second.");
+}
+
+std::string_view trim(std::string_view text) {
+  while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+    text.remove_prefix(1);
+  while (!text.empty() && (text.back() == ' ' || text.back() == '\t' ||
+                           text.back() == '\r'))
+    text.remove_suffix(1);
+  return text;
+}
+
+// A move written as SAN, or failing that as UCI
+Move parseTestMove(const Position &pos, std::string_view text) {
+  Move m = parseSan(pos, text);
+  if (!m.isNull())
+    return m;
+  MoveList moves;
+  pos.generateLegalMoves(moves);
+  for (Move legal : moves)
+    if (legal.toUci() == text)
+      return legal;
+  return Move();
+}
+
+// Reads the four position fields, then operations separated by semicolons
+bool parseEpd(std::string_view line, TestPosition &test) {
+  if (!test.pos.setFen(line))
+    return false;
+
+  size_t i = 0;
+  for (int field = 0; field < 4; field++) {
+    i = line.find_first_not_of(" \t", i);
+    i = line.find_first_of(" \t", i);
+    if (i == std::string_view::npos)
+      return false;
+  }
+  std::string_view operations = line.substr(i);
+
+  while (!operations.empty()) {
+    size_t end = 0;
+    bool quoted = false;
+    while (end < operations.size() && (quoted || operations[end] != ';'))
+      quoted ^= operations[end++] == '"';
+    std::string_view operation = trim(operations.substr(0, end));
+    operations.remove_prefix(std::min(end + 1, operations.size()));
+
+    size_t split = operation.find_first_of(" \t");
+    if (split == std::string_view::npos)
+      continue;
+    std::string_view opcode = operation.substr(0, split);
+    std::string_view operands = trim(operation.substr(split));
+
+    if (opcode == "id") {
+      if (operands.size() >= 2 && operands.front() == '"')
+        operands = operands.substr(1, operands.size() - 2);
+      test.id = operands;
+    } else if (opcode == "bm" || opcode == "am") {
+      std::vector<Move> &moves = opcode == "bm" ? test.best : test.avoid;
+      while (!operands.empty()) {
+        size_t space = operands.find_first_of(" \t");
+        Move m = parseTestMove(test.pos, operands.substr(0, space));
+        if (m.isNull())
+          return false;
+        moves.push_back(m);
+        operands = space == std::string_view::npos
+                       ? std::string_view()
+                       : trim(operands.substr(space));
+      }
+    }
+  }
+  return !test.best.empty() || !test.avoid.empty();
+}
+
+bool isSolution(const TestPosition &test, Move m) {
+  if (!test.best.empty() &&
+      std::find(test.best.begin(), test.best.end(), m) == test.best.end())
+    return false;
+  return std::find(test.avoid.begin(), test.avoid.end(), m) ==
+         test.avoid.end();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  SearchLimits limits;
+  size_t hashMegabytes = 16;
+  bool verbose = false;
+  std::vector<std::string> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-t" && i + 1 < argc)
+      threads = std::atoi(argv[++i]);
+    else if (arg == "-d" && i + 1 < argc)
+      limits.depth = std::atoi(argv[++i]);
+    else if (arg == "-n" && i + 1 < argc)
+      limits.nodes = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "-m" && i + 1 < argc)
+      limits.moveTimeMs = std::atoll(argv[++i]);
+    else if (arg == "-H" && i + 1 < argc)
+      hashMegabytes = std::atoi(argv[++i]);
+    else if (arg == "-v")
+      verbose = true;
+    else if (!arg.empty() && arg[0] != '-')
+      inputs.emplace_back(arg);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (inputs.empty()) {
+    printUsage();
+    return 1;
+  }
+  if (limits.depth == MaxPly - 1 && !limits.nodes && !limits.moveTimeMs)
+    limits.moveTimeMs = 1000;
+
+  std::vector<TestPosition> tests;
+  for (const std::string &input : inputs) {
+    std::ifstream file(input);
+    if (!file) {
+      std::println(stderr, "Could not open {}", input);
+      continue;
+    }
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+      std::string_view text = trim(line);
+      if (text.empty() || text[0] == '#')
+        continue;
+      TestPosition test;
+      if (!parseEpd(text, test)) {
+        std::println(stderr, "{}:{}: skipped, no usable bm or am", input,
+                     number);
+        continue;
+      }
+      if (test.id.empty())
+        test.id = input + ":" + std::to_string(number);
+      tests.push_back(std::move(test));
+    }
+  }
+
+  // One position at a time per worker, each with its own search
+  threads = std::max<unsigned>(1, std::min<size_t>(threads, tests.size()));
+  std::vector<TestResult> results(tests.size());
+  std::atomic<size_t> next{0};
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++)
+    workers.emplace_back([&] {
+      Search search(hashMegabytes);
+      for (size_t i; (i = next.fetch_add(1)) < tests.size();) {
+        const TestPosition &test = tests[i];
+        TestResult &result = results[i];
+        search.clearHash();
+
+        result.played = search.think(
+            test.pos, limits, [&](const SearchInfo &info) {
+              bool right = !info.pv.empty() && isSolution(test, info.pv[0]);
+              if (!right)
+                result.solvedMs = -1;
+              else if (result.solvedMs < 0)
+                result.solvedMs = info.elapsedMs;
+            });
+        result.solved = !result.played.isNull() &&
+                        isSolution(test, result.played);
+        if (!result.solved)
+          result.solvedMs = -1;
+        result.nodes = search.getNodes();
+      }
+    });
+  for (std::thread &worker : workers)
+    worker.join();
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  size_t solved = 0;
+  uint64_t nodes = 0;
+  int64_t solveTime = 0;
+  for (size_t i = 0; i < tests.size(); i++) {
+    const TestResult &result = results[i];
+    nodes += result.nodes;
+    if (result.solved) {
+      solved++;
+      solveTime += result.solvedMs;
+    }
+    if (verbose)
+      std::println("{:<24} {:<6} {:>4} {:>8}ms {:>12} nodes", tests[i].id,
+                   result.played.toUci(), result.solved ? "ok" : "--",
+                   result.solvedMs, result.nodes);
+  }
+
+  double seconds = std::max(elapsed.count(), 1e-9);
+  std::println("{} of {} solved, {:.0f}ms average time to solution", solved,
+               tests.size(), solved ? double(solveTime) / solved : 0.0);
+  std::println("{} nodes in {:.2f}s on {} threads, {:.0f} nodes/s", nodes,
+               seconds, threads, nodes / seconds);
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include "BatchEvaluator.h"
+#include "Nnue.h"
+#include "PackedPosition.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void printUsage() {
+  std::println("Usage: chess_evalbench [-t max-threads] [-n positions] "
+               "[-r repeats] [-e network] DATA.bin...");
+  std::println("Evaluates the positions of the datasets in batches on 1, 2, "
+               "4... up to max-threads threads and reports positions per "
+               "second for each.");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned maxThreads = std::thread::hardware_concurrency();
+  size_t limit = 1000000;
+  int repeats = 3;
+  std::string network;
+  std::vector<std::string> paths;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-t" && i + 1 < argc)
+      maxThreads = std::atoi(argv[++i]);
+    else if (arg == "-n" && i + 1 < argc)
+      limit = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "-r" && i + 1 < argc)
+      repeats = std::atoi(argv[++i]);
+    else if (arg == "-e" && i + 1 < argc)
+      network = argv[++i];
+    else if (!arg.empty() && arg[0] != '-')
+      paths.emplace_back(arg);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (paths.empty()) {
+    printUsage();
+    return 1;
+  }
+  if (!network.empty() && !Nnue::loadNetwork(network)) {
+    std::println(stderr, "Could not load network {}", network);
+    return 1;
+  }
+
+  std::vector<PackedPosition> positions;
+  for (const std::string &path : paths) {
+    PackedReader reader;
+    if (!reader.open(path)) {
+      std::println(stderr, "Could not open {}", path);
+      return 1;
+    }
+    for (size_t i = 0; i < reader.size() && positions.size() < limit; i++)
+      positions.push_back(reader.get(i).position);
+  }
+  if (positions.empty()) {
+    std::println(stderr, "No positions");
+    return 1;
+  }
+
+  maxThreads = std::max(1u, maxThreads);
+  repeats = std::max(1, repeats);
+  std::vector<int> scores(positions.size());
+  double baseline = 0;
+  std::println("{} positions, {} evaluation", positions.size(),
+               network.empty() ? "piece-square" : "network");
+  for (unsigned threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+    BatchEvaluator evaluator(threads);
+    // The first pass fills the material caches
+    size_t unpacked = evaluator.evaluate(positions, scores);
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++)
+      evaluator.evaluate(positions, scores);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    double rate = double(positions.size()) * repeats / elapsed.count();
+    if (threads == 1)
+      baseline = rate;
+    std::println("{:>3} threads {:>12.0f} positions/s {:>6.2f}x", threads,
+                 rate, rate / baseline);
+    if (threads == 1 && unpacked != positions.size())
+      std::println("    {} positions did not unpack",
+                   positions.size() - unpacked);
+    if (threads == maxThreads)
+      break;
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+#include "MappedFile.h"
+#include "PgnPipeline.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void printUsage() {
+  std::println("Usage: chess_pgn [-t threads] [-c chunk-kilobytes] [-n] "
+               "FILE.pgn...");
+  std::println("Parses every game and replays its moves, then reports "
+               "throughput. -n only splits the text into games on one "
+               "thread.");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  size_t chunkBytes = size_t{1} << 20;
+  bool replay = true;
+  std::vector<std::string> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-t" && i + 1 < argc)
+      threads = std::atoi(argv[++i]);
+    else if (arg == "-c" && i + 1 < argc)
+      chunkBytes = std::strtoull(argv[++i], nullptr, 10) << 10;
+    else if (arg == "-n")
+      replay = false;
+    else if (!arg.empty() && arg[0] != '-')
+      inputs.emplace_back(arg);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (inputs.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  uint64_t games = 0, plies = 0, bad = 0, bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  for (const std::string &input : inputs) {
+    MappedFile file;
+    if (!file.open(input)) {
+      std::println(stderr, "Could not open {}", input);
+      continue;
+    }
+    bytes += file.size();
+
+    if (!replay) {
+      PgnParser parser(file.getView());
+      PgnGame game;
+      while (parser.next(game)) {
+        games++;
+        plies += game.moves.size();
+      }
+      continue;
+    }
+
+    PgnPipeline pipeline(file.getView(), threads, chunkBytes);
+    PgnChunk chunk;
+    while (pipeline.next(chunk))
+      for (const ImportedGame &imported : chunk.games) {
+        games++;
+        plies += imported.moves.size();
+        bad += !imported.legal;
+      }
+  }
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  double seconds = std::max(elapsed.count(), 1e-9);
+  std::println("{} games, {} plies, {} not replayed", games, plies, bad);
+  std::println("{:.2f}s, {:.0f} games/s, {:.1f} MB/s", seconds,
+               games / seconds, bytes / seconds / (1 << 20));
+  return 0;
+}
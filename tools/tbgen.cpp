@@ -0,0 +1,131 @@
+#include "Bitbase.h"
+#include "TablebaseGenerator.h"
+#include <chrono>
+#include <cstdlib>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void printUsage() {
+  std::println("Usage: chess_tbgen [-t threads] [-o directory] SIGNATURE...");
+  std::println("       chess_tbgen --verify-kpk");
+  std::println("Builds endgame tables such as KQK, KRK, KPK or KRPKR, plus");
+  std::println("every smaller table they convert into.");
+}
+
+// Compares the compiled-in KPK bitbase with a freshly generated table, from
+// both colours' point of view
+int verifyKPK(unsigned threads) {
+  TablebaseGenerator generator(threads);
+  MaterialSignature signature = *MaterialSignature::parse("KPK");
+  TablebaseLayout layout(signature);
+  const std::vector<uint8_t> &values = generator.generate(signature);
+
+  Position pos;
+  uint64_t checked = 0, mismatches = 0;
+  for (uint64_t idx = 0; idx < layout.getSize(); idx++) {
+    if (!layout.decode(idx, pos))
+      continue;
+
+    Color stm = pos.getSideToMove();
+    bool wins = stm == White ? TbValue::isWin(values[idx])
+                             : TbValue::isLoss(values[idx]);
+    int king = pos.getKingSquare(White);
+    int pawn = lsb(pos.getPieces(White, PieceType::Pawn));
+    int defender = pos.getKingSquare(Black);
+
+    for (bool flipped : {false, true}) {
+      auto view = [&](int square) {
+        return flipped ? flipRank(square) : square;
+      };
+      Color strong = flipped ? Black : White;
+      Color toMove = flipped ? ~stm : stm;
+      if (Bitbases::probeKPK(strong, view(king), view(pawn), view(defender),
+                             toMove) != wins) {
+        if (mismatches++ < 10)
+          std::println("Mismatch at index {}{}", idx,
+                       flipped ? " (colours flipped)" : "");
+      }
+      checked++;
+    }
+  }
+
+  std::println("KPK bitbase: {} positions checked, {} mismatches", checked,
+               mismatches);
+  return mismatches ? 1 : 0;
+}
+
+void printSummary(const MaterialSignature &signature,
+                  const std::vector<uint8_t> &values) {
+  uint64_t wins = 0, losses = 0, draws = 0;
+  int longest = 0;
+  for (uint8_t value : values) {
+    if (TbValue::isWin(value))
+      wins++;
+    else if (TbValue::isLoss(value))
+      losses++;
+    else
+      draws++;
+    longest = std::max(longest, TbValue::plies(value));
+  }
+  std::println("{:<8} {:>12} entries  {:>11} won  {:>11} lost  {:>11} "
+               "drawn/invalid  longest mate {} plies",
+               signature.getName(), values.size(), wins, losses, draws,
+               longest);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  std::string directory = ".";
+  std::vector<MaterialSignature> requested;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-t" && i + 1 < argc)
+      threads = std::atoi(argv[++i]);
+    else if (arg == "-o" && i + 1 < argc)
+      directory = argv[++i];
+    else if (arg == "--verify-kpk")
+      return verifyKPK(threads);
+    else if (auto signature = MaterialSignature::parse(arg);
+             signature && signature->getPieceCount() <= 5)
+      requested.push_back(*signature);
+    else {
+      std::println(stderr, "Unknown argument or unsupported material: {}",
+                   arg);
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (requested.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  TablebaseGenerator generator(threads);
+  auto start = std::chrono::steady_clock::now();
+  for (const MaterialSignature &signature : requested)
+    generator.generate(signature);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  for (const MaterialSignature &signature : generator.getGenerated()) {
+    printSummary(signature, generator.generate(signature));
+    if (!generator.write(signature, directory)) {
+      std::println(stderr, "Could not write {} to {}", signature.getName(),
+                   directory);
+      return 1;
+    }
+  }
+
+  std::println("Generated {} tables in {:.1f}s on {} threads",
+               generator.getGenerated().size(), elapsed.count(), threads);
+  return 0;
+}
@@ -0,0 +1,476 @@
+#include "Nnue.h"
+#include "PackedPosition.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <print>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define TRAIN_AVX2 1
+#endif
+
+namespace {
+
+struct TrainOptions {
+  int hidden = 128;
+  int epochs = 10;
+  size_t batch = 16384;
+  float rate = 0.001f;
+  float lambda = 0.5f; // Weight of the game result against the search score
+  uint64_t seed = 1;
+};
+
+// Clipped so that 32 pieces' worth of quantised input weights cannot
+// overflow an int16 accumulator
+constexpr float InputWeightLimit = 1.98f;
+constexpr float OutputWeightLimit = 32767.0f / Nnue::QB;
+
+// Float weights in the evaluator's layout. Output units are OutputScale
+// centipawns, and the hidden activations clip to [0, 1].
+struct FloatNetwork {
+  int hidden;
+  std::vector<float> inputWeights; // [Inputs][hidden]
+  std::vector<float> hiddenBias;
+  std::vector<float> outputWeights; // [2][hidden], side to move first
+  float outputBias = 0;
+
+  explicit FloatNetwork(int hidden)
+      : hidden(hidden), inputWeights(size_t(Nnue::Inputs) * hidden),
+        hiddenBias(hidden), outputWeights(2 * hidden) {}
+};
+
+// A minibatch's gradient as summed by one thread. Only the input rows of
+// features that occur are touched, and only those are cleared afterwards.
+struct Gradient {
+  std::vector<float> inputWeights;
+  std::vector<uint8_t> touched; // Per input row
+  std::vector<float> hiddenBias;
+  std::vector<float> outputWeights;
+  float outputBias = 0;
+  double loss = 0;
+
+  explicit Gradient(int hidden)
+      : inputWeights(size_t(Nnue::Inputs) * hidden), touched(Nnue::Inputs),
+        hiddenBias(hidden), outputWeights(2 * hidden) {}
+};
+
+// Adam state for every weight, in the same order as FloatNetwork
+struct Moments {
+  std::vector<float> m, v;
+  explicit Moments(size_t size) : m(size), v(size) {}
+};
+
+// Dense kernels over one hidden layer; the size is a multiple of 16
+
+void addRowScalar(float *values, const float *row, int n) {
+  for (int i = 0; i < n; i++)
+    values[i] += row[i];
+}
+
+float dotClippedScalar(const float *values, const float *weights, int n) {
+  float sum = 0;
+  for (int i = 0; i < n; i++)
+    sum += std::clamp(values[i], 0.0f, 1.0f) * weights[i];
+  return sum;
+}
+
+// gradient += slope * clip(values); delta = slope * weights where the
+// activation is not clipped
+void backwardScalar(const float *values, const float *weights, float slope,
+                    float *gradient, float *delta, int n) {
+  for (int i = 0; i < n; i++) {
+    gradient[i] += slope * std::clamp(values[i], 0.0f, 1.0f);
+    delta[i] = values[i] > 0 && values[i] < 1 ? slope * weights[i] : 0;
+  }
+}
+
+#ifdef TRAIN_AVX2
+__attribute__((target("avx2,fma"))) void
+addRowAvx2(float *values, const float *row, int n) {
+  for (int i = 0; i < n; i += 8)
+    _mm256_storeu_ps(values + i, _mm256_add_ps(_mm256_loadu_ps(values + i),
+                                               _mm256_loadu_ps(row + i)));
+}
+
+__attribute__((target("avx2,fma"))) float
+dotClippedAvx2(const float *values, const float *weights, int n) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1);
+  __m256 sum0 = zero, sum1 = zero;
+  for (int i = 0; i < n; i += 16) {
+    __m256 a =
+        _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(values + i), zero), one);
+    __m256 b = _mm256_min_ps(
+        _mm256_max_ps(_mm256_loadu_ps(values + i + 8), zero), one);
+    sum0 = _mm256_fmadd_ps(a, _mm256_loadu_ps(weights + i), sum0);
+    sum1 = _mm256_fmadd_ps(b, _mm256_loadu_ps(weights + i + 8), sum1);
+  }
+  __m256 sum = _mm256_add_ps(sum0, sum1);
+  __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum),
+                           _mm256_extractf128_ps(sum, 1));
+  half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_add_ss(half, _mm_movehdup_ps(half));
+  return _mm_cvtss_f32(half);
+}
+
+__attribute__((target("avx2,fma"))) void
+backwardAvx2(const float *values, const float *weights, float slope,
+             float *gradient, float *delta, int n) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1);
+  const __m256 s = _mm256_set1_ps(slope);
+  for (int i = 0; i < n; i += 8) {
+    __m256 v = _mm256_loadu_ps(values + i);
+    __m256 clipped = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+    _mm256_storeu_ps(gradient + i,
+                     _mm256_fmadd_ps(s, clipped, _mm256_loadu_ps(gradient + i)));
+    __m256 active = _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GT_OQ),
+                                  _mm256_cmp_ps(v, one, _CMP_LT_OQ));
+    _mm256_storeu_ps(
+        delta + i,
+        _mm256_and_ps(active, _mm256_mul_ps(s, _mm256_loadu_ps(weights + i))));
+  }
+}
+
+const bool hasAvx2 =
+    __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+
+void addRow(float *values, const float *row, int n) {
+#ifdef TRAIN_AVX2
+  if (hasAvx2)
+    return addRowAvx2(values, row, n);
+#endif
+  addRowScalar(values, row, n);
+}
+
+float dotClipped(const float *values, const float *weights, int n) {
+#ifdef TRAIN_AVX2
+  if (hasAvx2)
+    return dotClippedAvx2(values, weights, n);
+#endif
+  return dotClippedScalar(values, weights, n);
+}
+
+void backward(const float *values, const float *weights, float slope,
+              float *gradient, float *delta, int n) {
+#ifdef TRAIN_AVX2
+  if (hasAvx2)
+    return backwardAvx2(values, weights, slope, gradient, delta, n);
+#endif
+  backwardScalar(values, weights, slope, gradient, delta, n);
+}
+
+float sigmoid(float x) { return 1 / (1 + std::exp(-x)); }
+
+// Active inputs of both perspectives, side to move first
+struct Features {
+  int count = 0;
+  int index[2][32];
+};
+
+void extractFeatures(const PackedPosition &position, Features &features) {
+  Color stm = position.getSideToMove();
+  features.count = 0;
+  position.forEachPiece([&](int sq, int piece) {
+    features.index[0][features.count] = Nnue::featureIndex(stm, piece, sq);
+    features.index[1][features.count] = Nnue::featureIndex(~stm, piece, sq);
+    features.count++;
+  });
+}
+
+// Output of the float network, with the accumulators left in values
+float forward(const FloatNetwork &net, const Features &features,
+              float *values) {
+  int h = net.hidden;
+  for (int side = 0; side < 2; side++) {
+    float *acc = values + side * h;
+    std::copy(net.hiddenBias.begin(), net.hiddenBias.end(), acc);
+    for (int i = 0; i < features.count; i++)
+      addRow(acc, &net.inputWeights[size_t(features.index[side][i]) * h], h);
+  }
+  return net.outputBias + dotClipped(values, &net.outputWeights[0], h) +
+         dotClipped(values + h, &net.outputWeights[h], h);
+}
+
+// Adds one position's contribution to gradient
+void trainPosition(const FloatNetwork &net, const PackedRecord &record,
+                   const TrainOptions &options, Gradient &gradient,
+                   std::vector<float> &scratch) {
+  int h = net.hidden;
+  Features features;
+  extractFeatures(record.position, features);
+  float *values = scratch.data(), *delta = scratch.data() + 2 * h;
+
+  float predicted = sigmoid(forward(net, features, values));
+  float target = options.lambda * (record.result + 1) / 2.0f +
+                 (1 - options.lambda) *
+                     sigmoid(record.score / float(Nnue::OutputScale));
+  float error = predicted - target;
+  gradient.loss += error * error;
+
+  float slope = 2 * error * predicted * (1 - predicted);
+  gradient.outputBias += slope;
+  for (int side = 0; side < 2; side++) {
+    backward(values + side * h, &net.outputWeights[side * h], slope,
+             &gradient.outputWeights[side * h], delta, h);
+    addRow(gradient.hiddenBias.data(), delta, h);
+    for (int i = 0; i < features.count; i++) {
+      int row = features.index[side][i];
+      gradient.touched[row] = 1;
+      addRow(&gradient.inputWeights[size_t(row) * h], delta, h);
+    }
+  }
+}
+
+// Runs work(thread) on every thread and waits for them
+template <typename Work> void parallel(unsigned threads, Work &&work) {
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++)
+    workers.emplace_back([&, t] { work(t); });
+  for (std::thread &worker : workers)
+    worker.join();
+}
+
+void adamStep(float *weights, float *gradient, Moments &moments,
+              size_t offset, size_t count, float rate, float correction1,
+              float correction2, float scale, float limit) {
+  constexpr float Beta1 = 0.9f, Beta2 = 0.999f, Epsilon = 1e-8f;
+  for (size_t i = 0; i < count; i++) {
+    float g = gradient[i] * scale;
+    float &m = moments.m[offset + i], &v = moments.v[offset + i];
+    m = Beta1 * m + (1 - Beta1) * g;
+    v = Beta2 * v + (1 - Beta2) * g * g;
+    float step = rate * (m / correction1) / (std::sqrt(v / correction2) +
+                                             Epsilon);
+    weights[i] = std::clamp(weights[i] - step, -limit, limit);
+  }
+}
+
+Nnue::Network quantise(const FloatNetwork &net) {
+  auto round16 = [](float value, float scale) {
+    return static_cast<int16_t>(
+        std::clamp(std::lround(value * scale), -32767L, 32767L));
+  };
+  int h = net.hidden;
+  std::vector<int16_t> input(net.inputWeights.size()), bias(h), output(2 * h);
+  for (size_t i = 0; i < input.size(); i++)
+    input[i] = round16(net.inputWeights[i], Nnue::QA);
+  for (int i = 0; i < h; i++)
+    bias[i] = round16(net.hiddenBias[i], Nnue::QA);
+  for (int i = 0; i < 2 * h; i++)
+    output[i] = round16(net.outputWeights[i], Nnue::QB);
+
+  Nnue::Network network;
+  network.assign(h, std::move(input), std::move(bias), std::move(output),
+                 std::lround(net.outputBias * Nnue::QA * Nnue::QB));
+  return network;
+}
+
+void printUsage() {
+  std::println("Usage: chess_train -o net.nnue [-H hidden] [-e epochs] "
+               "[-b batch] [-r rate] [-t threads] [-l lambda] [-s seed] "
+               "DATA.bin...");
+  std::println("Trains the evaluation network on packed positions with "
+               "Adam and writes it in the quantised layout the engine "
+               "loads. The hidden size is a multiple of 16 up to {}.",
+               Nnue::MaxHidden);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  TrainOptions options;
+  std::string output;
+  std::vector<std::string> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-o" && i + 1 < argc)
+      output = argv[++i];
+    else if (arg == "-H" && i + 1 < argc)
+      options.hidden = std::atoi(argv[++i]);
+    else if (arg == "-e" && i + 1 < argc)
+      options.epochs = std::atoi(argv[++i]);
+    else if (arg == "-b" && i + 1 < argc)
+      options.batch = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "-r" && i + 1 < argc)
+      options.rate = std::atof(argv[++i]);
+    else if (arg == "-t" && i + 1 < argc)
+      threads = std::atoi(argv[++i]);
+    else if (arg == "-l" && i + 1 < argc)
+      options.lambda = std::atof(argv[++i]);
+    else if (arg == "-s" && i + 1 < argc)
+      options.seed = std::strtoull(argv[++i], nullptr, 10);
+    else if (!arg.empty() && arg[0] != '-')
+      inputs.emplace_back(arg);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (output.empty() || inputs.empty() || options.hidden <= 0 ||
+      options.hidden > Nnue::MaxHidden || options.hidden % 16 ||
+      !options.batch) {
+    printUsage();
+    return 1;
+  }
+
+  // Positions are read straight from the mapped files in shuffled order
+  std::vector<PackedReader> readers(inputs.size());
+  std::vector<std::pair<uint32_t, uint32_t>> samples;
+  for (size_t f = 0; f < inputs.size(); f++) {
+    if (!readers[f].open(inputs[f])) {
+      std::println(stderr, "Could not read {}", inputs[f]);
+      return 1;
+    }
+    for (size_t i = 0; i < readers[f].size(); i++)
+      samples.emplace_back(f, i);
+  }
+  if (samples.empty())
+    return 1;
+  std::println("{} positions", samples.size());
+
+  int h = options.hidden;
+  std::mt19937_64 rng(options.seed);
+  FloatNetwork net(h);
+  {
+    std::uniform_real_distribution<float> input(-0.1f, 0.1f);
+    std::uniform_real_distribution<float> outputInit(-1.0f / std::sqrt(h),
+                                                     1.0f / std::sqrt(h));
+    for (float &w : net.inputWeights)
+      w = input(rng);
+    for (float &w : net.outputWeights)
+      w = outputInit(rng);
+  }
+
+  threads = std::max(1u, threads);
+  std::vector<Gradient> gradients(threads, Gradient(h));
+  std::vector<std::vector<float>> scratch(threads,
+                                          std::vector<float>(3 * h));
+  const size_t inputSize = net.inputWeights.size();
+  Moments inputMoments(inputSize), hiddenMoments(h), outputMoments(2 * h + 1);
+  std::vector<int> step(Nnue::Inputs); // Adam steps taken by each input row
+  int outputStep = 0;
+
+  for (int epoch = 1; epoch <= options.epochs; epoch++) {
+    auto start = std::chrono::steady_clock::now();
+    std::shuffle(samples.begin(), samples.end(), rng);
+    double loss = 0;
+
+    for (size_t first = 0; first < samples.size(); first += options.batch) {
+      size_t last = std::min(first + options.batch, samples.size());
+
+      parallel(threads, [&](unsigned t) {
+        Gradient &g = gradients[t];
+        size_t begin = first + (last - first) * t / threads;
+        size_t end = first + (last - first) * (t + 1) / threads;
+        for (size_t i = begin; i < end; i++) {
+          auto [file, index] = samples[i];
+          trainPosition(net, readers[file].get(index), options, g,
+                        scratch[t]);
+        }
+      });
+
+      // Input rows no position used keep their weights and moments; the
+      // rows are shared out between the threads for summing and stepping
+      float scale = 1.0f / (last - first);
+      parallel(threads, [&](unsigned t) {
+        Gradient &sum = gradients[0];
+        for (int row = t; row < Nnue::Inputs; row += threads) {
+          bool used = false;
+          for (Gradient &g : gradients)
+            used |= g.touched[row];
+          if (!used)
+            continue;
+          float *rowSum = &sum.inputWeights[size_t(row) * h];
+          for (unsigned other = 1; other < threads; other++) {
+            Gradient &g = gradients[other];
+            if (!g.touched[row])
+              continue;
+            float *rowPart = &g.inputWeights[size_t(row) * h];
+            addRow(rowSum, rowPart, h);
+            std::fill(rowPart, rowPart + h, 0.0f);
+            g.touched[row] = 0;
+          }
+          int n = ++step[row];
+          adamStep(&net.inputWeights[size_t(row) * h], rowSum, inputMoments,
+                   size_t(row) * h, h, options.rate,
+                   1 - std::pow(0.9f, n), 1 - std::pow(0.999f, n), scale,
+                   InputWeightLimit);
+          std::fill(rowSum, rowSum + h, 0.0f);
+          sum.touched[row] = 0;
+        }
+      });
+
+      Gradient &sum = gradients[0];
+      for (unsigned t = 1; t < threads; t++) {
+        Gradient &g = gradients[t];
+        addRow(sum.hiddenBias.data(), g.hiddenBias.data(), h);
+        addRow(sum.outputWeights.data(), g.outputWeights.data(), 2 * h);
+        sum.outputBias += g.outputBias;
+        sum.loss += g.loss;
+        std::fill(g.hiddenBias.begin(), g.hiddenBias.end(), 0.0f);
+        std::fill(g.outputWeights.begin(), g.outputWeights.end(), 0.0f);
+        g.outputBias = 0;
+        g.loss = 0;
+      }
+      outputStep++;
+      float c1 = 1 - std::pow(0.9f, outputStep);
+      float c2 = 1 - std::pow(0.999f, outputStep);
+      adamStep(net.hiddenBias.data(), sum.hiddenBias.data(), hiddenMoments, 0,
+               h, options.rate, c1, c2, scale, InputWeightLimit);
+      adamStep(net.outputWeights.data(), sum.outputWeights.data(),
+               outputMoments, 0, 2 * h, options.rate, c1, c2, scale,
+               OutputWeightLimit);
+      adamStep(&net.outputBias, &sum.outputBias, outputMoments, 2 * h, 1,
+               options.rate, c1, c2, scale, OutputWeightLimit);
+      loss += sum.loss;
+      std::fill(sum.hiddenBias.begin(), sum.hiddenBias.end(), 0.0f);
+      std::fill(sum.outputWeights.begin(), sum.outputWeights.end(), 0.0f);
+      sum.outputBias = 0;
+      sum.loss = 0;
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    double seconds = std::max(elapsed.count(), 1e-9);
+    std::println("epoch {:>3}  loss {:.6f}  {:.1f}s  {:.0f} positions/s",
+                 epoch, loss / samples.size(), seconds,
+                 samples.size() / seconds);
+  }
+
+  Nnue::Network network = quantise(net);
+  if (!network.save(output)) {
+    std::println(stderr, "Could not write {}", output);
+    return 1;
+  }
+
+  // How far quantisation moves the evaluation
+  size_t checked = std::min<size_t>(samples.size(), 10000);
+  double difference = 0;
+  std::vector<float> values(2 * h);
+  Position pos;
+  for (size_t i = 0; i < checked; i++) {
+    auto [file, index] = samples[i];
+    PackedRecord record = readers[file].get(index);
+    Features features;
+    extractFeatures(record.position, features);
+    float exact = forward(net, features, values.data()) * Nnue::OutputScale;
+    if (record.position.unpack(pos))
+      difference += std::abs(exact - network.evaluate(pos));
+  }
+  std::println("wrote {}, quantised evaluations differ by {:.2f}cp on "
+               "average",
+               output, difference / checked);
+  return 0;
+}
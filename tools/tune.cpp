@@ -0,0 +1,374 @@
+#include "EvalParams.h"
+#include "Evaluation.h"
+#include "PackedPosition.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Parameters of one game phase: material by piece type, then the
+// piece-square tables in EvalParams order. The endgame block follows the
+// middlegame one.
+constexpr int PhaseParams = PieceTypeCount + PieceTypeCount * 64;
+constexpr int ParamCount = 2 * PhaseParams;
+
+constexpr int materialParam(int type) { return type; }
+constexpr int pstParam(int type, int tableSquare) {
+  return PieceTypeCount + type * 64 + tableSquare;
+}
+
+struct TuneOptions {
+  int epochs = 300;
+  double rate = 1.0;
+  bool adam = true;
+  double lambda = 1.0; // Weight of the game result against the search score
+  double k = 0;        // Sigmoid scale; fitted to the data when 0
+};
+
+// The positions one thread trains on, as flat arrays: position i uses
+// features [begin[i], begin[i + 1]). A feature is a parameter index within a
+// phase block and how many times it counts, negative for black. The phase
+// weights already carry the endgame scale and the side to move's sign.
+struct Shard {
+  std::vector<uint32_t> begin{0};
+  std::vector<uint16_t> index;
+  std::vector<int8_t> count;
+  std::vector<float> mgWeight, egWeight;
+  std::vector<float> result; // 1, 0.5 or 0 for the side to move
+  std::vector<float> score;  // Search score for the side to move
+  size_t skipped = 0;
+
+  size_t size() const { return result.size(); }
+  void add(const Position &pos, const PackedRecord &record,
+           MaterialCache &materials);
+};
+
+std::vector<double> initialParams() {
+  using namespace EvalParams;
+  std::vector<double> params(ParamCount);
+  for (int type = 0; type < PieceTypeCount; type++) {
+    params[materialParam(type)] = MaterialMg[type];
+    params[PhaseParams + materialParam(type)] = MaterialEg[type];
+    for (int sq = 0; sq < 64; sq++) {
+      params[pstParam(type, sq)] = PstMg[type][sq];
+      params[PhaseParams + pstParam(type, sq)] = PstEg[type][sq];
+    }
+  }
+  return params;
+}
+
+void Shard::add(const Position &pos, const PackedRecord &record,
+                MaterialCache &materials) {
+  // Specialised endgame evaluations do not use these parameters
+  const MaterialEntry &material = materials.probe(pos);
+  if (material.evaluation) {
+    skipped++;
+    return;
+  }
+
+  int materialCount[PieceTypeCount] = {};
+  int eg = 0;
+  Bitboard occupied = pos.getOccupied();
+  while (occupied) {
+    int sq = popLsb(occupied);
+    int piece = pos.getPieceOn(sq);
+    int type = static_cast<int>(typeOf(piece));
+    // The tables start at a8, so white reads them rank-flipped
+    bool white = colorOf(piece) == White;
+    int tableSquare = white ? flipRank(sq) : sq;
+    int sign = white ? 1 : -1;
+    materialCount[type] += sign;
+    index.push_back(pstParam(type, tableSquare));
+    count.push_back(sign);
+    eg += sign * (EvalParams::MaterialEg[type] +
+                  EvalParams::PstEg[type][tableSquare]);
+  }
+  for (int type = 0; type < PieceTypeCount; type++)
+    if (materialCount[type]) {
+      index.push_back(materialParam(type));
+      count.push_back(materialCount[type]);
+    }
+  begin.push_back(index.size());
+
+  // The scale depends on who is ahead, taken from the starting parameters
+  float sign = pos.getSideToMove() == White ? 1 : -1;
+  float scale = material.getScale(pos, eg > 0 ? White : Black) /
+                float(ScaleNormal);
+  mgWeight.push_back(sign * material.phase / MaxPhase);
+  egWeight.push_back(sign * scale * (MaxPhase - material.phase) / MaxPhase);
+  result.push_back((record.result + 1) / 2.0f);
+  score.push_back(record.score);
+}
+
+double sigmoid(double k, double x) { return 1 / (1 + std::exp(-k * x)); }
+
+double evaluateFeatures(const Shard &shard, size_t i,
+                        const std::vector<double> &params) {
+  double mg = 0, eg = 0;
+  for (uint32_t f = shard.begin[i]; f < shard.begin[i + 1]; f++) {
+    mg += shard.count[f] * params[shard.index[f]];
+    eg += shard.count[f] * params[PhaseParams + shard.index[f]];
+  }
+  return shard.mgWeight[i] * mg + shard.egWeight[i] * eg;
+}
+
+// Runs work(shard, thread) on one thread per shard
+template <typename Work>
+void forEachShard(std::vector<Shard> &shards, Work &&work) {
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < shards.size(); t++)
+    workers.emplace_back([&, t] { work(shards[t], t); });
+  for (std::thread &worker : workers)
+    worker.join();
+}
+
+// Mean squared error of the predicted score against the targets, and with
+// gradient set its derivative for every parameter
+double computeLoss(std::vector<Shard> &shards,
+                   const std::vector<double> &params,
+                   const TuneOptions &options, double k,
+                   std::vector<double> *gradient) {
+  std::vector<double> losses(shards.size());
+  std::vector<std::vector<double>> gradients(
+      gradient ? shards.size() : 0, std::vector<double>(ParamCount));
+
+  forEachShard(shards, [&](Shard &shard, size_t t) {
+    double loss = 0;
+    for (size_t i = 0; i < shard.size(); i++) {
+      double predicted = sigmoid(k, evaluateFeatures(shard, i, params));
+      double target = options.lambda * shard.result[i] +
+                      (1 - options.lambda) * sigmoid(k, shard.score[i]);
+      double error = predicted - target;
+      loss += error * error;
+      if (!gradient)
+        continue;
+
+      double slope = 2 * error * k * predicted * (1 - predicted);
+      double mg = slope * shard.mgWeight[i], eg = slope * shard.egWeight[i];
+      std::vector<double> &g = gradients[t];
+      for (uint32_t f = shard.begin[i]; f < shard.begin[i + 1]; f++) {
+        g[shard.index[f]] += mg * shard.count[f];
+        g[PhaseParams + shard.index[f]] += eg * shard.count[f];
+      }
+    }
+    losses[t] = loss;
+  });
+
+  size_t positions = 0;
+  double loss = 0;
+  for (size_t t = 0; t < shards.size(); t++) {
+    positions += shards[t].size();
+    loss += losses[t];
+  }
+  positions = std::max<size_t>(positions, 1);
+
+  if (gradient) {
+    gradient->assign(ParamCount, 0);
+    for (const std::vector<double> &g : gradients)
+      for (int p = 0; p < ParamCount; p++)
+        (*gradient)[p] += g[p] / positions;
+  }
+  return loss / positions;
+}
+
+// Golden-section search for the sigmoid scale that best fits the starting
+// parameters
+double fitK(std::vector<Shard> &shards, const std::vector<double> &params,
+            const TuneOptions &options) {
+  const double ratio = (std::sqrt(5.0) - 1) / 2;
+  double low = 0.0005, high = 0.05;
+  for (int i = 0; i < 24; i++) {
+    double a = high - ratio * (high - low), b = low + ratio * (high - low);
+    if (computeLoss(shards, params, options, a, nullptr) <
+        computeLoss(shards, params, options, b, nullptr))
+      high = b;
+    else
+      low = a;
+  }
+  return (low + high) / 2;
+}
+
+void writeTable(std::FILE *out, const std::vector<double> &params,
+                int offset, std::string_view name) {
+  constexpr std::string_view typeNames[] = {"Pawn",   "Knight", "Rook",
+                                            "Bishop", "Queen",  "King"};
+  std::println(out, "constexpr int {}[6][64] = {{", name);
+  for (int type = 0; type < PieceTypeCount; type++) {
+    std::println(out, "  {{ // {}", typeNames[type]);
+    for (int row = 0; row < 8; row++) {
+      std::print(out, "   ");
+      for (int col = 0; col < 8; col++) {
+        int value = std::lround(params[offset + pstParam(type, row * 8 + col)]);
+        std::print(out, " {:>3}{}", value,
+                   col < 7 ? "," : row < 7 ? "," : "},");
+      }
+      std::println(out, "");
+    }
+  }
+  std::println(out, "}};");
+}
+
+bool writeParams(const std::string &path, const std::vector<double> &params) {
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out)
+    return false;
+
+  auto material = [&](int offset) {
+    std::string values;
+    for (int type = 0; type < PieceTypeCount; type++)
+      values += (type ? ", " : "") +
+                std::to_string(std::lround(params[offset + type]));
+    return values;
+  };
+
+  std::println(out, "#pragma once\n");
+  std::println(out, "// Evaluation weights in centipawns. Piece-square tables "
+                    "are laid out the way");
+  std::println(out, "// the board is drawn, a8 first and h1 last, from "
+                    "white's point of view.");
+  std::println(out, "// Indexed by PieceType: pawn, knight, rook, bishop, "
+                    "queen, king.");
+  std::println(out, "namespace EvalParams {{\n");
+  std::println(out, "constexpr int MaterialMg[6] = {{{}}};", material(0));
+  std::println(out, "constexpr int MaterialEg[6] = {{{}}};\n",
+               material(PhaseParams));
+  std::println(out, "// clang-format off");
+  writeTable(out, params, 0, "PstMg");
+  std::println(out, "");
+  writeTable(out, params, PhaseParams, "PstEg");
+  std::println(out, "// clang-format on\n");
+  std::println(out, "}} // namespace EvalParams");
+  return std::fclose(out) == 0;
+}
+
+void printUsage() {
+  std::println("Usage: chess_tune -o EvalParams.h [-t threads] [-e epochs] "
+               "[-r rate] [-g] [-l lambda] [-k scale] DATA.bin...");
+  std::println("Fits the material and piece-square values to packed "
+               "positions with Adam, or plain gradient descent with -g, and "
+               "writes them as a parameter header.");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  TuneOptions options;
+  std::string output;
+  std::vector<std::string> inputs;
+  bool rateGiven = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "-o" && i + 1 < argc)
+      output = argv[++i];
+    else if (arg == "-t" && i + 1 < argc)
+      threads = std::atoi(argv[++i]);
+    else if (arg == "-e" && i + 1 < argc)
+      options.epochs = std::atoi(argv[++i]);
+    else if (arg == "-r" && i + 1 < argc) {
+      options.rate = std::atof(argv[++i]);
+      rateGiven = true;
+    } else if (arg == "-g")
+      options.adam = false;
+    else if (arg == "-l" && i + 1 < argc)
+      options.lambda = std::atof(argv[++i]);
+    else if (arg == "-k" && i + 1 < argc)
+      options.k = std::atof(argv[++i]);
+    else if (!arg.empty() && arg[0] != '-')
+      inputs.emplace_back(arg);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (output.empty() || inputs.empty()) {
+    printUsage();
+    return 1;
+  }
+  // Plain gradients are tiny next to Adam's normalised steps
+  if (!options.adam && !rateGiven)
+    options.rate = 1e6;
+
+  threads = std::max(1u, threads);
+  std::vector<Shard> shards(threads);
+  auto start = std::chrono::steady_clock::now();
+
+  for (const std::string &input : inputs) {
+    PackedReader reader;
+    if (!reader.open(input)) {
+      std::println(stderr, "Could not read {}", input);
+      return 1;
+    }
+    forEachShard(shards, [&](Shard &shard, size_t t) {
+      MaterialCache materials;
+      Position pos;
+      size_t first = reader.size() * t / threads;
+      size_t last = reader.size() * (t + 1) / threads;
+      for (size_t i = first; i < last; i++) {
+        PackedRecord record = reader.get(i);
+        if (record.position.unpack(pos))
+          shard.add(pos, record, materials);
+      }
+    });
+  }
+
+  size_t positions = 0, skipped = 0;
+  for (const Shard &shard : shards) {
+    positions += shard.size();
+    skipped += shard.skipped;
+  }
+  std::chrono::duration<double> loadTime =
+      std::chrono::steady_clock::now() - start;
+  std::println("{} positions loaded in {:.1f}s, {} known endgames skipped",
+               positions, loadTime.count(), skipped);
+  if (!positions)
+    return 1;
+
+  std::vector<double> params = initialParams();
+  double k = options.k ? options.k : fitK(shards, params, options);
+  std::println("K = {:.6f}, starting loss {:.6f}", k,
+               computeLoss(shards, params, options, k, nullptr));
+
+  constexpr double Beta1 = 0.9, Beta2 = 0.999, Epsilon = 1e-8;
+  std::vector<double> gradient, m(ParamCount), v(ParamCount);
+  for (int epoch = 1; epoch <= options.epochs; epoch++) {
+    auto epochStart = std::chrono::steady_clock::now();
+    double loss = computeLoss(shards, params, options, k, &gradient);
+
+    for (int p = 0; p < ParamCount; p++) {
+      if (!options.adam) {
+        params[p] -= options.rate * gradient[p];
+        continue;
+      }
+      m[p] = Beta1 * m[p] + (1 - Beta1) * gradient[p];
+      v[p] = Beta2 * v[p] + (1 - Beta2) * gradient[p] * gradient[p];
+      double mHat = m[p] / (1 - std::pow(Beta1, epoch));
+      double vHat = v[p] / (1 - std::pow(Beta2, epoch));
+      params[p] -= options.rate * mHat / (std::sqrt(vHat) + Epsilon);
+    }
+
+    std::chrono::duration<double> epochTime =
+        std::chrono::steady_clock::now() - epochStart;
+    if (epoch % 10 == 0 || epoch == 1 || epoch == options.epochs)
+      std::println("epoch {:>4}  loss {:.6f}  {:.2f}s", epoch, loss,
+                   epochTime.count());
+  }
+
+  std::println("final loss {:.6f}",
+               computeLoss(shards, params, options, k, nullptr));
+  if (!writeParams(output, params)) {
+    std::println(stderr, "Could not write {}", output);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,395 @@
+#include "Nnue.h"
+#include "Search.h"
+#include "Tablebase.h"
+#include "TimeManager.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int MaxHashMegabytes = 65536;
+constexpr int MaxMultiPV = 64;
+
+// Lines to the GUI come from both the input thread and the search thread
+std::mutex outputMutex;
+
+void send(const std::string &line) {
+  std::lock_guard lock(outputMutex);
+  std::println("{}", line);
+  std::fflush(stdout);
+}
+
+std::vector<std::string_view> splitWords(std::string_view line) {
+  std::vector<std::string_view> words;
+  while (true) {
+    size_t begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos)
+      return words;
+    line.remove_prefix(begin);
+    size_t end = std::min(line.find_first_of(" \t\r"), line.size());
+    words.push_back(line.substr(0, end));
+    line.remove_prefix(end);
+  }
+}
+
+// Option names are compared without regard to case
+bool sameName(std::string_view a, std::string_view b) {
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                    [](char x, char y) {
+                      return std::tolower(x) == std::tolower(y);
+                    });
+}
+
+int64_t toInt(std::string_view text) {
+  return std::atoll(std::string(text).c_str());
+}
+
+Move findLegalMove(const Position &pos, std::string_view text) {
+  MoveList moves;
+  pos.generateLegalMoves(moves);
+  for (Move m : moves)
+    if (m.toUci() == text)
+      return m;
+  return Move();
+}
+
+// Mates are given in moves, negative when the engine is mated
+std::string scoreText(int score) {
+  if (score > MateBound)
+    return "mate " + std::to_string((MateScore - score + 1) / 2);
+  if (score < -MateBound)
+    return "mate -" + std::to_string((MateScore + score) / 2);
+  return "cp " + std::to_string(score);
+}
+
+class Engine {
+private:
+  Search search;
+  std::unique_ptr<Tablebases> tablebases;
+  Position pos;
+  int multiPV = 1;
+  int64_t overheadMs = TimeControl().overheadMs;
+
+  // The search runs here while the input thread keeps reading, so stop and
+  // ponderhit act at once
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable released;
+  // Guarded by mutex. While holding, bestmove waits for stop or ponderhit,
+  // as infinite and ponder searches must.
+  bool holding = false;
+  bool pondering = false;
+  bool stopped = false;
+  bool ponderhitReceived = false;
+  bool timed = false; // Whether budget applies after a ponder hit
+  TimeBudget budget{0, 0};
+  std::chrono::steady_clock::time_point ponderhitTime;
+
+  void report(const SearchInfo &info);
+  void run(const Position &root, const SearchLimits &limits);
+  void applyOption(std::string_view name, std::string_view value);
+
+public:
+  Engine() { pos.setStartPos(); }
+  ~Engine() { stop(); }
+
+  void uci();
+  void setOption(const std::vector<std::string_view> &words);
+  void newGame();
+  void position(const std::vector<std::string_view> &words);
+  void go(const std::vector<std::string_view> &words);
+  void stop();
+  void ponderhit();
+};
+
+void Engine::uci() {
+  send("id name Chess");
+  send("option name Hash type spin default 16 min 1 max " +
+       std::to_string(MaxHashMegabytes));
+  send("option name Clear Hash type button");
+  send("option name MultiPV type spin default 1 min 1 max " +
+       std::to_string(MaxMultiPV));
+  send("option name Ponder type check default false");
+  send("option name Move Overhead type spin default " +
+       std::to_string(overheadMs) + " min 0 max 5000");
+  send("option name EvalFile type string default <empty>");
+  send("option name TablebasePath type string default <empty>");
+  send("uciok");
+}
+
+void Engine::setOption(const std::vector<std::string_view> &words) {
+  // setoption name <words...> [value <words...>]
+  auto valueAt = std::find(words.begin(), words.end(), "value");
+  auto join = [](auto begin, auto end) {
+    std::string text;
+    for (auto word = begin; word != end; ++word) {
+      if (!text.empty())
+        text += ' ';
+      text += *word;
+    }
+    return text;
+  };
+  if (words.size() < 3 || words[1] != "name")
+    return;
+  std::string name = join(words.begin() + 2, valueAt);
+  std::string value =
+      valueAt == words.end() ? "" : join(valueAt + 1, words.end());
+  stop();
+  applyOption(name, value);
+}
+
+void Engine::applyOption(std::string_view name, std::string_view value) {
+  bool empty = value.empty() || value == "<empty>";
+  if (sameName(name, "Hash"))
+    search.setHashSize(std::clamp<int64_t>(toInt(value), 1, MaxHashMegabytes));
+  else if (sameName(name, "Clear Hash"))
+    search.clearHash();
+  else if (sameName(name, "MultiPV"))
+    multiPV = std::clamp<int64_t>(toInt(value), 1, MaxMultiPV);
+  else if (sameName(name, "Move Overhead"))
+    overheadMs = std::clamp<int64_t>(toInt(value), 0, 5000);
+  else if (sameName(name, "EvalFile")) {
+    if (empty)
+      Nnue::unloadNetwork();
+    else if (!Nnue::loadNetwork(std::string(value)))
+      send("info string could not load network " + std::string(value));
+  } else if (sameName(name, "TablebasePath")) {
+    search.setTablebases(nullptr);
+    tablebases.reset();
+    if (!empty) {
+      tablebases = std::make_unique<Tablebases>();
+      int count = tablebases->load(std::string(value));
+      send("info string " + std::to_string(count) + " tablebases loaded");
+      search.setTablebases(tablebases.get());
+    }
+  } else if (!sameName(name, "Ponder"))
+    send("info string unknown option " + std::string(name));
+}
+
+void Engine::newGame() {
+  stop();
+  search.clearHash();
+}
+
+void Engine::position(const std::vector<std::string_view> &words) {
+  stop();
+  size_t i = 1;
+  Position next;
+  if (i < words.size() && words[i] == "startpos") {
+    next.setStartPos();
+    i++;
+  } else if (i < words.size() && words[i] == "fen") {
+    std::string fen;
+    for (i++; i < words.size() && words[i] != "moves"; i++)
+      fen += std::string(words[i]) + " ";
+    if (!next.setFen(fen)) {
+      send("info string invalid fen " + fen);
+      return;
+    }
+  } else
+    return;
+
+  if (i < words.size() && words[i] == "moves")
+    for (i++; i < words.size(); i++) {
+      Move m = findLegalMove(next, words[i]);
+      if (m.isNull()) {
+        send("info string illegal move " + std::string(words[i]));
+        break;
+      }
+      next.makeMove(m);
+    }
+  pos = next;
+}
+
+void Engine::go(const std::vector<std::string_view> &words) {
+  stop();
+
+  SearchLimits limits;
+  limits.multiPV = multiPV;
+  TimeControl clocks[2];
+  bool infinite = false, ponder = false, clocked = false;
+  int64_t moveTimeMs = 0;
+  for (size_t i = 1; i < words.size(); i++) {
+    std::string_view word = words[i];
+    bool hasValue = i + 1 < words.size();
+    if (word == "infinite")
+      infinite = true;
+    else if (word == "ponder")
+      ponder = true;
+    else if (word == "searchmoves")
+      while (i + 1 < words.size() &&
+             !findLegalMove(pos, words[i + 1]).isNull())
+        limits.searchMoves.push_back(findLegalMove(pos, words[++i]));
+    else if (!hasValue)
+      continue;
+    else if (word == "depth")
+      limits.depth = std::clamp<int64_t>(toInt(words[++i]), 1, MaxPly - 1);
+    else if (word == "nodes")
+      limits.nodes = std::max<int64_t>(toInt(words[++i]), 1);
+    else if (word == "movetime")
+      moveTimeMs = std::max<int64_t>(toInt(words[++i]), 1);
+    else if (word == "wtime" || word == "btime") {
+      clocks[word == "btime"].remainingMs = toInt(words[++i]);
+      clocked = true;
+    } else if (word == "winc" || word == "binc")
+      clocks[word == "binc"].incrementMs = toInt(words[++i]);
+    else if (word == "movestogo")
+      clocks[0].movesToGo = clocks[1].movesToGo = toInt(words[++i]);
+  }
+
+  TimeBudget next{0, 0};
+  if (moveTimeMs)
+    next = {0, std::max<int64_t>(moveTimeMs - overheadMs, 1)};
+  else if (clocked) {
+    TimeControl control = clocks[pos.getSideToMove()];
+    control.overheadMs = overheadMs;
+    next = allocateTime(control);
+  }
+  if (!infinite && !ponder) {
+    limits.softTimeMs = next.softMs;
+    limits.moveTimeMs = next.hardMs;
+  }
+
+  {
+    std::lock_guard lock(mutex);
+    holding = infinite || ponder;
+    pondering = ponder;
+    stopped = false;
+    ponderhitReceived = false;
+    timed = !infinite && (moveTimeMs || clocked);
+    budget = next;
+  }
+  worker = std::thread([this, root = pos, limits] { run(root, limits); });
+}
+
+void Engine::run(const Position &root, const SearchLimits &limits) {
+  std::vector<Move> bestLine;
+  Move best = search.think(root, limits, [&](const SearchInfo &info) {
+    report(info);
+    if (info.line == 1)
+      bestLine = info.pv;
+
+    // A stop or ponder hit that came before think reset its state is
+    // applied again here
+    std::lock_guard lock(mutex);
+    if (stopped)
+      search.stop();
+    else if (ponderhitReceived && timed) {
+      int64_t spent = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now() - ponderhitTime)
+                          .count();
+      search.setTimeLimits(
+          budget.softMs ? std::max<int64_t>(budget.softMs - spent, 1) : 0,
+          std::max<int64_t>(budget.hardMs - spent, 1));
+    }
+  });
+
+  {
+    std::unique_lock lock(mutex);
+    released.wait(lock, [&] { return !holding; });
+  }
+
+  std::string line = "bestmove " + (best.isNull() ? "0000" : best.toUci());
+  if (bestLine.size() >= 2 && bestLine[0] == best)
+    line += " ponder " + bestLine[1].toUci();
+  send(line);
+}
+
+void Engine::report(const SearchInfo &info) {
+  uint64_t nps = info.nodes * 1000 / std::max<int64_t>(info.elapsedMs, 1);
+  std::string line = "info depth ";
+  line += std::to_string(info.depth);
+  line += " multipv ";
+  line += std::to_string(info.line);
+  line += " score ";
+  line += scoreText(info.score);
+  line += " nodes ";
+  line += std::to_string(info.nodes);
+  line += " nps ";
+  line += std::to_string(nps);
+  line += " hashfull ";
+  line += std::to_string(search.hashfull());
+  line += " tbhits ";
+  line += std::to_string(info.tbHits);
+  line += " time ";
+  line += std::to_string(info.elapsedMs);
+  line += " pv";
+  for (Move m : info.pv) {
+    line += ' ';
+    line += m.toUci();
+  }
+  send(line);
+}
+
+void Engine::stop() {
+  {
+    std::lock_guard lock(mutex);
+    holding = false;
+    pondering = false;
+    stopped = true;
+  }
+  released.notify_all();
+  search.stop();
+  if (worker.joinable())
+    worker.join();
+}
+
+void Engine::ponderhit() {
+  {
+    std::lock_guard lock(mutex);
+    if (!pondering)
+      return;
+    pondering = false;
+    holding = false;
+    ponderhitReceived = true;
+    ponderhitTime = std::chrono::steady_clock::now();
+    if (timed)
+      search.setTimeLimits(budget.softMs, budget.hardMs);
+  }
+  released.notify_all();
+}
+
+} // namespace
+
+int main() {
+  Engine engine;
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    std::vector<std::string_view> words = splitWords(line);
+    if (words.empty())
+      continue;
+    std::string_view command = words[0];
+
+    if (command == "uci")
+      engine.uci();
+    else if (command == "isready")
+      send("readyok");
+    else if (command == "setoption")
+      engine.setOption(words);
+    else if (command == "ucinewgame")
+      engine.newGame();
+    else if (command == "position")
+      engine.position(words);
+    else if (command == "go")
+      engine.go(words);
+    else if (command == "stop")
+      engine.stop();
+    else if (command == "ponderhit")
+      engine.ponderhit();
+    else if (command == "quit")
+      break;
+  }
+  return 0;
+}